@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Cost of the library itself on a backend.
+ * With the in-process backend, nothing goes to the kernel or usb-server,
+ * so the numbers are the overhead of the library.
+ * usage: acc_bench_backend [backend] [iterations] [message size] */
+
+#include <time.h>
+#include "usb_accessory.h"
+#include "usb_accessory_private.h"
+#include "acc_inproc_backend.h"
+
+#define DEFAULT_BACKEND "inproc"
+#define DEFAULT_ITERATIONS 100000
+#define DEFAULT_MESSAGE_SIZE 512
+#define BENCH_ACC_INFO "Samsung|Bench|Benchmark accessory|1.0|http://www.tizen.org|0123456789"
+
+static usb_accessory_h attached = NULL;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool count_cb(usb_accessory_h handle, void *data)
+{
+	(*(int *)data)++;
+	return true;
+}
+
+static int run_foreach(int iterations, unsigned int size)
+{
+	int i;
+	int cnt = 0;
+	for (i = 0 ; i < iterations ; i++) {
+		if (usb_accessory_foreach_attached(count_cb, &cnt) != USB_ERROR_NONE) return -1;
+	}
+	return (cnt == iterations) ? 0 : -1;
+}
+
+static int run_is_connected(int iterations, unsigned int size)
+{
+	int i;
+	bool connected = false;
+	for (i = 0 ; i < iterations ; i++) {
+		if (usb_accessory_is_connected(NULL, &connected) != USB_ERROR_NONE) return -1;
+	}
+	return connected ? 0 : -1;
+}
+
+/* The verdict is not kept, so that each call asks the backend */
+static int run_has_permission(int iterations, unsigned int size)
+{
+	int i;
+	bool granted = false;
+	struct usb_accessory_s *acc = acc_handle_get(attached);
+	for (i = 0 ; i < iterations ; i++) {
+		acc->accPermission = false;
+		if (usb_accessory_has_permission(attached, &granted) != USB_ERROR_NONE) return -1;
+	}
+	return 0;
+}
+
+/* Write a message and read it back through the loopback of the backend */
+static int run_session(int iterations, unsigned int size)
+{
+	usb_accessory_session_h session = NULL;
+	char *buf = malloc(size);
+	unsigned int len;
+	unsigned int done;
+	int ret = 0;
+	int i;
+
+	if (!buf) return -1;
+	memset(buf, 0x5a, size);
+	acc_handle_get(attached)->accPermission = true;
+	if (usb_accessory_session_create(attached, &session) != USB_ERROR_NONE
+			|| usb_accessory_session_start(session) != USB_ERROR_NONE) {
+		if (session) usb_accessory_session_destroy(session);
+		FREE(buf);
+		return -1;
+	}
+	for (i = 0 ; i < iterations && ret == 0 ; i++) {
+		if (usb_accessory_session_write(session, buf, size, &len) != USB_ERROR_NONE) ret = -1;
+		for (done = 0 ; done < size && ret == 0 ; done += len) {
+			if (usb_accessory_session_read(session, buf + done, size - done, &len) != USB_ERROR_NONE
+					|| len == 0)
+				ret = -1;
+		}
+	}
+	usb_accessory_session_destroy(session);
+	FREE(buf);
+	return ret;
+}
+
+static void run_bench(const char *name, int (*run)(int, unsigned int), int iterations, unsigned int size)
+{
+	double start = now_sec();
+	double elapsed;
+	if (run(iterations, size) < 0) {
+		printf("%-14s FAILED\n", name);
+		return;
+	}
+	elapsed = now_sec() - start;
+	printf("%-14s %10.0f ops/s %10.1f ns/op\n", name, iterations / elapsed, elapsed * 1e9 / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *backend = (argc > 1) ? argv[1] : DEFAULT_BACKEND;
+	int iterations = (argc > 2) ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+	int size = (argc > 3) ? atoi(argv[3]) : DEFAULT_MESSAGE_SIZE;
+	struct usb_accessory_list *accList = NULL;
+
+	accInprocRegister();
+	if (iterations <= 0 || size <= 0 || size > ACC_INPROC_RING_SIZE || accBackendSelect(backend) < 0) {
+		printf("usage: %s [system|inproc] [iterations] [message size]\n", argv[0]);
+		return -1;
+	}
+	accInprocSetAccessory(BENCH_ACC_INFO, true);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+
+	if (!getAccList(&accList, NULL) || !accList) {
+		printf("FAIL: No accessory is attached\n");
+		return -1;
+	}
+	attached = accList->accessory;
+	accList->accessory = NULL;
+	freeAccList(accList);
+
+	printf("backend: %s, iterations: %d, message size: %d\n", backend, iterations, size);
+	run_bench("foreach", run_foreach, iterations, size);
+	run_bench("is_connected", run_is_connected, iterations, size);
+	run_bench("has_permission", run_has_permission, iterations, size);
+	run_bench("session", run_session, iterations, size);
+	acc_handle_free(attached);
+	return 0;
+}
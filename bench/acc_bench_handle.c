@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Allocation throughput of accessory handles.
+ * usage: acc_bench_handle [iterations] [live handles] [threads] */
+
+#include <time.h>
+#include "usb_accessory.h"
+#include "usb_accessory_private.h"
+
+#define DEFAULT_ITERATIONS 1000000
+#define DEFAULT_LIVE 256
+#define DEFAULT_THREADS 1
+
+struct bench_arg {
+	int iterations;
+	int live;
+	int (*run)(int iterations, int live);
+	double elapsed;
+};
+
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Baseline: what the library did before handles came from the slab */
+static int run_malloc(int iterations, int live)
+{
+	int i;
+	struct usb_accessory_s **pool = calloc(live, sizeof(struct usb_accessory_s *));
+	if (!pool) return -1;
+	for (i = 0 ; i < iterations ; i++) {
+		int slot = i % live;
+		FREE(pool[slot]);
+		pool[slot] = (struct usb_accessory_s *)malloc(sizeof(struct usb_accessory_s));
+		if (!pool[slot]) return -1;
+		pool[slot]->accPermission = false;
+	}
+	for (i = 0 ; i < live ; i++) FREE(pool[i]);
+	FREE(pool);
+	return 0;
+}
+
+static int run_slab(int iterations, int live)
+{
+	int i;
+	usb_accessory_h *pool = calloc(live, sizeof(usb_accessory_h));
+	if (!pool) return -1;
+	for (i = 0 ; i < iterations ; i++) {
+		int slot = i % live;
+		if (pool[slot]) acc_handle_free(pool[slot]);
+		pool[slot] = acc_handle_alloc();
+		if (!pool[slot]) return -1;
+	}
+	for (i = 0 ; i < live ; i++) {
+		if (pool[i]) acc_handle_free(pool[i]);
+	}
+	FREE(pool);
+	return 0;
+}
+
+/* Public API workload: clone one accessory and destroy the clones */
+static int run_clone(int iterations, int live)
+{
+	int i;
+	int ret = 0;
+	usb_accessory_h origin = acc_handle_alloc();
+	struct usb_accessory_s *acc = acc_handle_get(origin);
+	usb_accessory_h *pool = calloc(live, sizeof(usb_accessory_h));
+	if (!acc || !pool) return -1;
+	setAccRaw(acc, "Samsung|Bench|Benchmark accessory|1.0|http://www.tizen.org|0123456789");
+
+	for (i = 0 ; i < iterations ; i++) {
+		int slot = i % live;
+		if (pool[slot]) usb_accessory_destroy(pool[slot]);
+		pool[slot] = NULL;
+		ret = usb_accessory_clone(origin, &pool[slot]);
+		if (ret != USB_ERROR_NONE) break;
+	}
+	for (i = 0 ; i < live ; i++) {
+		if (pool[i]) usb_accessory_destroy(pool[i]);
+	}
+	FREE(pool);
+	acc_handle_free(origin);
+	return (ret == USB_ERROR_NONE) ? 0 : -1;
+}
+
+static void *bench_thread(void *data)
+{
+	struct bench_arg *arg = (struct bench_arg *)data;
+	double start = now_sec();
+	if (arg->run(arg->iterations, arg->live) < 0) {
+		arg->elapsed = -1;
+		return NULL;
+	}
+	arg->elapsed = now_sec() - start;
+	return NULL;
+}
+
+static void run_bench(const char *name, int (*run)(int, int), int iterations, int live, int threads)
+{
+	int i;
+	double elapsed = 0;
+	pthread_t tid[threads];
+	struct bench_arg arg[threads];
+
+	for (i = 0 ; i < threads ; i++) {
+		arg[i].iterations = iterations;
+		arg[i].live = live;
+		arg[i].run = run;
+		arg[i].elapsed = 0;
+		pthread_create(&tid[i], NULL, bench_thread, &arg[i]);
+	}
+	for (i = 0 ; i < threads ; i++) {
+		pthread_join(tid[i], NULL);
+		if (arg[i].elapsed < 0) {
+			printf("%-8s FAILED\n", name);
+			return;
+		}
+		if (arg[i].elapsed > elapsed) elapsed = arg[i].elapsed;
+	}
+	printf("%-8s %10.0f ops/s %8.1f ns/op\n", name,
+			(double)iterations * threads / elapsed,
+			elapsed * 1e9 / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+	int live = (argc > 2) ? atoi(argv[2]) : DEFAULT_LIVE;
+	int threads = (argc > 3) ? atoi(argv[3]) : DEFAULT_THREADS;
+	if (iterations <= 0 || live <= 0 || threads <= 0) {
+		printf("usage: %s [iterations] [live handles] [threads]\n", argv[0]);
+		return -1;
+	}
+
+	printf("iterations: %d, live handles: %d, threads: %d\n", iterations, live, threads);
+	run_bench("malloc", run_malloc, iterations, live, threads);
+	run_bench("slab", run_slab, iterations, live, threads);
+	run_bench("clone", run_clone, iterations, live, threads);
+	return 0;
+}
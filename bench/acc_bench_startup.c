@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Cost of loading the library and of the first calls to it.
+ * Run it in a fresh process each time, since only the first load is measured.
+ * usage: acc_bench_startup [library path] */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <dlfcn.h>
+
+#define DEFAULT_LIB "libcapi-system-usb-accessory.so.0"
+
+typedef int (*is_connected_func)(void *accessory, bool *is_connected);
+
+static double now_usec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Count the objects mapped in this process */
+static int count_loaded_libs(void)
+{
+	char line[512];
+	char last[512] = "";
+	int cnt = 0;
+	FILE *fp = fopen("/proc/self/maps", "r");
+	if (!fp) return -1;
+	while (fgets(line, sizeof(line), fp)) {
+		char *path = strchr(line, '/');
+		if (!path || !strstr(path, ".so")) continue;
+		if (strcmp(path, last)) {
+			cnt++;
+			snprintf(last, sizeof(last), "%s", path);
+		}
+	}
+	fclose(fp);
+	return cnt;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *name = (argc > 1) ? argv[1] : DEFAULT_LIB;
+	is_connected_func is_connected = NULL;
+	bool connected = false;
+	void *lib = NULL;
+	double t0, t1, t2, t3, t4;
+	int libsBefore;
+	int libsLoaded;
+	int libsFirst;
+	int ret;
+
+	libsBefore = count_loaded_libs();
+	t0 = now_usec();
+	lib = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+	t1 = now_usec();
+	if (!lib) {
+		printf("FAIL: dlopen(%s): %s\n", name, dlerror());
+		return -1;
+	}
+	libsLoaded = count_loaded_libs();
+
+	is_connected = (is_connected_func)dlsym(lib, "usb_accessory_is_connected");
+	if (!is_connected) {
+		printf("FAIL: dlsym(usb_accessory_is_connected)\n");
+		return -1;
+	}
+	t2 = now_usec();
+	ret = is_connected(NULL, &connected);
+	t3 = now_usec();
+	is_connected(NULL, &connected);
+	t4 = now_usec();
+	libsFirst = count_loaded_libs();
+
+	printf("dlopen:        %8.1f usec, %d -> %d shared objects\n", t1 - t0, libsBefore, libsLoaded);
+	printf("first call:    %8.1f usec, %d shared objects (ret %d)\n", t3 - t2, libsFirst, ret);
+	printf("second call:   %8.1f usec\n", t4 - t3);
+	dlclose(lib);
+	return 0;
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Build the library in each profile and compare the size and the speed of them.
+# The release profiles are trained with the control-plane and data-path benchmarks
+# (acc_bench_handle and acc_bench_backend on the inproc backend).
+# usage: acc_build_report.sh [work directory] [iterations]
+
+set -e
+
+SRC_DIR=$(cd "$(dirname "$0")/.." && pwd)
+WORK_DIR=${1:-/tmp/acc_build_report}
+ITERATIONS=${2:-100000}
+LIB=libcapi-system-usb-accessory.so
+PROFILES="default release release-pgo"
+
+configure() {
+	mkdir -p "$WORK_DIR/$PROFILE"
+	(cd "$WORK_DIR/$PROFILE" && cmake "$SRC_DIR" -DFULLVER=0.0.0 -DMAJORVER=0 -DBUILD_BENCH=ON "$@" > cmake.log 2>&1)
+}
+
+build() {
+	make -C "$WORK_DIR/$PROFILE" -j"$(nproc)" > "$WORK_DIR/$PROFILE/make.log" 2>&1 \
+		|| { tail -20 "$WORK_DIR/$PROFILE/make.log" ; exit 1 ; }
+}
+
+run_benches() {
+	"$WORK_DIR/$PROFILE/bench/acc_bench_handle" "$ITERATIONS"
+	"$WORK_DIR/$PROFILE/bench/acc_bench_backend" inproc "$ITERATIONS"
+	"$WORK_DIR/$PROFILE/bench/acc_bench_startup" "$WORK_DIR/$PROFILE/$LIB"
+}
+
+for PROFILE in $PROFILES ; do
+	echo "Building $PROFILE"
+	case $PROFILE in
+	default)
+		configure
+		;;
+	release)
+		configure -DCMAKE_BUILD_TYPE=Release
+		;;
+	release-pgo)
+		configure -DCMAKE_BUILD_TYPE=Release -DPGO=generate
+		build
+		echo "Training $PROFILE"
+		find "$WORK_DIR/$PROFILE" -name '*.gcda' -delete
+		run_benches > "$WORK_DIR/$PROFILE/train.log"
+		configure -DCMAKE_BUILD_TYPE=Release -DPGO=use
+		;;
+	esac
+	build
+done
+
+echo
+printf "%-12s %10s %10s %10s %10s %8s\n" profile file text data bss exported
+for PROFILE in $PROFILES ; do
+	so="$WORK_DIR/$PROFILE/$LIB"
+	set -- $(size "$so" | tail -1)
+	printf "%-12s %10s %10s %10s %10s %8s\n" $PROFILE $(stat -L -c %s "$so") $1 $2 $3 \
+		$(nm -D --defined-only "$so" | grep -c ' T ')
+done
+
+for PROFILE in $PROFILES ; do
+	echo
+	echo "== $PROFILE"
+	run_benches
+done
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "acc_inproc_backend.h"
+
+/* In-process backend. It keeps the requests, the status and the data in memory,
+ * so that the benchmarks measure the library without the kernel and usb-server,
+ * and the tests run without an accessory:
+ * the status and the accessory are set by accInproc*(), and the data channel
+ * is a loopback ring which returns what was written. */
+
+static struct {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	int		status;
+	bool		granted;
+	char		raw[SOCK_STR_LEN];
+	vconf_callback_fn watchFunc;
+	void		*watchData;
+	char		ring[ACC_INPROC_RING_SIZE];
+	unsigned int	head;
+	unsigned int	len;
+	unsigned int	opened;
+} inproc = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.status = VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED,
+};
+
+static int inprocRequest(int request, char *answer, char *appId)
+{
+	pthread_mutex_lock(&inproc.lock);
+	switch (request) {
+	case GET_ACC_INFO:
+		snprintf(answer, SOCK_STR_LEN, "%s", inproc.raw);
+		break;
+	case HAS_ACC_PERMISSION:
+		snprintf(answer, SOCK_STR_LEN, "%d", inproc.granted ? IPC_SUCCESS : IPC_FAIL);
+		break;
+	default:
+		snprintf(answer, SOCK_STR_LEN, "%d", IPC_FAIL);
+		break;
+	}
+	pthread_mutex_unlock(&inproc.lock);
+	return 0;
+}
+
+static int inprocGetStatus(int *status)
+{
+	*status = inproc.status;
+	return 0;
+}
+
+static int inprocWatchStatus(vconf_callback_fn func, void *data)
+{
+	pthread_mutex_lock(&inproc.lock);
+	inproc.watchFunc = func;
+	inproc.watchData = data;
+	pthread_mutex_unlock(&inproc.lock);
+	return 0;
+}
+
+static int inprocUnwatchStatus(vconf_callback_fn func)
+{
+	pthread_mutex_lock(&inproc.lock);
+	if (inproc.watchFunc == func) {
+		inproc.watchFunc = NULL;
+		inproc.watchData = NULL;
+	}
+	pthread_mutex_unlock(&inproc.lock);
+	return 0;
+}
+
+/* Nothing is pushed, and permission requests are not answered */
+static int inprocListen(void)
+{
+	return -1;
+}
+
+static void inprocUnlisten(int sock)
+{
+}
+
+static int inprocOpenChannel(void)
+{
+	pthread_mutex_lock(&inproc.lock);
+	inproc.opened++;
+	pthread_mutex_unlock(&inproc.lock);
+	return 0;
+}
+
+static void unlockInproc(void *data)
+{
+	pthread_mutex_unlock(&inproc.lock);
+}
+
+/* Wait for data like a read of the node, with a cancellation point */
+static int inprocReadChannel(int channel, void *buf, unsigned int len)
+{
+	unsigned int tail;
+	unsigned int first;
+
+	pthread_mutex_lock(&inproc.lock);
+	pthread_cleanup_push(unlockInproc, NULL);
+	while (inproc.len == 0) pthread_cond_wait(&inproc.cond, &inproc.lock);
+	if (len > inproc.len) len = inproc.len;
+	tail = inproc.head;
+	first = ACC_INPROC_RING_SIZE - tail;
+	if (first > len) first = len;
+	memcpy(buf, inproc.ring + tail, first);
+	memcpy((char *)buf + first, inproc.ring, len - first);
+	inproc.head = (tail + len) % ACC_INPROC_RING_SIZE;
+	inproc.len -= len;
+	pthread_cond_broadcast(&inproc.cond);
+	pthread_cleanup_pop(1);
+	return len;
+}
+
+static int inprocPollChannel(int channel)
+{
+	unsigned int len;
+	pthread_mutex_lock(&inproc.lock);
+	len = inproc.len;
+	pthread_mutex_unlock(&inproc.lock);
+	return (len > 0) ? 1 : 0;
+}
+
+static int inprocWriteChannel(int channel, const void *buf, unsigned int len)
+{
+	unsigned int pos;
+	unsigned int first;
+
+	pthread_mutex_lock(&inproc.lock);
+	pthread_cleanup_push(unlockInproc, NULL);
+	while (inproc.len == ACC_INPROC_RING_SIZE) pthread_cond_wait(&inproc.cond, &inproc.lock);
+	if (len > ACC_INPROC_RING_SIZE - inproc.len) len = ACC_INPROC_RING_SIZE - inproc.len;
+	pos = (inproc.head + inproc.len) % ACC_INPROC_RING_SIZE;
+	first = ACC_INPROC_RING_SIZE - pos;
+	if (first > len) first = len;
+	memcpy(inproc.ring + pos, buf, first);
+	memcpy(inproc.ring, (const char *)buf + first, len - first);
+	inproc.len += len;
+	pthread_cond_broadcast(&inproc.cond);
+	pthread_cleanup_pop(1);
+	return len;
+}
+
+/* The data left in the ring is dropped when the last channel is closed */
+static void inprocCloseChannel(int channel)
+{
+	pthread_mutex_lock(&inproc.lock);
+	if (inproc.opened > 0 && --inproc.opened == 0) {
+		inproc.head = 0;
+		inproc.len = 0;
+	}
+	pthread_mutex_unlock(&inproc.lock);
+}
+
+static ssize_t inprocStreamRead(void *cookie, char *buf, size_t size)
+{
+	if (size > UINT_MAX) size = UINT_MAX;
+	return inprocReadChannel(0, buf, size);
+}
+
+static ssize_t inprocStreamWrite(void *cookie, const char *buf, size_t size)
+{
+	size_t done = 0;
+	while (done < size) {
+		unsigned int len = (size - done > UINT_MAX) ? UINT_MAX : size - done;
+		done += inprocWriteChannel(0, buf + done, len);
+	}
+	return done;
+}
+
+static int inprocStreamClose(void *cookie)
+{
+	inprocCloseChannel(0);
+	return 0;
+}
+
+static FILE *inprocOpenStream(void)
+{
+	cookie_io_functions_t funcs = {
+		.read = inprocStreamRead,
+		.write = inprocStreamWrite,
+		.seek = NULL,
+		.close = inprocStreamClose,
+	};
+	FILE *stream = NULL;
+
+	inprocOpenChannel();
+	stream = fopencookie(NULL, "r+", funcs);
+	if (!stream) inprocCloseChannel(0);
+	return stream;
+}
+
+static const struct AccBackendOps inprocBackend = {
+	.name = "inproc",
+	.sharedState = false,
+	.request = inprocRequest,
+	.get_status = inprocGetStatus,
+	.watch_status = inprocWatchStatus,
+	.unwatch_status = inprocUnwatchStatus,
+	.listen_answers = inprocListen,
+	.listen_events = inprocListen,
+	.unlisten_events = inprocUnlisten,
+	.open_channel = inprocOpenChannel,
+	.read_channel = inprocReadChannel,
+	.poll_channel = inprocPollChannel,
+	.write_channel = inprocWriteChannel,
+	.close_channel = inprocCloseChannel,
+	.open_stream = inprocOpenStream,
+};
+
+/* Set the accessory which the in-process usb-server reports */
+void accInprocSetAccessory(const char *raw, bool granted)
+{
+	pthread_mutex_lock(&inproc.lock);
+	snprintf(inproc.raw, sizeof(inproc.raw), "%s", raw ? raw : "");
+	inproc.granted = granted;
+	pthread_mutex_unlock(&inproc.lock);
+}
+
+/* Change the status. The watcher is called in the calling thread, as vconf would do in the main loop */
+void accInprocSetStatus(int status)
+{
+	vconf_callback_fn func;
+	void *data;
+
+	pthread_mutex_lock(&inproc.lock);
+	inproc.status = status;
+	func = inproc.watchFunc;
+	data = inproc.watchData;
+	pthread_mutex_unlock(&inproc.lock);
+	if (func) func(NULL, data);
+}
+
+/* Make the backend selectable as "inproc" */
+int accInprocRegister(void)
+{
+	return accBackendRegister(&inprocBackend);
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ACC_INPROC_BACKEND_H__
+#define __ACC_INPROC_BACKEND_H__
+
+#include "usb_accessory_private.h"
+
+#define ACC_INPROC_RING_SIZE 65536
+
+int accInprocRegister(void);
+void accInprocSetAccessory(const char *raw, bool granted);
+void accInprocSetStatus(int status);
+
+#endif /* __ACC_INPROC_BACKEND_H__ */
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "acc_shm_writer.h"
+
+static uint32_t getNowMs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000ULL + now.tv_nsec / 1000000);
+}
+
+/* The writer makes seq odd while it updates the segment. See usb_accessory_shm.c */
+
+struct AccShmState *accShmWriterOpen(const char *name)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccShmState *state = NULL;
+	void *addr;
+	int fd;
+
+	if (!name) return NULL;
+	fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+	um_retvm_if(fd < 0, NULL, "FAIL: shm_open(%s)\n", name);
+	if (ftruncate(fd, sizeof(struct AccShmState)) < 0) {
+		USB_LOG("FAIL: ftruncate(%s)\n", name);
+		close(fd);
+		return NULL;
+	}
+	addr = mmap(NULL, sizeof(struct AccShmState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	um_retvm_if(addr == MAP_FAILED, NULL, "FAIL: mmap(%s)\n", name);
+
+	state = (struct AccShmState *)addr;
+	if (state->magic != ACC_SHM_MAGIC) {
+		state->seq = 0;
+		state->generation = 0;
+		state->status = VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED;
+		state->accCnt = 0;
+		state->heartbeat = getNowMs();
+		state->version = ACC_SHM_VERSION;
+		__sync_synchronize();
+		state->magic = ACC_SHM_MAGIC;
+	}
+	__USB_FUNC_EXIT__ ;
+	return state;
+}
+
+/* Unmap the segment, and remove it if name is given */
+void accShmWriterClose(struct AccShmState *state, const char *name)
+{
+	if (state) munmap(state, sizeof(struct AccShmState));
+	if (name) shm_unlink(name);
+}
+
+int accShmPublish(struct AccShmState *state, int status, const char *raw[], unsigned int accCnt)
+{
+	__USB_FUNC_ENTER__ ;
+	unsigned int i;
+	size_t len;
+
+	if (!state) return -1;
+	if (accCnt > ACC_SHM_MAX_ACC) return -1;
+	if (accCnt > 0 && !raw) return -1;
+
+	state->seq++;
+	__sync_synchronize();
+	state->status = status;
+	for (i = 0 ; i < accCnt ; i++) {
+		len = strnlen(raw[i], SOCK_STR_LEN - 1);
+		memcpy(state->acc[i].raw, raw[i], len);
+		state->acc[i].raw[len] = '\0';
+		state->acc[i].len = len;
+	}
+	state->accCnt = accCnt;
+	state->generation++;
+	__sync_synchronize();
+	state->seq++;
+	state->heartbeat = getNowMs();
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* usb-server calls this at least every ACC_SHM_HEARTBEAT_MS, also when nothing changes */
+void accShmBeat(struct AccShmState *state)
+{
+	if (state) state->heartbeat = getNowMs();
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ACC_SHM_WRITER_H__
+#define __ACC_SHM_WRITER_H__
+
+#include "usb_accessory_private.h"
+
+/* The writer side of the shared state segment.
+ * The tests stand in for usb-server with these and their own segment name */
+struct AccShmState *accShmWriterOpen(const char *name);
+void accShmWriterClose(struct AccShmState *state, const char *name);
+int accShmPublish(struct AccShmState *state, int status, const char *raw[], unsigned int accCnt);
+void accShmBeat(struct AccShmState *state);
+
+#endif /* __ACC_SHM_WRITER_H__ */
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Framed sessions on the in-process backend, which reads back what is written.
+ * Each session exchanges the capability header and the messages with itself.
+ * usage: acc_test_frame */
+
+#include <stdio.h>
+#include "usb_accessory.h"
+#include "usb_accessory_private.h"
+#include "acc_inproc_backend.h"
+
+#define TEST_ACC_INFO "Samsung|Test|Test accessory|1.0|http://www.tizen.org|0123456789"
+#define TEST_MESSAGE_MAX 4096
+
+static int failures = 0;
+static usb_accessory_h attached = NULL;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+struct frame_options {
+	unsigned int	options;
+	unsigned int	max;
+	unsigned int	sendHigh;
+	unsigned int	slice;
+};
+
+static usb_accessory_session_h open_session(const struct frame_options *opts, int *ret)
+{
+	usb_accessory_session_h session = NULL;
+
+	if (usb_accessory_session_create(attached, &session) != USB_ERROR_NONE) {
+		*ret = USB_ERROR_OPERATION_FAILED;
+		return NULL;
+	}
+	usb_accessory_session_set_framing(session, opts->options, opts->max);
+	if (opts->sendHigh > 0) usb_accessory_session_set_send_watermarks(session, 0, opts->sendHigh);
+	if (opts->slice > 0) usb_accessory_session_set_send_slice(session, opts->slice);
+	*ret = usb_accessory_session_start(session);
+	if (*ret != USB_ERROR_NONE) {
+		usb_accessory_session_destroy(session);
+		return NULL;
+	}
+	return session;
+}
+
+static void fill(char *buf, unsigned int len, bool compressible)
+{
+	unsigned int i;
+	for (i = 0 ; i < len ; i++)
+		buf[i] = compressible ? "framed"[i % 6] : (char)(rand() & 0xFF);
+}
+
+/* Send a message to itself and compare what comes back */
+static void round_trip(usb_accessory_session_h session, unsigned int len, bool compressible)
+{
+	static char sent[TEST_MESSAGE_MAX];
+	static char received[TEST_MESSAGE_MAX];
+	unsigned int receivedLen = 0;
+	int retry = 0;
+	int ret;
+
+	fill(sent, len, compressible);
+	/* The send queue of a buffered session may still hold the last frame */
+	while ((ret = usb_accessory_session_send_message(session, sent, len)) == USB_ERROR_RESOURCE_BUSY
+			&& retry++ < 1000)
+		usleep(1000);
+	CHECK(ret == USB_ERROR_NONE);
+	if (ret != USB_ERROR_NONE) return;
+	CHECK(usb_accessory_session_receive_message(session, received, sizeof(received), &receivedLen) == USB_ERROR_NONE);
+	CHECK(receivedLen == len);
+	CHECK(receivedLen == len && !memcmp(sent, received, len));
+}
+
+static void test_framed(unsigned int options, unsigned int slice)
+{
+	struct frame_options opts = { options, TEST_MESSAGE_MAX, 0, slice };
+	usb_accessory_session_h session = NULL;
+	unsigned int agreed = 0;
+	unsigned int max = 0;
+	int ret;
+
+	session = open_session(&opts, &ret);
+	CHECK(session != NULL);
+	if (!session) return;
+	CHECK(usb_accessory_session_get_framing(session, &agreed, &max) == USB_ERROR_NONE);
+	CHECK(agreed == options);
+	CHECK(max == TEST_MESSAGE_MAX);
+	round_trip(session, 0, false);
+	round_trip(session, 1, false);
+	round_trip(session, 100, true);
+	round_trip(session, TEST_MESSAGE_MAX, true);
+	round_trip(session, TEST_MESSAGE_MAX, false);
+	usb_accessory_session_destroy(session);
+}
+
+/* The largest frame of a buffered session is lowered to fit in its send queue */
+static void test_buffered(unsigned int options)
+{
+	struct frame_options opts = { options, TEST_MESSAGE_MAX, 64, 0 };
+	usb_accessory_session_h session = NULL;
+	unsigned int agreed = 0;
+	unsigned int max = 0;
+	int ret;
+
+	session = open_session(&opts, &ret);
+	CHECK(session != NULL);
+	if (!session) return;
+	CHECK(usb_accessory_session_get_framing(session, &agreed, &max) == USB_ERROR_NONE);
+	CHECK(max > 0 && max + ACC_FRAME_HEADER_LEN <= 64 * ACC_SEND_QUEUE_LIMIT_FACTOR);
+	round_trip(session, 1, false);
+	round_trip(session, max, false);
+	round_trip(session, max, true);
+	usb_accessory_session_destroy(session);
+
+	/* Not even the capability header fits */
+	opts.sendHigh = 4;
+	session = open_session(&opts, &ret);
+	CHECK(session == NULL);
+	CHECK(ret == USB_ERROR_OPERATION_FAILED);
+}
+
+/* Write a frame header as the peer would, bypassing the framing */
+static void put_header(usb_accessory_session_h session, unsigned int len, unsigned int info)
+{
+	unsigned char header[ACC_FRAME_HEADER_LEN];
+	unsigned int i;
+
+	for (i = 0 ; i < 4 ; i++) {
+		header[i] = (len >> (8 * i)) & 0xFF;
+		header[4 + i] = (info >> (8 * i)) & 0xFF;
+	}
+	CHECK(accSessionWriteAll(session, (const char *)header, sizeof(header)) == sizeof(header));
+}
+
+/* A broken frame with a sane length is skipped. Without one, the session stops receiving */
+static void test_corrupt(void)
+{
+	struct frame_options opts = { 0, TEST_MESSAGE_MAX, 0, 0 };
+	usb_accessory_session_h session = NULL;
+	static char payload[TEST_MESSAGE_MAX];
+	static char received[TEST_MESSAGE_MAX];
+	unsigned int receivedLen = 0;
+	int ret;
+
+	session = open_session(&opts, &ret);
+	CHECK(session != NULL);
+	if (!session) return;
+
+	/* The frame length does not match the message length */
+	memset(payload, 0x55, sizeof(payload));
+	put_header(session, 100, 10);
+	CHECK(accSessionWriteAll(session, payload, 100) == 100);
+	CHECK(usb_accessory_session_receive_message(session, received, sizeof(received), &receivedLen)
+			== USB_ERROR_OPERATION_FAILED);
+	round_trip(session, 100, false);
+
+	/* The frame length is beyond any frame */
+	put_header(session, TEST_MESSAGE_MAX + 1, TEST_MESSAGE_MAX + 1);
+	CHECK(usb_accessory_session_receive_message(session, received, sizeof(received), &receivedLen)
+			== USB_ERROR_OPERATION_FAILED);
+	CHECK(usb_accessory_session_send_message(session, payload, 10) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_receive_message(session, received, sizeof(received), &receivedLen)
+			== USB_ERROR_OPERATION_FAILED);
+	usb_accessory_session_destroy(session);
+}
+
+int main(int argc, char **argv)
+{
+	struct usb_accessory_list *accList = NULL;
+	bool lz4 = accLz4()->compress_bound(1) > 0;
+
+	if (accInprocRegister() < 0 || accBackendSelect("inproc") < 0) {
+		fprintf(stderr, "FAIL: No inproc backend\n");
+		return 1;
+	}
+	accInprocSetAccessory(TEST_ACC_INFO, true);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	if (!getAccList(&accList, NULL) || !accList) {
+		fprintf(stderr, "FAIL: No accessory is attached\n");
+		return 1;
+	}
+	attached = accList->accessory;
+	accList->accessory = NULL;
+	freeAccList(accList);
+	acc_handle_get(attached)->accPermission = true;
+
+	test_framed(0, 0);
+	test_framed(0, 1000);
+	test_buffered(0);
+	test_corrupt();
+	if (lz4) {
+		test_framed(USB_ACCESSORY_FRAME_LZ4, 0);
+		test_framed(USB_ACCESSORY_FRAME_LZ4, 1000);
+		test_buffered(USB_ACCESSORY_FRAME_LZ4);
+	} else {
+		printf("acc_test_frame: LZ4 is not available, skipped\n");
+	}
+
+	acc_handle_free(attached);
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("acc_test_frame: passed\n");
+	return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* The accessory state as read from the segment of usb-server.
+ * The test publishes its own segment and reads it through the public API.
+ * usage: acc_test_shm */
+
+#include <stdio.h>
+#include "usb_accessory.h"
+#include "usb_accessory_private.h"
+#include "acc_shm_writer.h"
+
+#define TEST_ACC_INFO "Samsung|Test|Test accessory|1.0|http://www.tizen.org|0123456789"
+#define TEST_ACC_INFO2 "Samsung|Other|Other accessory|2.0|http://www.tizen.org|9876543210"
+
+static int failures = 0;
+static char shmTestName[64];
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+struct attached {
+	int cnt;
+	char serial[ACC_ELEMENT_LEN];
+};
+
+static bool attached_cb(usb_accessory_h handle, void *data)
+{
+	struct attached *attached = (struct attached *)data;
+	char *serial = NULL;
+
+	if (attached->cnt++ == 0 && usb_accessory_get_serial(handle, &serial) == USB_ERROR_NONE) {
+		snprintf(attached->serial, sizeof(attached->serial), "%s", serial);
+		free(serial);
+	}
+	return true;
+}
+
+static int count_attached(usb_accessory_filter_h filter, struct attached *attached)
+{
+	memset(attached, 0, sizeof(*attached));
+	if (filter) return usb_accessory_foreach_attached_with_filter(filter, attached_cb, attached);
+	return usb_accessory_foreach_attached(attached_cb, attached);
+}
+
+static void test_disconnected(struct AccShmState *state)
+{
+	struct attached attached;
+	bool connected = true;
+
+	CHECK(accShmPublish(state, VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED, NULL, 0) == 0);
+	CHECK(usb_accessory_is_connected(NULL, &connected) == USB_ERROR_NONE);
+	CHECK(connected == false);
+	CHECK(count_attached(NULL, &attached) == USB_ERROR_NONE);
+	CHECK(attached.cnt == 0);
+}
+
+static void test_connected(struct AccShmState *state)
+{
+	const char *raw[] = { TEST_ACC_INFO };
+	struct attached attached;
+	bool connected = false;
+
+	CHECK(accShmPublish(state, VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED, raw, 1) == 0);
+	CHECK(usb_accessory_is_connected(NULL, &connected) == USB_ERROR_NONE);
+	CHECK(connected == true);
+	CHECK(count_attached(NULL, &attached) == USB_ERROR_NONE);
+	CHECK(attached.cnt == 1);
+	CHECK(!strcmp(attached.serial, "0123456789"));
+}
+
+static void test_filtered(struct AccShmState *state)
+{
+	const char *raw[] = { TEST_ACC_INFO, TEST_ACC_INFO2 };
+	usb_accessory_filter_h filter = NULL;
+	struct attached attached;
+
+	CHECK(accShmPublish(state, VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED, raw, 2) == 0);
+	CHECK(count_attached(NULL, &attached) == USB_ERROR_NONE);
+	CHECK(attached.cnt == 2);
+
+	CHECK(usb_accessory_filter_create(&filter) == USB_ERROR_NONE);
+	CHECK(usb_accessory_filter_add_rule(filter, USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_EXACT, "Other") == USB_ERROR_NONE);
+	CHECK(count_attached(filter, &attached) == USB_ERROR_NONE);
+	CHECK(attached.cnt == 1);
+	CHECK(!strcmp(attached.serial, "9876543210"));
+	usb_accessory_filter_destroy(filter);
+
+	filter = NULL;
+	CHECK(usb_accessory_filter_create(&filter) == USB_ERROR_NONE);
+	CHECK(usb_accessory_filter_add_rule(filter, USB_ACCESSORY_FIELD_MANUFACTURER, USB_ACCESSORY_MATCH_EXACT, "Nobody") == USB_ERROR_NONE);
+	CHECK(count_attached(filter, &attached) == USB_ERROR_NONE);
+	CHECK(attached.cnt == 0);
+	usb_accessory_filter_destroy(filter);
+}
+
+/* A segment whose writer stopped beating is not believed, until the writer beats again */
+static void test_stale(struct AccShmState *state)
+{
+	const char *raw[] = { TEST_ACC_INFO };
+	char buf[SOCK_STR_LEN];
+	int status = -1;
+
+	CHECK(accShmPublish(state, VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED, raw, 1) == 0);
+	CHECK(accShmReadStatus(&status) == 0);
+	CHECK(status == VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+
+	state->heartbeat -= ACC_SHM_STALE_MS + 1000;
+	CHECK(accShmReadStatus(&status) < 0);
+	CHECK(accShmReadAcc(0, buf, sizeof(buf), NULL) < 0);
+
+	/* The stale mapping is dropped, and looked up again on the next use */
+	accShmBeat(state);
+	accShmSetName(NULL);
+	accShmSetName(shmTestName);
+	CHECK(accShmReadStatus(&status) == 0);
+	CHECK(accShmReadAcc(0, buf, sizeof(buf), NULL) == 0);
+	CHECK(!strcmp(buf, TEST_ACC_INFO));
+}
+
+int main(int argc, char **argv)
+{
+	char *name = shmTestName;
+	struct AccShmState *state = NULL;
+
+	snprintf(name, sizeof(shmTestName), "/acc_test_shm.%d", (int)getpid());
+	state = accShmWriterOpen(name);
+	if (!state) {
+		fprintf(stderr, "FAIL: accShmWriterOpen(%s)\n", name);
+		return 1;
+	}
+	accShmSetName(name);
+
+	test_disconnected(state);
+	test_connected(state);
+	test_filtered(state);
+	test_stale(state);
+	test_disconnected(state);
+
+	accShmSetName(NULL);
+	accShmWriterClose(state, name);
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("acc_test_shm: passed\n");
+	return 0;
+}
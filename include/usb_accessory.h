@@ -18,6 +18,7 @@
 #define __TIZEN_SYSTEM_USB_ACCESSORY_H__
 
 #include <stdio.h>
+#include <stdint.h>
 #include <tizen.h>
 
 /**
@@ -29,6 +30,11 @@
 extern "C" {
 #endif
 
+/* The library is built with hidden visibility, and only these declarations are exported */
+#if defined(__GNUC__) && __GNUC__ >= 4
+#pragma GCC visibility push(default)
+#endif
+
 /**
  * @brief Enumerations of error code for usb accessory.
  */
@@ -39,7 +45,9 @@ typedef enum
     USB_ERROR_NOT_CONNECTED     = TIZEN_ERROR_ENDPOINT_NOT_CONNECTED,
 	USB_ERROR_PERMISSION_DENIED = TIZEN_ERROR_PERMISSION_DENIED,
     USB_ERROR_OPERATION_FAILED  = TIZEN_ERROR_SYSTEM_CLASS | 0x62,
-	USB_ERROR_NOT_SUPPORTED 	= TIZEN_ERROR_NOT_SUPPORT_API
+	USB_ERROR_NOT_SUPPORTED 	= TIZEN_ERROR_NOT_SUPPORT_API,
+    USB_ERROR_INVALID_OPERATION = TIZEN_ERROR_INVALID_OPERATION,
+    USB_ERROR_RESOURCE_BUSY     = TIZEN_ERROR_RESOURCE_BUSY
 } usb_error_e;
 
 /**
@@ -47,6 +55,260 @@ typedef enum
  */
 typedef struct usb_accessory_s* usb_accessory_h;
 
+/**
+ * @brief The USB Accessory session handle.
+ */
+typedef struct usb_accessory_session_s* usb_accessory_session_h;
+
+/**
+ * @brief The handle of a buffer received from the accessory.
+ * @details It is a view of a buffer of the pool of a session, which returns to the pool when the last view of it is released.
+ */
+typedef struct usb_accessory_buffer_s* usb_accessory_buffer_h;
+
+/**
+ * @brief The handle of a consumer of the broadcast ring of a session.
+ * @details Each consumer reads every entry of the ring at its own pace.
+ */
+typedef struct usb_accessory_consumer_s* usb_accessory_consumer_h;
+
+/**
+ * @brief Options of the receive buffer pool of a session.
+ */
+typedef enum
+{
+    USB_ACCESSORY_BUFFER_POOL_HUGEPAGES = 0x1,   /**< Back the buffers with hugepages if the system can */
+} usb_accessory_buffer_pool_option_e;
+
+/**
+ * @brief The round trip latency and the traffic of a session.
+ * @details A round trip starts with a write and ends with the next read which returns data.
+ */
+typedef struct
+{
+    unsigned long long exchanges;           /**< The number of round trips measured */
+    unsigned long long min_us;              /**< The shortest round trip in microseconds */
+    unsigned long long max_us;              /**< The longest round trip in microseconds */
+    unsigned long long mean_us;             /**< The average round trip in microseconds */
+    unsigned long long p50_us;              /**< The median round trip in microseconds */
+    unsigned long long p90_us;              /**< The 90th percentile round trip in microseconds */
+    unsigned long long p99_us;              /**< The 99th percentile round trip in microseconds */
+    unsigned long long p999_us;             /**< The 99.9th percentile round trip in microseconds */
+    unsigned long long bytes_sent;          /**< The number of bytes written to the accessory */
+    unsigned long long bytes_received;      /**< The number of bytes read from the accessory */
+    unsigned long long writes;              /**< The number of writes to the accessory */
+    unsigned long long reads;               /**< The number of reads from the accessory which returned data */
+    double send_rate;                       /**< Bytes sent per second since the session started or the stats were reset */
+    double receive_rate;                    /**< Bytes received per second since the session started or the stats were reset */
+} usb_accessory_session_stats_s;
+
+/**
+ * @brief What a real-time session could apply, and the intervals between its reads.
+ * @details The jitter is the smoothed difference of consecutive intervals as in RFC 3550.
+ */
+typedef struct
+{
+    bool affinity;                          /**< The I/O threads run on the requested CPU */
+    bool realtime;                          /**< The I/O threads run with SCHED_FIFO */
+    bool memory_locked;                     /**< The buffers of the I/O threads are locked in memory */
+    unsigned long long intervals;           /**< The number of intervals measured */
+    unsigned long long min_interval_us;     /**< The shortest interval in microseconds */
+    unsigned long long max_interval_us;     /**< The longest interval in microseconds */
+    unsigned long long mean_interval_us;    /**< The average interval in microseconds */
+    unsigned long long jitter_us;           /**< The smoothed jitter in microseconds */
+    unsigned long long max_jitter_us;       /**< The largest difference of consecutive intervals in microseconds */
+} usb_accessory_session_rt_stats_s;
+
+/**
+ * @brief The cost and the gain of busy polling on a session.
+ * @details
+ * Some reads which would poll wait in the read instead, so that the latency without polling is measured on the same traffic.
+ * The latency saved is estimated from the difference of the two averages.
+ */
+typedef struct
+{
+    unsigned long long window_us;           /**< The current polling window in microseconds */
+    unsigned long long hits;                /**< The number of polls which found data */
+    unsigned long long misses;              /**< The number of polls which ran out of the window */
+    unsigned long long spin_us;             /**< The CPU time spent polling in microseconds */
+    unsigned long long polled_mean_us;      /**< The average wait of the reads which polled in microseconds */
+    unsigned long long probes;              /**< The number of reads which waited in the read to measure it */
+    unsigned long long probe_mean_us;       /**< The average wait of those reads in microseconds */
+    unsigned long long saved_us;            /**< The estimated latency saved by polling in microseconds */
+} usb_accessory_session_poll_stats_s;
+
+/**
+ * @brief The transfer sizes chosen by the autotuner of a session.
+ */
+typedef struct
+{
+    bool settled;                           /**< The sizes are chosen. Otherwise they are being probed */
+    unsigned int read_size;                 /**< The size of each read from the accessory in bytes */
+    unsigned int read_depth;                /**< The number of reads ahead of the application */
+    unsigned int write_size;                /**< The largest write to the accessory in bytes */
+    double rate;                            /**< Bytes per second with the chosen sizes, or the best probed so far */
+    unsigned int rounds;                    /**< The number of times the sizes were probed */
+} usb_accessory_session_tune_s;
+
+/**
+ * @brief Enumerations of where the connection and permission callbacks are called.
+ */
+typedef enum
+{
+    USB_ACCESSORY_DISPATCH_INLINE = 0,      /**< Where the events are received. This is the default */
+    USB_ACCESSORY_DISPATCH_MAIN_CONTEXT,    /**< In a GMainContext */
+    USB_ACCESSORY_DISPATCH_WORKER_POOL      /**< In worker threads of the library */
+} usb_accessory_dispatch_e;
+
+/**
+ * @brief Enumerations of the options of a framed session.
+ */
+typedef enum
+{
+    USB_ACCESSORY_FRAME_LZ4 = 0x1,          /**< Compress messages with LZ4 if the peer supports it */
+} usb_accessory_frame_option_e;
+
+/**
+ * @brief Enumerations of the classes of messages sent on a framed session.
+ */
+typedef enum
+{
+    USB_ACCESSORY_SEND_CONTROL = 0,         /**< Small messages which are sent before the next slice of bulk messages */
+    USB_ACCESSORY_SEND_BULK,                /**< Large messages which may be sent in slices */
+} usb_accessory_send_class_e;
+
+/**
+ * @brief The messages of a class sent on a framed session.
+ * @details The wait of a message is from the call until its first frame is sent.
+ */
+typedef struct
+{
+    unsigned long long messages;            /**< The number of messages sent */
+    unsigned long long bytes;               /**< The number of bytes of the messages sent */
+    unsigned long long slices;              /**< The number of frames sent */
+    unsigned int queued;                    /**< The number of messages waiting or being sent now */
+    unsigned int max_queued;                /**< The largest number of messages waiting or being sent */
+    unsigned long long mean_wait_us;        /**< The average wait of the messages sent in microseconds */
+    unsigned long long max_wait_us;         /**< The longest wait of the messages sent in microseconds */
+} usb_accessory_send_class_stats_s;
+
+/**
+ * @brief Enumerations of what the broadcast ring of a session does with a consumer which falls behind.
+ */
+typedef enum
+{
+    USB_ACCESSORY_BROADCAST_BLOCK = 0,      /**< Receiving waits until the slowest consumer reads on */
+    USB_ACCESSORY_BROADCAST_DROP,           /**< A consumer which falls a whole ring behind is dropped */
+} usb_accessory_broadcast_policy_e;
+
+/**
+ * @brief What a consumer of a broadcast ring read, and how far it is behind.
+ */
+typedef struct
+{
+    unsigned long long entries;             /**< The number of entries read */
+    unsigned long long bytes;               /**< The number of bytes of the entries read */
+    unsigned int lag;                       /**< The number of entries received and not read yet */
+    unsigned int max_lag;                   /**< The largest lag seen when reading */
+    unsigned long long stalls;              /**< The number of times receiving waited for this consumer */
+    unsigned long long stall_us;            /**< The time receiving waited for this consumer in microseconds */
+    bool dropped;                           /**< The consumer was dropped for falling a whole ring behind */
+} usb_accessory_consumer_stats_s;
+
+/**
+ * @brief Enumerations of the flow events of a buffered session.
+ */
+typedef enum
+{
+    USB_ACCESSORY_FLOW_WRITABLE = 0,        /**< The send queue went down to the low watermark after pressure */
+    USB_ACCESSORY_FLOW_SEND_PRESSURE,       /**< The send queue went up to the high watermark */
+    USB_ACCESSORY_FLOW_READABLE,            /**< Data arrived in the empty receive queue */
+    USB_ACCESSORY_FLOW_RECEIVE_PRESSURE     /**< The receive queue went up to the high watermark */
+} usb_accessory_flow_event_e;
+
+/**
+ * @brief Called in the main loop when the queues of a buffered session cross their watermarks.
+ *
+ * @param[in] session       The session.
+ * @param[in] event         The flow event.
+ * @param[in] queued        The number of bytes in the queue of the event.
+ * @param[in] user_data     The user data passed from usb_accessory_session_set_flow_cb().
+ *
+ * @see usb_accessory_session_set_flow_cb()
+ */
+typedef void (*usb_accessory_flow_cb)(usb_accessory_session_h session, usb_accessory_flow_event_e event, unsigned int queued, void *user_data);
+
+/**
+ * @brief Called by a worker of the decode pipeline to decode a unit of data.
+ * @details The unit is a message on a framed session, or the data of a read otherwise.
+ *
+ * @param[in]  in           The unit read from the accessory.
+ * @param[in]  in_len       The length of the unit.
+ * @param[out] out          The buffer for the decoded data.
+ * @param[in]  out_size     The size of @a out.
+ * @param[out] out_len      The length of the decoded data.
+ * @param[in]  user_data    The user data passed from usb_accessory_session_set_pipeline().
+ * @return 0 on success, otherwise an error value which is passed to #usb_accessory_deliver_cb as a negative length
+ */
+typedef int (*usb_accessory_decode_cb)(const void *in, unsigned int in_len, void *out, unsigned int out_size, unsigned int *out_len, void *user_data);
+
+/**
+ * @brief Called in the order of the units with the decoded data.
+ * @details After the last unit, it is called once more with NULL @a data and 0 @a len.
+ * That call is also made when the session is destroyed before the data ends,
+ * and the units decoded but not delivered by then are dropped.
+ *
+ * @param[in] seq           The sequence number of the unit from 0.
+ * @param[in] data          The decoded data, or NULL if the decoding failed.
+ * @param[in] len           The length of the decoded data, or the negative error value of the decoding.
+ * @param[in] user_data     The user data passed from usb_accessory_session_set_pipeline().
+ */
+typedef void (*usb_accessory_deliver_cb)(unsigned long long seq, const void *data, int len, void *user_data);
+
+/**
+ * @brief Called with each unit of data received into the buffer pool of a session.
+ * @details
+ * The unit is a message on a framed session, or the data of a read otherwise.
+ * After the last unit, it is called once more with NULL @a buffer.
+ *
+ * @remark
+ * The callback owns one reference of @a buffer, and it must release it with usb_accessory_buffer_unref(),
+ * now or later from any thread. The receiving waits while all the buffers of the pool are held.
+ *
+ * @param[in] session       The session.
+ * @param[in] buffer        The received data.
+ * @param[in] user_data     The user data passed from usb_accessory_session_set_buffer_pool().
+ */
+typedef void (*usb_accessory_receive_cb)(usb_accessory_session_h session, usb_accessory_buffer_h buffer, void *user_data);
+
+/**
+ * @brief The USB Accessory filter handle.
+ */
+typedef struct usb_accessory_filter_s* usb_accessory_filter_h;
+
+/**
+ * @brief Enumerations of the information fields of usb accessory.
+ */
+typedef enum
+{
+    USB_ACCESSORY_FIELD_MANUFACTURER = 0,   /**< Manufacturer name */
+    USB_ACCESSORY_FIELD_MODEL,              /**< Model name */
+    USB_ACCESSORY_FIELD_DESCRIPTION,        /**< Description */
+    USB_ACCESSORY_FIELD_VERSION,            /**< Version */
+    USB_ACCESSORY_FIELD_URI,                /**< URI */
+    USB_ACCESSORY_FIELD_SERIAL              /**< Serial number */
+} usb_accessory_field_e;
+
+/**
+ * @brief Enumerations of the ways to match a field of usb accessory with a pattern.
+ */
+typedef enum
+{
+    USB_ACCESSORY_MATCH_EXACT = 0,  /**< The field is the same as the pattern */
+    USB_ACCESSORY_MATCH_PREFIX,     /**< The field starts with the pattern */
+    USB_ACCESSORY_MATCH_GLOB        /**< The field matches the pattern, where '*' matches any string and '?' matches any character */
+} usb_accessory_match_e;
+
 /**
  * @brief Called when the usb accessory is connected or disconnected.
  *
@@ -61,6 +323,16 @@ typedef struct usb_accessory_s* usb_accessory_h;
  */
 typedef void (*usb_accessory_connection_changed_cb)(usb_accessory_h accessory, bool is_connected, void *data);
 
+/**
+ * @brief Called to set the options of a session opened on connect, before it starts.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] user_data     The user data passed from usb_accessory_set_prewarm().
+ *
+ * @see usb_accessory_set_prewarm()
+ */
+typedef void (*usb_accessory_session_prepare_cb)(usb_accessory_session_h session, void *user_data);
+
 /**
  * @brief Called when the permission of usb accessory is granted.
  *
@@ -90,6 +362,49 @@ typedef void (*usb_accessory_permission_response_cb)(usb_accessory_h accessory,
  */
 typedef bool (*usb_accessory_attached_cb)(usb_accessory_h handle, void *data);
 
+/**
+ * @brief Enumerations of the permission verdicts kept in the cache.
+ */
+typedef enum
+{
+    USB_ACCESSORY_PERMISSION_UNKNOWN = 0,   /**< The permission was not asked, or the verdict is too old */
+    USB_ACCESSORY_PERMISSION_GRANTED,       /**< The permission was granted */
+    USB_ACCESSORY_PERMISSION_DENIED         /**< The permission was denied */
+} usb_accessory_permission_e;
+
+/**
+ * @brief Called with an accessory which was attached when the app saw it last time.
+ *
+ * @remark
+ * the handle of accessory will be free after end of usb_accessory_cached_cb().
+ * The handle is not allowed to open the accessory, even if the verdict is #USB_ACCESSORY_PERMISSION_GRANTED.
+ *
+ * @param[in] accessory     The handle of the accessory made from the cache.
+ * @param[in] permission    The last permission verdict.
+ * @param[in] user_data     The user data passed from the foreach function.
+ *
+ * @return                  @c true to continue with the next iteration of the loop, \n
+ *                          @c false to break out of the loop.
+ *
+ * @see usb_accessory_foreach_cached()
+ */
+typedef bool (*usb_accessory_cached_cb)(usb_accessory_h accessory, usb_accessory_permission_e permission, void *user_data);
+
+/**
+ * @brief Called when usb-server does not agree with the answer from the cache.
+ *
+ * @remark
+ * the handle of accessory will be free after end of usb_accessory_cache_changed_cb()
+ *
+ * @param[in] accessory     The handle of the accessory.
+ * @param[in] is_attached   True if the accessory is attached, false if the cache was wrong to say so.
+ * @param[in] permission    The permission verdict of usb-server, or the cached one if the accessory is not attached.
+ * @param[in] user_data     The user data passed from the foreach function.
+ *
+ * @see usb_accessory_foreach_cached()
+ */
+typedef void (*usb_accessory_cache_changed_cb)(usb_accessory_h accessory, bool is_attached, usb_accessory_permission_e permission, void *user_data);
+
 /**
  * @brief Clone the handle of usb accessory.
  * 
@@ -139,6 +454,28 @@ int usb_accessory_destroy(usb_accessory_h handle);
  */
 int usb_accessory_foreach_attached(usb_accessory_attached_cb callback, void *user_data);
 
+/**
+ * @brief Retrieves the attached usb accessory handles which match a filter.
+ * @details
+ * usb_accessory_attached_cb() will be called once for each handle of attached usb accessory which matches @a filter.
+ * The accessories which do not match are dropped without making handles for them.
+ *
+ * @remark
+ * the handle of accessory will be free after end of usb_accessory_attached_cb().
+ *
+ * @param[in] filter        The filter to match the accessories with.
+ * @param[in] callback      The iteration callback function.
+ * @param[in] user_data     The user data to be passed to the callback function.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ *
+ * @see usb_accessory_filter_create()
+ */
+int usb_accessory_foreach_attached_with_filter(usb_accessory_filter_h filter, usb_accessory_attached_cb callback, void *user_data);
+
 /**
  * @brief Register callback function to be invoked when usb accessory connected or disconnected.
  * @details
@@ -173,6 +510,100 @@ int usb_accessory_set_connection_changed_cb(usb_accessory_connection_changed_cb
  */
 int usb_accessory_connection_unset_cb(void); 
 
+/**
+ * @brief Set the filter for connection events.
+ * @details
+ * usb_accessory_connection_changed_cb() is called only for the accessories which match @a filter.
+ *
+ * @remark
+ * The filter is copied, so @a filter can be destroyed after this function returns.
+ *
+ * @param[in] filter        The filter to match the accessories with, or NULL to remove the filter.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ *
+ * @see usb_accessory_filter_create()
+ */
+int usb_accessory_set_connection_filter(usb_accessory_filter_h filter);
+
+/**
+ * @brief Open a session as soon as an accessory of an identity connects.
+ * @details
+ * When an accessory which matches @a identity connects, the library asks for its permission,
+ * and if it is granted, creates a session, calls @a prepare with it, and starts it,
+ * while the connection event is delivered. usb_accessory_connection_changed_cb() is called
+ * when the session is ready, and it can take the session with usb_accessory_get_prewarmed_session().
+ * A session which is not taken in the callback is destroyed after it.
+ *
+ * @remark
+ * @a prepare is called in a thread of the library.
+ * The connection events after a prewarmed one wait until its session is ready, so that they stay in order.
+ * With #USB_ACCESSORY_DISPATCH_INLINE, those events are delivered in the default main context.
+ *
+ * @param[in] identity      The filter of the accessories to open sessions for. It is copied. NULL stops prewarming.
+ * @param[in] prepare       The function to set the options of the session, or NULL to start it with the defaults.
+ * @param[in] user_data     The user data to be passed to @a prepare.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ *
+ * @see usb_accessory_get_prewarmed_session()
+ */
+int usb_accessory_set_prewarm(usb_accessory_filter_h identity, usb_accessory_session_prepare_cb prepare, void *user_data);
+
+/**
+ * @brief Take the session opened on connect, in usb_accessory_connection_changed_cb().
+ *
+ * @param[in]  accessory    The accessory passed to usb_accessory_connection_changed_cb().
+ * @param[out] session      The started session. Destroy it with usb_accessory_session_destroy().
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    No session is opened for the accessory
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported
+ *
+ * @see usb_accessory_set_prewarm()
+ */
+int usb_accessory_get_prewarmed_session(usb_accessory_h accessory, usb_accessory_session_h *session);
+
+/**
+ * @brief Set the settle window for connection events.
+ * @details
+ * When the window is not 0, changes of the connection status are collected until the status
+ * stays unchanged for @a settle_ms milliseconds. Then usb_accessory_connection_changed_cb() is
+ * called once with the net status, and nothing is called if the status ended where it started.
+ *
+ * @remark
+ * The default value is 0, which calls usb_accessory_connection_changed_cb() for every change.
+ *
+ * @param[in] settle_ms     The settle window in milliseconds.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ *
+ * @see usb_accessory_get_suppressed_event_count()
+ */
+int usb_accessory_set_connection_debounce(unsigned int settle_ms);
+
+/**
+ * @brief Get the number of connection status changes which were not delivered to the app.
+ *
+ * @param[out] count        The number of suppressed status changes.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ *
+ * @see usb_accessory_set_connection_debounce()
+ */
+int usb_accessory_get_suppressed_event_count(unsigned int *count);
+
 /**
  * @brief Check whether or not the accessory has permission to access to the host.
  *
@@ -294,6 +725,866 @@ int usb_accessory_is_connected(usb_accessory_h accessory, bool *is_connected);
  */
 int usb_accessory_request_permission(usb_accessory_h accessory, usb_accessory_permission_response_cb callback, void* user_data);
 
+/**
+ * @brief Get the fingerprint of the accessory.
+ * @details
+ * The fingerprint is a 64-bit hash of the manufacturer, model, version and serial of the accessory.
+ * It is the same for the same accessory across connections and processes,
+ * so it can be used as a key to recognize the accessory.
+ *
+ * @param[in]  accessory     The usb accessory handle.
+ * @param[out] fingerprint   The fingerprint of the accessory.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported with the emulator
+ *
+ * @see usb_accessory_equals()
+ */
+int usb_accessory_get_fingerprint(usb_accessory_h accessory, uint64_t *fingerprint);
+
+/**
+ * @brief Check whether or not two handles are of the same accessory.
+ * @details
+ * The fingerprints of the accessories are compared,
+ * and then their manufacturer, model, version and serial.
+ *
+ * @param[in]  accessory1    The usb accessory handle.
+ * @param[in]  accessory2    The usb accessory handle to compare with.
+ * @param[out] is_equal      True if they are the same accessory.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported with the emulator
+ *
+ * @see usb_accessory_get_fingerprint()
+ */
+int usb_accessory_equals(usb_accessory_h accessory1, usb_accessory_h accessory2, bool *is_equal);
+
+/**
+ * @brief Create a filter to select usb accessories.
+ * @details
+ * A filter without any rule matches every accessory.
+ * Rules for different fields must all match, and one of the rules for the same field must match.
+ *
+ * @remark
+ * the filter must be destroyed by #usb_accessory_filter_destroy()
+ *
+ * @param[out] filter       The created filter.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported with the emulator
+ *
+ * @see usb_accessory_filter_add_rule()
+ */
+int usb_accessory_filter_create(usb_accessory_filter_h *filter);
+
+/**
+ * @brief Destroy a filter.
+ *
+ * @param[in] filter        The filter to destroy.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported with the emulator
+ */
+int usb_accessory_filter_destroy(usb_accessory_filter_h filter);
+
+/**
+ * @brief Add a rule to a filter.
+ *
+ * @param[in] filter        The filter to add the rule to.
+ * @param[in] field         The field of usb accessory to match.
+ * @param[in] match         The way to match the field with @a pattern.
+ * @param[in] pattern       The pattern. It must be shorter than 256 bytes.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported with the emulator
+ */
+int usb_accessory_filter_add_rule(usb_accessory_filter_h filter, usb_accessory_field_e field, usb_accessory_match_e match, const char *pattern);
+
+/**
+ * @brief Keep the accessories seen by the app and the permission verdicts in a file.
+ * @details
+ * The file is updated when the app gets the attached accessories or checks the permission,
+ * and the processes of the app can share it. It is also set by the USB_ACCESSORY_CACHE environment variable.
+ *
+ * @param[in] path          The path of the cache file, or NULL to stop using the cache.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_OPERATION_FAILED     The file cannot be opened
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported with the emulator
+ *
+ * @see usb_accessory_foreach_cached()
+ */
+int usb_accessory_set_cache(const char *path);
+
+/**
+ * @brief Retrieves the accessories attached at the last time from the cache, and confirms them with usb-server.
+ * @details
+ * @a callback is called before this function returns, without any request to usb-server.
+ * Then a thread gets the attached accessories and their permission from usb-server,
+ * and @a changed_cb is called only for the accessories whose state differs from the cached one.
+ * The changes are dispatched as set by usb_accessory_set_dispatch(). In the inline mode, @a changed_cb is called in the thread.
+ * Entries older than 7 days are not used.
+ *
+ * @param[in] callback      The callback function to be invoked with each cached accessory.
+ * @param[in] changed_cb    The callback function to be invoked with the differences, or NULL.
+ * @param[in] user_data     The user data to be passed to the callback functions. It must be valid until the changes are delivered.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_OPERATION_FAILED     The confirmation cannot be started
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported with the emulator
+ *
+ * @see usb_accessory_set_cache()
+ */
+int usb_accessory_foreach_cached(usb_accessory_cached_cb callback, usb_accessory_cache_changed_cb changed_cb, void *user_data);
+
+/**
+ * @brief Set where the connection and permission callbacks are called.
+ * @details
+ * By default, the callbacks are called while the events are received, so a slow callback delays the next events.
+ * With #USB_ACCESSORY_DISPATCH_MAIN_CONTEXT or #USB_ACCESSORY_DISPATCH_WORKER_POOL,
+ * the events are queued and the callbacks are called later.
+ * The connection callbacks are called in order and one at a time, and so are the permission callbacks.
+ * In the worker pool, a connection callback and a permission callback can run at the same time.
+ *
+ * @remark
+ * This function must not be called in a callback called by the worker pool.
+ *
+ * @param[in] dispatch      Where the callbacks are called.
+ * @param[in] main_context  The GMainContext for #USB_ACCESSORY_DISPATCH_MAIN_CONTEXT. NULL is the default context.
+ * @param[in] workers       The number of threads for #USB_ACCESSORY_DISPATCH_WORKER_POOL, from 1 to 8.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_NOT_SUPPORTED        Not supported
+ * @retval                  #USB_ERROR_INVALID_OPERATION    Called in a callback of the worker pool
+ * @retval                  #USB_ERROR_OPERATION_FAILED     The threads cannot be made
+ */
+int usb_accessory_set_dispatch(usb_accessory_dispatch_e dispatch, void *main_context, unsigned int workers);
+
+/**
+ * @brief Create a session to read and write data with the usb accessory.
+ * @details
+ * The session opens the accessory. The options of the session are set before usb_accessory_session_start().
+ *
+ * @remark
+ * the session must be destroyed by #usb_accessory_session_destroy()
+ *
+ * @param[in]  accessory     The attached usb accessory handle which has permission.
+ * @param[out] session       The created session.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_PERMISSION_DENIED    The accessory does not have permission
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ *
+ * @see usb_accessory_session_start()
+ * @see usb_accessory_session_destroy()
+ */
+int usb_accessory_session_create(usb_accessory_h accessory, usb_accessory_session_h *session);
+
+/**
+ * @brief Destroy a session. The accessory is closed and the threads of the session are stopped.
+ * @details
+ * The calls in progress in other threads, #usb_accessory_session_read(), #usb_accessory_session_write(),
+ * #usb_accessory_session_send_message() and #usb_accessory_session_receive_message(),
+ * are woken up and fail, and the session is freed when the last of them returns.
+ * The calls made after this fail with #USB_ERROR_INVALID_OPERATION.
+ * Without read-ahead, a read waits in the kernel and keeps the accessory open until it returns.
+ * The consumers of the broadcast ring may be destroyed after the session.
+ * The handle must not be used once all the calls have returned.
+ *
+ * @param[in] session       The session to destroy.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is being destroyed
+ */
+int usb_accessory_session_destroy(usb_accessory_session_h session);
+
+/**
+ * @brief Set read-ahead of a session.
+ * @details
+ * With read-ahead, the session keeps reading the accessory into @a depth buffers of @a buffer_size bytes,
+ * while the app processes the data read before. usb_accessory_session_read() returns the data read ahead.
+ *
+ * @remark
+ * Read-ahead is disabled by default. @a depth 0 disables it.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] depth         The number of buffers, up to 16.
+ * @param[in] buffer_size   The size of each buffer in bytes.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ */
+int usb_accessory_session_set_read_ahead(usb_accessory_session_h session, unsigned int depth, unsigned int buffer_size);
+
+/**
+ * @brief Start a session with the options set.
+ *
+ * @param[in] session       The session to start.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ */
+int usb_accessory_session_start(usb_accessory_session_h session);
+
+/**
+ * @brief Read data from the usb accessory.
+ * @details
+ * It blocks until some data is available, and returns at most @a len bytes.
+ *
+ * @param[in]  session       The started session.
+ * @param[out] buf           The buffer to read data into.
+ * @param[in]  len           The size of @a buf.
+ * @param[out] read_len      The number of bytes read. 0 means the end of data.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ */
+int usb_accessory_session_read(usb_accessory_session_h session, void *buf, unsigned int len, unsigned int *read_len);
+
+/**
+ * @brief Write data to the usb accessory.
+ * @details
+ * An unbuffered session blocks until all of @a len bytes are written.
+ * A buffered session copies as much of the data as the send queue has room for and returns without blocking,
+ * so @a written_len can be less than @a len, or 0 when the queue is full.
+ * The rest must be written again, for example after #USB_ACCESSORY_FLOW_WRITABLE.
+ * An error of the writer thread is returned by the next write.
+ *
+ * @param[in]  session       The started session.
+ * @param[in]  buf           The data to write.
+ * @param[in]  len           The size of the data.
+ * @param[out] written_len   The number of bytes written, or queued on a buffered session.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ */
+int usb_accessory_session_write(usb_accessory_session_h session, const void *buf, unsigned int len, unsigned int *written_len);
+
+/**
+ * @brief Make writes of a session buffered, with watermarks on the send queue.
+ * @details
+ * usb_accessory_session_write() of a buffered session copies the data to the send queue and returns without blocking.
+ * A writer thread sends the queue to the accessory.
+ * The queue holds up to twice @a high bytes, and a write returns fewer bytes than requested when the queue is full.
+ * #USB_ACCESSORY_FLOW_SEND_PRESSURE is delivered when the queue reaches @a high,
+ * and #USB_ACCESSORY_FLOW_WRITABLE when it drains down to @a low after that.
+ * Data still in the queue when the session is destroyed is dropped.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] low           The low watermark in bytes.
+ * @param[in] high          The high watermark in bytes. 0 makes writes unbuffered.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ *
+ * @see usb_accessory_session_set_flow_cb()
+ */
+int usb_accessory_session_set_send_watermarks(usb_accessory_session_h session, unsigned int low, unsigned int high);
+
+/**
+ * @brief Set the watermarks on the receive queue of a session.
+ * @details
+ * The receive queue is the data read ahead. If read-ahead is not set, it is enabled with 2 buffers of 16KB.
+ * #USB_ACCESSORY_FLOW_READABLE is delivered when data arrives in the empty queue,
+ * and #USB_ACCESSORY_FLOW_RECEIVE_PRESSURE when the queue reaches @a high.
+ * The pressure is released when the app reads the queue down to @a low.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] low           The low watermark in bytes.
+ * @param[in] high          The high watermark in bytes.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ *
+ * @see usb_accessory_session_set_read_ahead()
+ */
+int usb_accessory_session_set_receive_watermarks(usb_accessory_session_h session, unsigned int low, unsigned int high);
+
+/**
+ * @brief Register the callback function for the flow events of a session.
+ *
+ * @remark
+ * The callback is called in the default main loop, so the session must be destroyed in the main loop.
+ *
+ * @param[in] session       The session.
+ * @param[in] callback      The callback function to register, or NULL to unregister.
+ * @param[in] user_data     The user data to be passed to the callback function.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ */
+int usb_accessory_session_set_flow_cb(usb_accessory_session_h session, usb_accessory_flow_cb callback, void *user_data);
+
+/**
+ * @brief Get the number of bytes in the send and receive queues of a session.
+ *
+ * @param[in]  session          The session.
+ * @param[out] send_queued      The number of bytes waiting to be sent.
+ * @param[out] receive_queued   The number of bytes received and not read by the app.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ */
+int usb_accessory_session_get_queued(usb_accessory_session_h session, unsigned int *send_queued, unsigned int *receive_queued);
+
+/**
+ * @brief Decode the data of a session in parallel.
+ * @details
+ * When the session starts, a reader thread reads units of data from the accessory,
+ * @a workers threads decode them with @a decode, and @a deliver is called with the results in the order the units were read.
+ * The stages are connected by bounded lock-free queues, and at most 4 units per worker are in flight.
+ * A unit is a message on a framed session, and the data of a read of the read-ahead buffer size otherwise.
+ * usb_accessory_session_read() and usb_accessory_session_receive_message() must not be used with a pipeline.
+ *
+ * @remark
+ * The session must not be destroyed in @a deliver.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] workers       The number of decoding threads, at most 16. 0 removes the pipeline.
+ * @param[in] output_size   The size of the buffer for the decoded data of a unit.
+ * @param[in] decode        The decoding function.
+ * @param[in] deliver       The function to receive the decoded data.
+ * @param[in] user_data     The user data to be passed to @a decode and @a deliver.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ */
+int usb_accessory_session_set_pipeline(usb_accessory_session_h session, unsigned int workers,
+		unsigned int output_size, usb_accessory_decode_cb decode, usb_accessory_deliver_cb deliver, void *user_data);
+
+/**
+ * @brief Run the I/O threads of a session as real-time threads.
+ * @details
+ * When the session starts, the reader and the writer threads are bound to @a cpu and scheduled with SCHED_FIFO at @a priority,
+ * their buffers are locked and faulted in, and the first pages of their stacks are faulted in,
+ * so that a read does not wait for a page fault or for other threads.
+ * The session reads ahead with the default buffers if no read-ahead is set.
+ * What is not permitted to the process is skipped, and the session runs as a normal one.
+ * usb_accessory_session_get_realtime_stats() tells what was applied.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] cpu           The CPU to run on, or -1 to run on any CPU.
+ * @param[in] priority      The SCHED_FIFO priority from 1 to 99, or 0 to keep the normal scheduling.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ */
+int usb_accessory_session_set_realtime(usb_accessory_session_h session, int cpu, int priority);
+
+/**
+ * @brief Get what a real-time session could apply and the jitter of its reads.
+ *
+ * @param[in]  session      The started session.
+ * @param[out] stats        The stats.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started or not real-time
+ *
+ * @see usb_accessory_session_set_realtime()
+ */
+int usb_accessory_session_get_realtime_stats(usb_accessory_session_h session, usb_accessory_session_rt_stats_s *stats);
+
+/**
+ * @brief Poll the accessory for a while before a read of a session waits.
+ * @details
+ * A read which expects data, because a write waits for its reply or data came shortly before,
+ * polls the accessory for up to a window and then waits as usual, which saves the wake-up from a sleeping read.
+ * The window adapts to how long the replies take, up to @a max_window_us.
+ * Polling spends CPU time, and usb_accessory_session_get_busy_poll_stats() tells how much and how much latency it saves.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] max_window_us The longest window in microseconds, at most 10000. 0 stops polling.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ */
+int usb_accessory_session_set_busy_poll(usb_accessory_session_h session, unsigned int max_window_us);
+
+/**
+ * @brief Get the CPU time spent and the latency saved by busy polling on a session.
+ *
+ * @param[in]  session      The started session.
+ * @param[out] stats        The stats.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started or does not poll
+ *
+ * @see usb_accessory_session_set_busy_poll()
+ */
+int usb_accessory_session_get_busy_poll_stats(usb_accessory_session_h session, usb_accessory_session_poll_stats_s *stats);
+
+/**
+ * @brief Let a session choose its transfer sizes.
+ * @details
+ * When the session starts, it probes sizes of reads and writes from 4 KB to 64 KB, and then numbers of reads ahead from 1 to 8.
+ * Each candidate runs for 100 ms of traffic, and the one which moves the most bytes is kept.
+ * When the throughput stays a quarter under that for 3 windows, the sizes are probed again.
+ * Reads are done ahead in the buffers of the tuner, which replace those of usb_accessory_session_set_read_ahead().
+ * Writes are divided only if they are queued by usb_accessory_session_set_send_watermarks().
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] enable        true to tune the sizes.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ */
+int usb_accessory_session_set_autotune(usb_accessory_session_h session, bool enable);
+
+/**
+ * @brief Get the transfer sizes chosen by the autotuner of a session.
+ *
+ * @param[in]  session      The started session.
+ * @param[out] tune         The transfer sizes.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started or not tuned
+ *
+ * @see usb_accessory_session_set_autotune()
+ */
+int usb_accessory_session_get_autotune(usb_accessory_session_h session, usb_accessory_session_tune_s *tune);
+
+/**
+ * @brief Receive the data of a session into a pool of buffers.
+ * @details
+ * When the session starts, @a count buffers of @a buffer_size bytes are allocated once, each aligned to a cache line,
+ * and a thread receives each unit of data into a free buffer and passes it to @a callback.
+ * The buffers return to the pool when they are released, so receiving allocates no memory.
+ * usb_accessory_session_read() and usb_accessory_session_receive_message() must not be used with a pool,
+ * and a session cannot have a pool together with a decode pipeline or a broadcast ring.
+ *
+ * @remark
+ * The session must not be destroyed in @a callback. Buffers may be held after the session is destroyed.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] count         The number of buffers, at most 4096. 0 removes the pool.
+ * @param[in] buffer_size   The size of each buffer. 0 is the maximum message size on a framed session, and the read-ahead buffer size otherwise.
+ *                          On a framed session, a size below the maximum message size makes usb_accessory_session_start() fail.
+ * @param[in] options       The bitwise OR of #usb_accessory_buffer_pool_option_e.
+ * @param[in] callback      The function to receive the buffers.
+ * @param[in] user_data     The user data to be passed to @a callback.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started, or has a decode pipeline or a broadcast ring
+ */
+int usb_accessory_session_set_buffer_pool(usb_accessory_session_h session, unsigned int count, unsigned int buffer_size,
+		unsigned int options, usb_accessory_receive_cb callback, void *user_data);
+
+/**
+ * @brief Get the data of a buffer.
+ *
+ * @param[in]  buffer       The buffer.
+ * @param[out] data         The data. It is valid until the buffer is released.
+ * @param[out] len          The length of the data.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ */
+int usb_accessory_buffer_get_data(usb_accessory_buffer_h buffer, const void **data, unsigned int *len);
+
+/**
+ * @brief Take a reference of a buffer.
+ *
+ * @param[in] buffer        The buffer.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ *
+ * @see usb_accessory_buffer_unref()
+ */
+int usb_accessory_buffer_ref(usb_accessory_buffer_h buffer);
+
+/**
+ * @brief Release a reference of a buffer.
+ * @details When the last reference of the last view of a buffer is released, the buffer returns to its pool.
+ *
+ * @param[in] buffer        The buffer.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ */
+int usb_accessory_buffer_unref(usb_accessory_buffer_h buffer);
+
+/**
+ * @brief Create a view of a part of a buffer without copying it.
+ * @details The view has its own reference, and the buffer stays out of the pool until the view is released too.
+ *
+ * @param[in]  buffer       The buffer.
+ * @param[in]  offset       The offset of the part in @a buffer.
+ * @param[in]  len          The length of the part.
+ * @param[out] view         The view. Release it with usb_accessory_buffer_unref().
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_RESOURCE_BUSY        The pool has no more views, which are 4 per buffer
+ */
+int usb_accessory_buffer_create_view(usb_accessory_buffer_h buffer, unsigned int offset, unsigned int len, usb_accessory_buffer_h *view);
+
+/**
+ * @brief Broadcast the data of a session to several consumers through a ring.
+ * @details
+ * When the session starts, @a entries buffers of @a entry_size bytes are allocated once,
+ * and a thread receives each unit of data into the next entry of the ring.
+ * Each entry is written once and read in place by every consumer, which has its own position in the ring.
+ * @a policy decides what happens to a consumer which is a whole ring behind.
+ * With #USB_ACCESSORY_BROADCAST_BLOCK, an entry is reused when all the consumers have read it.
+ * With #USB_ACCESSORY_BROADCAST_DROP, receiving never waits for the consumers, and an entry is reused
+ * a whole ring later even if a consumer still holds it. The consumer is then dropped.
+ * usb_accessory_session_read() and usb_accessory_session_receive_message() must not be used with a ring,
+ * and a session cannot have a ring together with a pool or a decode pipeline.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] entries       The number of entries, at most 4096. It is rounded up to a power of 2. 0 removes the ring.
+ * @param[in] entry_size    The size of each entry. 0 is the maximum message size on a framed session, and the read-ahead buffer size otherwise.
+ * @param[in] policy        What to do with a consumer which falls behind.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started, has a pool or a decode pipeline, or the ring has consumers
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ *
+ * @see usb_accessory_consumer_create()
+ */
+int usb_accessory_session_set_broadcast(usb_accessory_session_h session, unsigned int entries, unsigned int entry_size,
+		usb_accessory_broadcast_policy_e policy);
+
+/**
+ * @brief Create a consumer of the broadcast ring of a session.
+ * @details
+ * A consumer created before the session starts reads all the data.
+ * One created later starts with the next entry received.
+ *
+ * @remark
+ * The consumer may be used after the session is destroyed, and must be destroyed with usb_accessory_consumer_destroy().
+ *
+ * @param[in]  session      The session which has a broadcast ring.
+ * @param[out] consumer     The consumer.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session has no broadcast ring
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ */
+int usb_accessory_consumer_create(usb_accessory_session_h session, usb_accessory_consumer_h *consumer);
+
+/**
+ * @brief Destroy a consumer of a broadcast ring.
+ * @details The entries it has not read are not waited for any more.
+ *
+ * @remark
+ * It must not be called while usb_accessory_consumer_next() runs with @a consumer.
+ *
+ * @param[in] consumer      The consumer.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ */
+int usb_accessory_consumer_destroy(usb_accessory_consumer_h consumer);
+
+/**
+ * @brief Read the next entry of a broadcast ring.
+ * @details
+ * It waits until an entry is received. The entry is a message on a framed session, or the data of a read otherwise.
+ * The data stays in the ring until the next call with @a consumer, which releases the entry.
+ * With #USB_ACCESSORY_BROADCAST_BLOCK, the data is valid until then.
+ * With #USB_ACCESSORY_BROADCAST_DROP, the receiver does not wait for the consumer,
+ * and overwrites the entry, even while the app reads it, if the consumer falls a whole ring behind.
+ * The data is checked only by the next call: it is valid only if that call does not return #USB_ERROR_RESOURCE_BUSY.
+ * Otherwise whatever the app read from it or made of it must be discarded.
+ *
+ * @remark
+ * A consumer is used by one thread at a time.
+ *
+ * @param[in]  consumer     The consumer.
+ * @param[out] data         The data of the entry.
+ * @param[out] len          The length of the data.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_NOT_CONNECTED        All the entries are read, and the session has stopped receiving
+ * @retval                  #USB_ERROR_RESOURCE_BUSY        The consumer fell a whole ring behind and was dropped. The data of the last call is not valid
+ */
+int usb_accessory_consumer_next(usb_accessory_consumer_h consumer, const void **data, unsigned int *len);
+
+/**
+ * @brief Get what a consumer of a broadcast ring read, and how far it is behind.
+ *
+ * @param[in]  consumer     The consumer.
+ * @param[out] stats        The stats.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ */
+int usb_accessory_consumer_get_stats(usb_accessory_consumer_h consumer, usb_accessory_consumer_stats_s *stats);
+
+/**
+ * @brief Get the round trip latency and the traffic of a session.
+ * @details
+ * The percentiles are taken from a histogram whose buckets are at most 1/16 of their value wide,
+ * and each is the upper end of its bucket.
+ *
+ * @param[in]  session      The session.
+ * @param[out] stats        The stats.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ *
+ * @see usb_accessory_session_get_latency_percentile()
+ */
+int usb_accessory_session_get_stats(usb_accessory_session_h session, usb_accessory_session_stats_s *stats);
+
+/**
+ * @brief Get a percentile of the round trip latency of a session.
+ *
+ * @param[in]  session      The session.
+ * @param[in]  percentile   The percentile from 0 to 100.
+ * @param[out] latency_us   The round trip in microseconds. It is 0 if nothing is measured.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ */
+int usb_accessory_session_get_latency_percentile(usb_accessory_session_h session, double percentile, unsigned long long *latency_us);
+
+/**
+ * @brief Reset the stats of a session.
+ *
+ * @param[in] session       The session.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ */
+int usb_accessory_session_reset_stats(usb_accessory_session_h session);
+
+/**
+ * @brief Capture the traffic of a session to a file.
+ * @details
+ * Each read and write of the session is recorded with its direction, monotonic time, length
+ * and up to @a snap_len bytes of the data.
+ * The file keeps the latest @a size bytes of records, and the decoder tool acc_capture_dump prints them.
+ * If the USB_ACCESSORY_CAPTURE environment variable has a path, all sessions are captured to it
+ * until this function is called.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] path          The capture file, or NULL to stop capturing.
+ * @param[in] size          The size of the records to keep in bytes.
+ * @param[in] snap_len      The number of bytes of data to record for each transfer.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ * @retval                  #USB_ERROR_OPERATION_FAILED     The file cannot be made
+ */
+int usb_accessory_session_set_capture(usb_accessory_session_h session, const char *path, unsigned int size, unsigned int snap_len);
+
+/**
+ * @brief Make a session exchange messages instead of a byte stream.
+ * @details
+ * When a framed session starts, both sides send a capability header, and the options both sides support are used.
+ * Then each message is sent as a length-prefixed frame with usb_accessory_session_send_message(),
+ * and received as a whole with usb_accessory_session_receive_message().
+ * With #USB_ACCESSORY_FRAME_LZ4, each frame is compressed when it gets smaller.
+ * On a buffered session a frame is queued whole, so the largest message is lowered to what fits in the send queue,
+ * and the session does not start if the queue cannot hold the capability header.
+ * The session does not start either if the peer does not send its capability header within 5 seconds.
+ * usb_accessory_session_read() and usb_accessory_session_write() must not be used on a framed session.
+ *
+ * @param[in] session           The session which is not started.
+ * @param[in] options           The bitwise OR of #usb_accessory_frame_option_e.
+ * @param[in] max_message_size  The largest message to exchange. It is at most 16MB - 1.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ *
+ * @see usb_accessory_session_get_framing()
+ */
+int usb_accessory_session_set_framing(usb_accessory_session_h session, unsigned int options, unsigned int max_message_size);
+
+/**
+ * @brief Get the options and the largest message size agreed with the peer.
+ *
+ * @param[in]  session              The started framed session.
+ * @param[out] options              The bitwise OR of #usb_accessory_frame_option_e used by both sides.
+ * @param[out] max_message_size     The largest message both sides accept.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started or not framed
+ */
+int usb_accessory_session_get_framing(usb_accessory_session_h session, unsigned int *options, unsigned int *max_message_size);
+
+/**
+ * @brief Send a message on a framed session.
+ *
+ * @remark
+ * If writes are buffered, the message is queued as a whole or not at all.
+ *
+ * @param[in] session       The started framed session.
+ * @param[in] buf           The message.
+ * @param[in] len           The length of the message.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started or not framed
+ * @retval                  #USB_ERROR_RESOURCE_BUSY        The send queue has no room for the message
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ */
+int usb_accessory_session_send_message(usb_accessory_session_h session, const void *buf, unsigned int len);
+
+/**
+ * @brief Send a message of a class on a framed session.
+ * @details
+ * A control message is sent before the next frame of the bulk messages waiting or being sent.
+ * A bulk message larger than the slice size of usb_accessory_session_set_send_slice() is sent as slices,
+ * so that control messages wait at most for a slice. The peer puts the slices together,
+ * and usb_accessory_session_receive_message() returns the bulk message as a whole.
+ * usb_accessory_session_send_message() sends a bulk message.
+ *
+ * @remark
+ * While bulk messages are waiting or being sent, at most 4 control messages are sent between two of their frames,
+ * so that a steady flow of them does not hold bulk messages back.
+ * If writes are buffered, messages are queued as a whole and are not sliced.
+ *
+ * @param[in] session       The started framed session.
+ * @param[in] buf           The message.
+ * @param[in] len           The length of the message.
+ * @param[in] send_class    The class of the message.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started or not framed
+ * @retval                  #USB_ERROR_RESOURCE_BUSY        The send queue has no room for the message
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed
+ */
+int usb_accessory_session_send_message_class(usb_accessory_session_h session, const void *buf, unsigned int len,
+		usb_accessory_send_class_e send_class);
+
+/**
+ * @brief Set the size of the slices of bulk messages on a framed session.
+ * @details Slices are used only if the peer accepts them, which this library always does.
+ *
+ * @param[in] session       The session which is not started.
+ * @param[in] slice_size    The largest slice in bytes. 0 sends bulk messages whole. The default is 16384.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is already started
+ */
+int usb_accessory_session_set_send_slice(usb_accessory_session_h session, unsigned int slice_size);
+
+/**
+ * @brief Get the queue depth and the wait of a class of messages on a framed session.
+ *
+ * @param[in]  session      The started framed session.
+ * @param[in]  send_class   The class.
+ * @param[out] stats        The stats.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started or not framed
+ */
+int usb_accessory_session_get_send_class_stats(usb_accessory_session_h session, usb_accessory_send_class_e send_class,
+		usb_accessory_send_class_stats_s *stats);
+
+/**
+ * @brief Receive a message on a framed session. It waits until a whole message arrives.
+ *
+ * @remark
+ * If the message does not fit in @a size bytes, it is kept for the next call
+ * and #USB_ERROR_INVALID_PARAMETER is returned with the message length in @a len.
+ * A broken frame is dropped and #USB_ERROR_OPERATION_FAILED is returned.
+ * If its length is broken too, the next message cannot be found,
+ * and this call and all the later ones fail with #USB_ERROR_OPERATION_FAILED.
+ *
+ * @param[in]  session      The started framed session.
+ * @param[out] buf          The buffer for the message.
+ * @param[in]  size         The size of the buffer.
+ * @param[out] len          The length of the message.
+ *
+ * @return                  0 on success, otherwise a negative error value
+ * @retval                  #USB_ERROR_NONE                 Successful
+ * @retval                  #USB_ERROR_INVALID_PARAMETER    Invalid parameter
+ * @retval                  #USB_ERROR_INVALID_OPERATION    The session is not started or not framed
+ * @retval                  #USB_ERROR_OPERATION_FAILED     Operation failed or the frame is broken
+ */
+int usb_accessory_session_receive_message(usb_accessory_session_h session, void *buf, unsigned int size, unsigned int *len);
+
+#if defined(__GNUC__) && __GNUC__ >= 4
+#pragma GCC visibility pop
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TIZEN_SYSTEM_USB_ACCESSORY_CAPTURE_PRIVATE_H__
+#define __TIZEN_SYSTEM_USB_ACCESSORY_CAPTURE_PRIVATE_H__
+
+#include <stdint.h>
+
+/* Layout of a capture file. It is shared by the library and the decoder.
+ *
+ * The file is a header followed by blockCnt blocks of blockSize bytes used as a ring.
+ * head counts the bytes reserved since the capture started,
+ * so the block at head is (head / blockSize) % blockCnt.
+ * Each block starts with its index since the capture started, followed by records.
+ * A record never crosses a block, and a record length of 0 ends the block.
+ * Numbers are in the byte order of the device. */
+
+#define ACC_CAPTURE_MAGIC 0x50434155
+#define ACC_CAPTURE_VERSION 1
+#define ACC_CAPTURE_BLOCK_SIZE 65536
+#define ACC_CAPTURE_BLOCK_HEADER_LEN 8
+#define ACC_CAPTURE_ALIGN 8
+
+#define ACC_CAPTURE_OUT 0x1
+#define ACC_CAPTURE_IN 0x2
+#define ACC_CAPTURE_ERROR 0x4 /* len is errno */
+
+struct AccCaptureHeader {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	headerLen;
+	uint32_t	blockSize;
+	uint32_t	blockCnt;
+	uint32_t	snapLen;
+	uint32_t	reserved;
+	volatile uint64_t head;
+	uint64_t	startNs;
+	uint8_t		pad[24];
+};
+
+struct AccCaptureRecord {
+	uint32_t	recLen;
+	uint16_t	flags;
+	uint16_t	reserved;
+	uint64_t	timeNs;
+	uint32_t	len;
+	uint32_t	capLen;
+};
+
+#define ACC_CAPTURE_MAX_SNAP (ACC_CAPTURE_BLOCK_SIZE - ACC_CAPTURE_BLOCK_HEADER_LEN - sizeof(struct AccCaptureRecord))
+
+#endif /* __TIZEN_SYSTEM_USB_ACCESSORY_CAPTURE_PRIVATE_H__ */
@@ -35,14 +35,128 @@
 #include <stdlib.h>
 #include <sys/utsname.h>
 #include <glib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <semaphore.h>
+#include "usb_accessory.h"
+#include "usb_accessory_capture_private.h"
 
 #define ACC_ELEMENT_LEN 256
 #define SOCK_PATH "/tmp/usb_server_sock"
 #define ACC_SOCK_PATH "/tmp/usb_acc_sock"
+/* Abstract socket name of the pushed events, followed by ".<pid>" of the app.
+ * Only usb-server, running as USB_SERVER_UID, is accepted on it */
+#define ACC_EVENT_SOCK_NAME "usb_acc_event_sock"
+#define USB_SERVER_UID 0
 #define USB_ACCESSORY_NODE "/dev/usb_accessory"
+#define USB_ACCESSORY_NODE_ENV "USB_ACCESSORY_NODE"
 #define APP_ID_LEN 64
 #define SOCK_STR_LEN 1542
 
+#define ACC_AUL_LIB "libaul.so.0"
+#define ACC_GLIB_LIB "libglib-2.0.so.0"
+#define ACC_LZ4_LIB "liblz4.so.1"
+
+#define ACC_BACKEND_MAX 4
+
+#define ACC_SHM_NAME "/usb_accessory_state"
+#define ACC_SHM_MAGIC 0x41425355
+#define ACC_SHM_VERSION 2
+#define ACC_SHM_MAX_ACC 4
+#define ACC_SHM_RETRY_SEC 5
+#define ACC_SHM_READ_RETRY 64
+/* The writer stamps the heartbeat at least this often,
+ * and a segment whose heartbeat is older than ACC_SHM_STALE_MS is not believed */
+#define ACC_SHM_HEARTBEAT_MS 1000
+#define ACC_SHM_STALE_MS 3000
+
+#define ACC_CACHE_ENV "USB_ACCESSORY_CACHE"
+#define ACC_CACHE_MAGIC 0x43434155
+#define ACC_CACHE_VERSION 1
+#define ACC_CACHE_MAX_ENTRIES 8
+#define ACC_CACHE_MAX_AGE_SEC (7 * 24 * 60 * 60)
+#define ACC_CACHE_READ_RETRY 64
+
+#define ACC_READ_AHEAD_MAX_DEPTH 16
+#define ACC_READ_AHEAD_DEFAULT_DEPTH 2
+#define ACC_READ_AHEAD_DEFAULT_SIZE 16384
+#define ACC_SEND_QUEUE_LIMIT_FACTOR 2
+
+#define ACC_CAPTURE_ENV "USB_ACCESSORY_CAPTURE"
+#define ACC_CAPTURE_DEFAULT_SIZE (4 * 1024 * 1024)
+#define ACC_CAPTURE_DEFAULT_SNAP 256
+
+/* Latency histogram: values below ACC_HIST_SUB microseconds have their own buckets,
+ * and each power of 2 above is split into ACC_HIST_SUB buckets */
+#define ACC_HIST_SUB_BITS 4
+#define ACC_HIST_SUB (1 << ACC_HIST_SUB_BITS)
+#define ACC_HIST_BUCKETS (ACC_HIST_SUB + (32 - ACC_HIST_SUB_BITS) * ACC_HIST_SUB)
+
+#define ACC_DISPATCH_MAX_WORKERS 8
+
+#define ACC_LFQ_SPIN 256
+#define ACC_PIPELINE_MAX_WORKERS 16
+#define ACC_PIPELINE_SLOTS_PER_WORKER 4
+
+#define ACC_RT_AFFINITY 0x1
+#define ACC_RT_SCHED 0x2
+#define ACC_RT_MLOCK 0x4
+#define ACC_RT_STACK_PREFAULT 65536
+
+#define ACC_BUSY_POLL_MIN_NS 1000
+#define ACC_BUSY_POLL_MAX_US 10000
+#define ACC_BUSY_POLL_PROBE_INTERVAL 64
+
+#define ACC_TUNE_MAX_SIZE 65536
+#define ACC_TUNE_MAX_DEPTH 8
+#define ACC_TUNE_FIRST_DEPTH 4
+#define ACC_TUNE_WINDOW_MS 100
+#define ACC_TUNE_MIN_BYTES 65536
+#define ACC_TUNE_IDLE_WINDOWS 10
+#define ACC_TUNE_DRIFT_PERCENT 25
+#define ACC_TUNE_DRIFT_WINDOWS 3
+
+#define ACC_BUF_ALIGN 64
+#define ACC_BUF_HUGEPAGE_SIZE (2 * 1024 * 1024)
+#define ACC_BUF_VIEWS_PER_BUFFER 4
+#define ACC_BUF_MAX_COUNT 4096
+#define ACC_BUF_MAX_SIZE (16 * 1024 * 1024)
+
+#define ACC_BROADCAST_MAX_ENTRIES 4096
+#define ACC_BROADCAST_MAX_SIZE (16 * 1024 * 1024)
+#define ACC_BROADCAST_SPIN 256
+#define ACC_BROADCAST_DETACHED UINT64_MAX
+#define ACC_BROADCAST_FILLING UINT64_MAX
+
+#define ACC_FRAME_MAGIC 0x46434155
+#define ACC_FRAME_VERSION 1
+#define ACC_FRAME_HELLO_LEN 16
+#define ACC_FRAME_HEADER_LEN 8
+#define ACC_FRAME_MAX_SIZE 0xFFFFFF
+#define ACC_FRAME_DEFAULT_SIZE 65536
+#define ACC_FRAME_COMPRESS_MIN 64
+#define ACC_FRAME_SKIP_CHUNK 512
+#define ACC_FRAME_FLAG_LZ4 0x01
+#define ACC_FRAME_FLAG_SLICE 0x02
+#define ACC_FRAME_FLAG_MORE 0x04
+#define ACC_FRAME_FLAG_FIRST 0x08
+#define ACC_FRAME_OPT_SLICES 0x8000
+#define ACC_FRAME_HELLO_TIMEOUT_MS 5000
+#define ACC_FRAME_HELLO_POLL_US 1000
+#define ACC_SEND_CLASS_CNT 2
+#define ACC_SEND_SLICE_DEFAULT 16384
+#define ACC_SEND_CONTROL_BURST 4
+
+#define ACC_HANDLE_INDEX_BITS 16
+#define ACC_HANDLE_INDEX_MASK 0xFFFF
+#define ACC_HANDLE_GEN_MASK 0xFFFF
+#define ACC_SLAB_CHUNK_SLOTS 64
+#define ACC_SLAB_MAX_CHUNKS (ACC_HANDLE_INDEX_MASK / ACC_SLAB_CHUNK_SLOTS)
+
 #define USB_TAG "USB_ACCESSORY"
 
 #define USB_LOG(format, args...) \
@@ -100,7 +214,11 @@ typedef enum {
 	HAS_ACC_PERMISSION,
 	REQ_ACC_PERM_NOTI_YES_BTN,
 	REQ_ACC_PERM_NOTI_NO_BTN,
-	GET_ACC_INFO
+	GET_ACC_INFO,
+
+	/* Events pushed from usb-server with the accessory information */
+	ACC_CONNECTED_NOTI = 40,
+	ACC_DISCONNECTED_NOTI
 } REQUEST_TO_USB_MANGER;
 
 typedef enum {
@@ -109,42 +227,673 @@ typedef enum {
 	ACC_DESCRIPTION,
 	ACC_VERSION,
 	ACC_URI,
-	ACC_SERIAL
+	ACC_SERIAL,
+	ACC_INFO_NUM
 } ACCESSORY_INFO;
 
+/* The reply of usb-server is kept as it is.
+ * The offsets of the fields are found when the handle is made,
+ * and a field is copied out of raw[] to info[] when the app first asks for it.
+ * A thread claims a field in decoding, and sets it in decoded once info[] is written */
 struct usb_accessory_s {
 	bool		accPermission;
 
-	char		manufacturer[ACC_ELEMENT_LEN];
-	char		model[ACC_ELEMENT_LEN];
-	char		description[ACC_ELEMENT_LEN];
-	char		version[ACC_ELEMENT_LEN];
-	char		uri[ACC_ELEMENT_LEN];
-	char		serial[ACC_ELEMENT_LEN];
+	char		raw[SOCK_STR_LEN];
+	unsigned int	rawLen;
+	bool		indexed;
+	unsigned short	fieldOffset[ACC_INFO_NUM];
+	unsigned short	fieldLen[ACC_INFO_NUM];
+	uint64_t	fingerprint;
+	volatile unsigned int decoding;
+	volatile unsigned int decoded;
+
+	char		info[ACC_INFO_NUM][ACC_ELEMENT_LEN];
+	/* The session opened on connect, until the app takes it in the connection callback */
+	struct usb_accessory_session_s *prewarmed;
+};
+
+struct AccFilterRule {
+	ACCESSORY_INFO	field;
+	int		match;
+	unsigned int	len;
+	unsigned int	hash;
+	char		pattern[ACC_ELEMENT_LEN];
+};
+
+struct usb_accessory_filter_s {
+	struct AccFilterRule *rules;
+	int		ruleCnt;
+	unsigned int	fieldMask;
+};
+
+/* Shared memory segment published by usb-server */
+struct AccShmRecord {
+	uint32_t	len;
+	char		raw[SOCK_STR_LEN];
+};
+
+struct AccShmState {
+	uint32_t	magic;
+	uint32_t	version;
+	volatile uint32_t seq;
+	uint32_t	generation;
+	int32_t		status;
+	uint32_t	accCnt;
+	/* CLOCK_MONOTONIC milliseconds of the last publish or beat, truncated to 32 bits.
+	 * It is written out of the seqlock */
+	volatile uint32_t heartbeat;
+	struct AccShmRecord acc[ACC_SHM_MAX_ACC];
+};
+
+/* Cache file of an app. Times are seconds since the epoch, and seenTime 0 is an empty entry */
+struct AccCacheEntry {
+	uint64_t	fingerprint;
+	int64_t		seenTime;
+	int64_t		permTime;
+	uint32_t	attached;
+	uint32_t	permission;
+	uint32_t	rawLen;
+	char		raw[SOCK_STR_LEN];
+};
+
+struct AccCacheFile {
+	uint32_t	magic;
+	uint32_t	version;
+	volatile uint32_t seq;
+	uint32_t	entryCnt;
+	struct AccCacheEntry entries[ACC_CACHE_MAX_ENTRIES];
+};
+
+/* Where the requests, the status and the data go. Selected before the first use */
+struct AccBackendOps {
+	const char	*name;
+	/* usb-server publishes the state segment for this backend */
+	bool		sharedState;
+
+	/* Request transport */
+	int (*request)(int request, char *answer, char *appId);
+
+	/* Event source */
+	int (*get_status)(int *status);
+	int (*watch_status)(vconf_callback_fn func, void *data);
+	int (*unwatch_status)(vconf_callback_fn func);
+	int (*listen_answers)(void);
+	int (*listen_events)(void);
+	void (*unlisten_events)(int sock);
+
+	/* Data channel */
+	int (*open_channel)(void);
+	int (*read_channel)(int channel, void *buf, unsigned int len);
+	/* 1 if a read would not wait, 0 if it would, -1 on error */
+	int (*poll_channel)(int channel);
+	int (*write_channel)(int channel, const void *buf, unsigned int len);
+	void (*close_channel)(int channel);
+	FILE *(*open_stream)(void);
+};
+
+/* Functions of the libraries which are loaded at the first use */
+struct AccAulOps {
+	int (*app_get_appid_bypid)(int pid, char *appid, int len);
+};
+
+struct AccGlibOps {
+	GIOChannel *(*io_channel_unix_new)(int fd);
+	gint (*io_channel_unix_get_fd)(GIOChannel *channel);
+	guint (*io_add_watch)(GIOChannel *channel, GIOCondition condition, GIOFunc func, gpointer user_data);
+	GIOStatus (*io_channel_shutdown)(GIOChannel *channel, gboolean flush, GError **err);
+	void (*io_channel_unref)(GIOChannel *channel);
+	guint (*timeout_add)(guint interval, GSourceFunc function, gpointer data);
+	guint (*idle_add)(GSourceFunc function, gpointer data);
+	gboolean (*source_remove)(guint tag);
+	GSource *(*idle_source_new)(void);
+	void (*source_set_callback)(GSource *source, GSourceFunc func, gpointer data, GDestroyNotify notify);
+	guint (*source_attach)(GSource *source, GMainContext *context);
+	void (*source_destroy)(GSource *source);
+	void (*source_unref)(GSource *source);
+	GMainContext *(*main_context_ref)(GMainContext *context);
+	void (*main_context_unref)(GMainContext *context);
+};
+
+/* liblz4 block API. compress_bound returns 0 if the library is not available */
+struct AccLz4Ops {
+	int (*compress_bound)(int inputSize);
+	int (*compress_default)(const char *src, char *dst, int srcSize, int dstCapacity);
+	int (*decompress_safe)(const char *src, char *dst, int compressedSize, int dstCapacity);
+};
+
+struct AccCapture {
+	struct AccCaptureHeader *hdr;
+	char		*blocks;
+	size_t		mapLen;
+};
+
+/* Round trips from a write to the next read which returns data.
+ * The counters are updated by the reader and the writer without a lock */
+struct AccLatencyStats {
+	volatile uint64_t pendingNs;
+	uint64_t	startNs;
+	uint64_t	count;
+	uint64_t	sumUs;
+	uint64_t	minUs;
+	uint64_t	maxUs;
+	uint64_t	bytesOut;
+	uint64_t	bytesIn;
+	uint64_t	writes;
+	uint64_t	reads;
+	uint64_t	buckets[ACC_HIST_BUCKETS];
+};
+
+/* Intervals between the reads of the reader thread. Only the reader updates it,
+ * and seq is odd while it does so that other threads copy it as a seqlock */
+struct AccJitterStats {
+	volatile uint32_t seq;
+	uint64_t	lastNs;
+	uint64_t	lastIntervalNs;
+	uint64_t	count;
+	uint64_t	sumNs;
+	uint64_t	minNs;
+	uint64_t	maxNs;
+	uint64_t	maxDevNs;
+	double		jitterNs;
+};
+
+/* Busy polling of the reads of a session. The window is tuned by the reading thread */
+struct AccBusyPoll {
+	uint64_t	maxNs;
+	uint64_t	windowNs;
+	uint64_t	avgWaitNs;
+	uint64_t	lastDataNs;
+	uint64_t	expected;
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	spinNs;
+	uint64_t	polledReads;
+	uint64_t	polledNs;
+	uint64_t	probes;
+	uint64_t	probeNs;
+};
+
+typedef enum {
+	ACC_TUNE_PROBE_SIZE = 0,
+	ACC_TUNE_PROBE_DEPTH,
+	ACC_TUNE_SETTLED
+} ACC_TUNE_PHASE;
+
+/* The transfer sizes in use. They are changed with the session lock held */
+struct AccTune {
+	unsigned int	readSize;
+	unsigned int	readDepth;
+	unsigned int	writeSize;
+	ACC_TUNE_PHASE	phase;
+	unsigned int	candidate;
+	uint64_t	windowStartNs;
+	uint64_t	windowBytes;
+	double		bestRate;
+	unsigned int	bestSize;
+	unsigned int	bestDepth;
+	double		settledRate;
+	unsigned int	drifts;
+	unsigned int	rounds;
+};
+
+struct AccLfCell {
+	volatile uint32_t seq;
+	void		*data;
+};
+
+struct AccLfQueue {
+	struct AccLfCell *cells;
+	uint32_t	mask;
+	volatile uint32_t enqPos __attribute__((aligned(64)));
+	volatile uint32_t deqPos __attribute__((aligned(64)));
+	volatile int	waiters __attribute__((aligned(64)));
+	sem_t		sem;
+};
+
+struct AccPipeSlot {
+	uint64_t	seq;
+	char		*in;
+	unsigned int	inLen;
+	char		*out;
+	int		outLen;
+};
+
+struct AccPipeline {
+	unsigned int	workerCnt;
+	unsigned int	outSize;
+	usb_accessory_decode_cb decode;
+	usb_accessory_deliver_cb deliver;
+	void		*userData;
+
+	unsigned int	inSize;
+	unsigned int	slotCnt;
+	struct AccPipeSlot *slots;
+	struct AccPipeSlot * volatile *window;
+	struct AccLfQueue freeQ;
+	struct AccLfQueue workQ;
+	sem_t		deliverSem;
+	volatile int	deliverWaiters;
+	volatile bool	stopping;
+	volatile bool	readerDone;
+	uint64_t	endSeq;
+
+	pthread_t	reader;
+	bool		readerRunning;
+	pthread_t	deliverer;
+	bool		delivererRunning;
+	pthread_t	workers[ACC_PIPELINE_MAX_WORKERS];
+	unsigned int	runningWorkers;
+};
+
+/* Senders of a class and what they sent. It is updated under schedLock */
+struct AccSendClass {
+	unsigned int	queued;
+	unsigned int	maxQueued;
+	uint64_t	messages;
+	uint64_t	bytes;
+	uint64_t	slices;
+	uint64_t	waitSumNs;
+	uint64_t	waitMaxNs;
+};
+
+struct AccBufPool;
+
+struct AccBufSlot {
+	struct AccBufPool *pool;
+	char		*data;
+	volatile int	refs;
+};
+
+/* A view of a slot. Each holds a reference of its slot */
+struct usb_accessory_buffer_s {
+	struct AccBufPool *pool;
+	struct AccBufSlot *slot;
+	const char	*data;
+	unsigned int	len;
+	volatile int	refs;
+};
+
+struct AccBufPool {
+	unsigned int	count;
+	unsigned int	size;
+	unsigned int	stride;
+	unsigned int	options;
+	usb_accessory_receive_cb callback;
+	void		*userData;
+
+	char		*region;
+	size_t		regionLen;
+	struct AccBufSlot *slots;
+	struct usb_accessory_buffer_s *views;
+	struct AccLfQueue freeSlots;
+	struct AccLfQueue freeViews;
+	/* The session and each slot out of the pool */
+	volatile int	refs;
+	volatile bool	stopping;
+	pthread_t	receiver;
+	bool		receiverRunning;
+};
+
+struct AccBroadcast;
+
+/* The gate is the first sequence the consumer may still read: the entry it holds,
+ * or the next one. It only moves forward, and is ACC_BROADCAST_DETACHED once dropped.
+ * The counters are written by the consumer itself, and the stalls by the receiver */
+struct usb_accessory_consumer_s {
+	struct AccBroadcast *ring;
+	struct usb_accessory_consumer_s *next;
+	volatile uint64_t gate __attribute__((aligned(64)));
+	uint64_t	seq;
+	volatile bool	dropped;
+	uint64_t	entries;
+	uint64_t	bytes;
+	unsigned int	maxLag;
+	uint64_t	stalls;
+	uint64_t	stallNs;
+};
+
+/* seq is the sequence the entry holds, or ACC_BROADCAST_FILLING while the receiver writes it */
+struct AccBroadcastEntry {
+	char		*data;
+	unsigned int	len;
+	volatile uint64_t seq;
+};
+
+/* Broadcast ring of a session. It is held by the session and by each consumer */
+struct AccBroadcast {
+	unsigned int	count;
+	unsigned int	size;
+	unsigned int	stride;
+	usb_accessory_broadcast_policy_e policy;
+
+	char		*region;
+	size_t		regionLen;
+	struct AccBroadcastEntry *entries;
+	uint32_t	mask;
+	/* Entries below published are readable. minGate is a lower bound of the gates */
+	volatile uint64_t published __attribute__((aligned(64)));
+	uint64_t	minGate;
+	volatile bool	ended;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	dataCond;
+	pthread_cond_t	spaceCond;
+	volatile int	dataWaiters;
+	volatile int	spaceWaiting;
+	struct usb_accessory_consumer_s *consumers;
+	volatile int	refs;
+	volatile bool	stopping;
+	pthread_t	receiver;
+	bool		receiverRunning;
+};
+
+struct AccReadBuf {
+	char		*data;
+	unsigned int	len;
+	unsigned int	pos;
+};
+
+struct usb_accessory_session_s {
+	int		fd;
+	bool		started;
+	bool		stopping;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	struct AccCapture *capture;
+	bool		captureOwned;
+	struct AccLatencyStats stats;
+	struct AccPipeline *pipeline;
+	struct AccBufPool *bufPool;
+	struct AccBroadcast *broadcast;
+
+	/* Read-ahead */
+	unsigned int	raDepth;
+	unsigned int	raSize;
+	struct AccReadBuf *raBufs;
+	unsigned int	raHead;
+	unsigned int	raTail;
+	unsigned int	raFilled;
+	pthread_t	reader;
+	bool		readerRunning;
+	bool		eof;
+	int		readError;
+	unsigned int	recvQueued;
+	unsigned int	recvLow;
+	unsigned int	recvHigh;
+	bool		recvPressure;
+
+	/* Buffered send queue. It is a ring of sendLimit bytes */
+	unsigned int	sendLow;
+	unsigned int	sendHigh;
+	unsigned int	sendLimit;
+	char		*sendQueue;
+	unsigned int	sendHead;
+	unsigned int	sendQueued;
+	bool		sendPressure;
+	pthread_cond_t	sendCond;
+	pthread_t	writer;
+	bool		writerRunning;
+	int		writeError;
+
+	/* Real-time I/O threads. rtFailed has the ACC_RT_* which could not be applied */
+	bool		rtEnabled;
+	int		rtCpu;
+	int		rtPriority;
+	volatile int	rtFailed;
+	struct AccJitterStats jitter;
+
+	/* Busy polling. It is on when poll.maxNs is set */
+	struct AccBusyPoll poll;
+
+	/* Receive buffer pool. The pool is made at start */
+	unsigned int	poolCount;
+	unsigned int	poolSize;
+	unsigned int	poolOptions;
+	usb_accessory_receive_cb poolCb;
+	void		*poolUserData;
+
+	/* Transfer sizes. Without autotuning they are the read-ahead buffers and whole writes */
+	bool		tuneEnabled;
+	struct AccTune	tune;
+
+	/* Flow events are delivered in the main loop */
+	usb_accessory_flow_cb flowCb;
+	void		*flowUserData;
+	unsigned int	pendingFlow;
+	guint		flowSource;
+
+	/* The API calls in progress and destroy hold a reference. The last one frees the session */
+	unsigned int	refs;
+	bool		destroyed;
+
+	/* Framing. The options are requested before start and agreed at start */
+	bool		framed;
+	unsigned int	frameOptions;
+	unsigned int	frameMax;
+	unsigned int	frameBound;
+	pthread_mutex_t	frameSendLock;
+	pthread_mutex_t	frameRecvLock;
+	char		*frameSendBuf;
+	char		*frameRecvBuf;
+	bool		frameHeld;
+	uint32_t	heldLen;
+	uint32_t	heldInfo;
+	/* A frame could not be skipped, so the stream is out of sync */
+	bool		frameBroken;
+
+	/* Send classes. Bulk messages are sent in slices of frameSlice bytes if the peer accepts them */
+	unsigned int	sliceSize;
+	unsigned int	frameSlice;
+	pthread_mutex_t	frameBulkLock;
+	pthread_mutex_t	schedLock;
+	pthread_cond_t	schedCond;
+	struct AccSendClass sendClass[ACC_SEND_CLASS_CNT];
+	/* Control messages let through since the last bulk slice, up to ACC_SEND_CONTROL_BURST while bulk messages are pending.
+	 * controlInFlight of them are let through but not on the wire yet */
+	unsigned int	controlRun;
+	unsigned int	controlInFlight;
+	unsigned int	bulkPending;
+	char		*asmBuf;
+	unsigned int	asmLen;
+	bool		asmReady;
 };
 
 struct usb_accessory_list {
-	struct usb_accessory_s *accessory;
+	usb_accessory_h accessory;
 	struct usb_accessory_list *next;
 };
 
+/* Debounce stage between the vconf status key and the connection callback.
+ * Raw edges are collected while the settle window is running and only the
+ * net transition is delivered when it expires. */
+struct AccEventPipe {
+	unsigned int	settleMs;
+	guint		settleTimer;
+	int		lastStatus;
+	int		pendingStatus;
+	unsigned int	pendingEdges;
+	unsigned int	suppressedEdges;
+
+	/* Accessory information pushed with the connection event */
+	int		eventSock;
+	GIOChannel	*eventCh;
+	guint		eventWatch;
+	usb_accessory_h	pushedAcc;
+	bool		pushedDropped;
+
+	/* Only the accessories matched with this filter are delivered */
+	struct usb_accessory_filter_s *filter;
+	bool		connectedMatched;
+};
+
+/* App callbacks of a subscriber are called in order, one at a time */
+typedef enum {
+	ACC_DISPATCH_CONNECTION = 0,
+	ACC_DISPATCH_PERMISSION,
+	ACC_DISPATCH_CACHE,
+	ACC_DISPATCH_SUBSCRIBERS
+} ACC_DISPATCH_SUBSCRIBER;
+
+/* A callback call to be dispatched. It is the first member of the struct with the arguments,
+ * and run() frees the struct */
+struct AccDispatchTask {
+	void (*run)(struct AccDispatchTask *task);
+	struct AccDispatchTask *next;
+};
+
+struct AccDispatchQueue {
+	struct AccDispatchTask *head;
+	struct AccDispatchTask *tail;
+	bool		scheduled;
+	struct AccDispatchQueue *nextReady;
+	/* The idle source of the queue in the main context, and whether it runs a task now */
+	GSource		*idle;
+	bool		running;
+};
+
+struct AccPrewarm {
+	usb_accessory_h	accessory;
+	usb_accessory_session_prepare_cb prepare;
+	void		*userData;
+	usb_accessory_session_h session;
+	/* Set under the prewarm lock when the thread is done with the session */
+	bool		ready;
+};
+
+struct AccConnectionTask {
+	struct AccDispatchTask task;
+	void (*func)(usb_accessory_h accessory, bool is_connected, void *data);
+	void		*userData;
+	usb_accessory_h	accessory;
+	bool		connected;
+	struct AccPrewarm *prewarm;
+};
+
+struct AccPermissionTask {
+	struct AccDispatchTask task;
+	void (*func)(usb_accessory_h accessory, bool is_granted);
+	usb_accessory_h	accessory;
+	bool		granted;
+};
+
+struct AccCacheTask {
+	struct AccDispatchTask task;
+	usb_accessory_cache_changed_cb func;
+	void		*userData;
+	usb_accessory_h	accessory;
+	bool		attached;
+	usb_accessory_permission_e permission;
+};
+
+/* The provisional answer given to the app, to be confirmed with usb-server */
+struct AccCacheConfirm {
+	usb_accessory_cache_changed_cb func;
+	void		*userData;
+	unsigned int	cnt;
+	usb_accessory_permission_e permissions[ACC_CACHE_MAX_ENTRIES];
+	struct AccCacheEntry entries[ACC_CACHE_MAX_ENTRIES];
+};
+
 struct AccCbData {
 	void *user_data;
-	void (*connection_cb_func)(struct usb_accessory_s *accessory, bool is_connected, void *data);
-	void (*request_perm_cb_func)(struct usb_accessory_s *accessory, bool is_granted);
-	struct usb_accessory_s *accessory;
+	void (*connection_cb_func)(usb_accessory_h accessory, bool is_connected, void *data);
+	void (*request_perm_cb_func)(usb_accessory_h accessory, bool is_granted);
+	usb_accessory_h accessory;
 };
 
 int ipc_request_client_init(int *sock_remote);
 int ipc_request_client_close(int *sock_remote);
 int request_to_usb_server(int sock_remote, int request, char *answer, char *pkgName);
+int ipc_listen_socket_init(const char *path);
+int ipc_event_socket_init(void);
+const struct AccBackendOps *accBackend(void);
+int accBackendRegister(const struct AccBackendOps *ops);
+int accBackendSelect(const char *name);
 char *get_app_id();
 void accessory_status_changed_cb(keynode_t *in_key, void* data);
-bool getAccList(struct usb_accessory_list **accList);
+void init_connection_event_pipe(void);
+void reset_connection_event_pipe(void);
+int set_connection_debounce(unsigned int settleMs);
+unsigned int get_suppressed_connection_events(void);
+bool getAccList(struct usb_accessory_list **accList, struct usb_accessory_filter_s *filter);
+bool getAttachedAccList(struct usb_accessory_list **accList, struct usb_accessory_filter_s *filter);
+int setAccRaw(struct usb_accessory_s *accessory, const char *totalInfo);
+void indexRawInfo(const char *raw, unsigned int rawLen, unsigned short offset[], unsigned short len[]);
+bool indexAccRaw(struct usb_accessory_s *accessory);
+char *dupAccField(struct usb_accessory_s *accessory, ACCESSORY_INFO field);
+uint64_t getAccFingerprint(const char *raw, const unsigned short offset[], const unsigned short len[]);
+bool sameAccIdentity(struct usb_accessory_s *acc1, struct usb_accessory_s *acc2);
 bool freeAccList(struct usb_accessory_list *accList);
+int getAccPermission(struct usb_accessory_s *accessory, bool *granted);
+void accCacheRecordList(struct usb_accessory_list *accList);
+void accCacheRecordPermission(struct usb_accessory_s *accessory, bool granted);
 int ipc_noti_client_init(void);
 int ipc_noti_client_close(int *sock_remote);
 gboolean ipc_noti_client_cb(GIOChannel *g_io_ch, GIOCondition condition, gpointer data);
+int ipc_event_client_init(void *data);
+void ipc_event_client_close(void);
 bool is_emul_bin();
+const struct AccAulOps *accAul(void);
+const struct AccGlibOps *accGlib(void);
+const struct AccLz4Ops *accLz4(void);
+const char *getAccNodePath(void);
+bool accSessionEnter(struct usb_accessory_session_s *session);
+void accSessionLeave(struct usb_accessory_session_s *session);
+int accSessionRead(struct usb_accessory_session_s *session, char *buf, unsigned int len);
+int accSessionReadAll(struct usb_accessory_session_s *session, char *buf, unsigned int len);
+int accSessionWriteAll(struct usb_accessory_session_s *session, const char *buf, unsigned int len);
+int accFrameStart(struct usb_accessory_session_s *session);
+struct AccCapture *accCaptureOpen(const char *path, unsigned int size, unsigned int snapLen);
+void accCaptureClose(struct AccCapture *capture);
+struct AccCapture *accCaptureDefault(void);
+void accDispatch(ACC_DISPATCH_SUBSCRIBER subscriber, struct AccDispatchTask *task);
+int accDispatchSetMode(usb_accessory_dispatch_e mode, void *context, unsigned int workers);
+bool accDispatchInline(void);
+void accStatsReset(struct AccLatencyStats *stats);
+void accStatsWriteStart(struct AccLatencyStats *stats);
+void accStatsWriteDone(struct AccLatencyStats *stats, int ret);
+void accStatsReadDone(struct AccLatencyStats *stats, int ret);
+void accCaptureRecord(struct AccCapture *capture, unsigned int flags, const void *buf, int ret);
+void accFrameFree(struct usb_accessory_session_s *session);
+int accFrameReceive(struct usb_accessory_session_s *session, void *buf, unsigned int size, unsigned int *len);
+void *accRealtimeAlloc(struct usb_accessory_session_s *session, size_t size);
+void accRealtimeFree(struct usb_accessory_session_s *session, void *buf, size_t size);
+void accRealtimeEnterThread(struct usb_accessory_session_s *session);
+void accJitterRecord(struct AccJitterStats *jitter);
+int accBusyPollRead(struct usb_accessory_session_s *session, void *buf, unsigned int len);
+void accBusyPollReset(struct AccBusyPoll *poll);
+void accTuneStart(struct usb_accessory_session_s *session);
+void accPrewarmDispatch(struct AccConnectionTask *task);
+void accPrewarmAttach(struct AccPrewarm *prewarm);
+void accPrewarmRelease(struct AccPrewarm *prewarm);
+int accBufPoolStart(struct usb_accessory_session_s *session);
+void accBufPoolStop(struct usb_accessory_session_s *session);
+int accBroadcastStart(struct usb_accessory_session_s *session);
+void accBroadcastStop(struct usb_accessory_session_s *session);
+void accBroadcastRelease(struct AccBroadcast *ring);
+void accTuneTick(struct usb_accessory_session_s *session);
+int accPipelineStart(struct usb_accessory_session_s *session);
+void accPipelineStop(struct usb_accessory_session_s *session);
+int accLfQueueInit(struct AccLfQueue *queue, unsigned int size);
+void accLfQueueDestroy(struct AccLfQueue *queue);
+int accLfQueuePush(struct AccLfQueue *queue, void *data);
+void *accLfQueuePop(struct AccLfQueue *queue);
+void *accLfQueuePopWait(struct AccLfQueue *queue, volatile bool *stop);
+void accLfQueueWake(struct AccLfQueue *queue, unsigned int count);
+int set_connection_filter(struct usb_accessory_filter_s *filter);
+int accFilterCreate(struct usb_accessory_filter_s **filter);
+void accFilterDestroy(struct usb_accessory_filter_s *filter);
+int accFilterAddRule(struct usb_accessory_filter_s *filter, ACCESSORY_INFO field, int match, const char *pattern);
+int accFilterCopy(struct usb_accessory_filter_s *src, struct usb_accessory_filter_s **dst);
+bool accFilterMatchFields(struct usb_accessory_filter_s *filter, const char *raw,
+		const unsigned short offset[], const unsigned short len[]);
+bool accFilterMatchRaw(struct usb_accessory_filter_s *filter, const char *raw);
+bool accFilterMatch(struct usb_accessory_filter_s *filter, struct usb_accessory_s *accessory);
+int accShmReadStatus(int *status);
+int accShmReadAcc(unsigned int idx, char *raw, unsigned int rawSize, uint32_t *generation);
+void accShmSetName(const char *name);
+usb_accessory_h acc_handle_alloc(void);
+struct usb_accessory_s *acc_handle_get(usb_accessory_h handle);
+int acc_handle_free(usb_accessory_h handle);
 #endif /* __TIZEN_SYSTEM_USB_ACCESSORY_PRIVATE_H__ */
 
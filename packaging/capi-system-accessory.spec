@@ -29,6 +29,13 @@ Requires: %{name} = %{version}-%{release}
 %description devel
 
 
+%package tools
+Summary:  Tools for the files of the usb accessory library
+Group:    TO_BE/FILLED_IN
+
+%description tools
+acc_capture_dump prints the traffic captured by usb_accessory_session_set_capture().
+
 
 %prep
 %setup -q
@@ -36,7 +43,7 @@ Requires: %{name} = %{version}-%{release}
 
 %build
 MAJORVER=`echo %{version} | awk 'BEGIN {FS="."}{print $1}'`
-cmake . -DCMAKE_INSTALL_PREFIX=/usr -DFULLVER=%{version} -DMAJORVER=${MAJORVER}
+cmake . -DCMAKE_INSTALL_PREFIX=/usr -DFULLVER=%{version} -DMAJORVER=${MAJORVER} -DBUILD_TOOLS=ON
 
 make %{?jobs:-j%jobs}
 
@@ -64,4 +71,5 @@ rm -rf %{buildroot}
 %{_libdir}/pkgconfig/*.pc
 %{_libdir}/libcapi-system-usb-accessory.so
 
-
+%files tools
+%{_bindir}/acc_capture_dump
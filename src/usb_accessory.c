@@ -28,15 +28,19 @@ int usb_accessory_clone(usb_accessory_h handle, usb_accessory_h* cloned_handle)
 		return USB_ERROR_NOT_SUPPORTED;
 	}
 	if (!cloned_handle || *cloned_handle) return USB_ERROR_INVALID_PARAMETER;
-	*cloned_handle = (usb_accessory_h)malloc(sizeof(struct usb_accessory_s));
-	snprintf((*cloned_handle)->manufacturer, strlen(handle->manufacturer), "%s", handle->manufacturer);
-	snprintf((*cloned_handle)->model, strlen(handle->model), "%s", handle->model);
-	snprintf((*cloned_handle)->description, strlen(handle->description), "%s", handle->description);
-	snprintf((*cloned_handle)->version, strlen(handle->version), "%s", handle->version);
-	snprintf((*cloned_handle)->uri, strlen(handle->uri), "%s", handle->uri);
-	snprintf((*cloned_handle)->serial, strlen(handle->serial), "%s", handle->serial);
-
-	(*cloned_handle)->accPermission = false;
+	struct usb_accessory_s *accessory = acc_handle_get(handle);
+	if (!accessory) return USB_ERROR_INVALID_PARAMETER;
+	usb_accessory_h clone = acc_handle_alloc();
+	struct usb_accessory_s *cloned = acc_handle_get(clone);
+	um_retvm_if(cloned == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: acc_handle_alloc()\n");
+	setAccRaw(cloned, accessory->raw);
+	indexAccRaw(accessory);
+	memcpy(cloned->fieldOffset, accessory->fieldOffset, sizeof(cloned->fieldOffset));
+	memcpy(cloned->fieldLen, accessory->fieldLen, sizeof(cloned->fieldLen));
+	cloned->indexed = true;
+	cloned->fingerprint = accessory->fingerprint;
+	cloned->accPermission = false;
+	*cloned_handle = clone;
 
 	__USB_FUNC_EXIT__ ;
     return USB_ERROR_NONE;
@@ -50,7 +54,7 @@ int usb_accessory_destroy(usb_accessory_h handle)
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
-	FREE(handle);
+	if (acc_handle_free(handle) < 0) return USB_ERROR_INVALID_PARAMETER;
 	__USB_FUNC_EXIT__ ;
 	return USB_ERROR_NONE;
 }
@@ -66,9 +70,8 @@ int usb_accessory_foreach_attached(usb_accessory_attached_cb callback, void *use
 	struct usb_accessory_list *accList = NULL;
 	struct usb_accessory_list *tmpList = NULL;
 	bool ret = false;
-	ret = getAccList(&accList);
+	ret = getAccList(&accList, NULL);
 	um_retvm_if(ret == false, -1, "FAIL: getAccList(accList)\n");
-	um_retvm_if(accList == NULL, -1, "ERROR: accList == NULL\n");
 
 	ret = true;
 	tmpList = accList;
@@ -90,6 +93,36 @@ int usb_accessory_foreach_attached(usb_accessory_attached_cb callback, void *use
 }
 
 
+int usb_accessory_foreach_attached_with_filter(usb_accessory_filter_h filter, usb_accessory_attached_cb callback, void *user_data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (filter == NULL) return USB_ERROR_INVALID_PARAMETER;
+	if (callback == NULL) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	struct usb_accessory_list *accList = NULL;
+	struct usb_accessory_list *tmpList = NULL;
+	bool ret = false;
+	ret = getAccList(&accList, filter);
+	um_retvm_if(ret == false, USB_ERROR_OPERATION_FAILED, "FAIL: getAccList(accList, filter)\n");
+
+	ret = true;
+	tmpList = accList;
+	while (ret && tmpList && tmpList->accessory) {
+		ret = callback(tmpList->accessory, user_data);
+		tmpList = tmpList->next;
+	}
+
+	ret = freeAccList(accList);
+	um_retvm_if(ret == false, USB_ERROR_OPERATION_FAILED, "FAIL: freeAccList(accList)\n");
+
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+
 int usb_accessory_set_connection_changed_cb(usb_accessory_connection_changed_cb callback, void* user_data)
 {
 	__USB_FUNC_ENTER__ ;
@@ -101,8 +134,11 @@ int usb_accessory_set_connection_changed_cb(usb_accessory_connection_changed_cb
 	accCbData = (struct AccCbData *)malloc(sizeof(struct AccCbData));
 	accCbData->user_data = user_data;
 	accCbData->connection_cb_func = callback;
-	ret = vconf_notify_key_changed(VCONFKEY_USB_ACCESSORY_STATUS, accessory_status_changed_cb, accCbData);
-	um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: vconf_notify_key_changed(VCONFKEY_USB_ACCESSORY_STATUS)\n");
+	init_connection_event_pipe();
+	ret = accBackend()->watch_status(accessory_status_changed_cb, accCbData);
+	um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: watch_status()\n");
+	ret = ipc_event_client_init(accCbData);
+	if (ret < 0) USB_LOG("Pushed events are not available. Only vconf key is used\n");
 	__USB_FUNC_EXIT__ ;
     return USB_ERROR_NONE;
 }
@@ -116,9 +152,11 @@ int usb_accessory_connection_unset_cb()
 		return USB_ERROR_NOT_SUPPORTED;
 	}
 	if (accCbData != NULL) {
+		ipc_event_client_close();
+		reset_connection_event_pipe();
 		FREE(accCbData);
-		int ret = vconf_ignore_key_changed(VCONFKEY_USB_ACCESSORY_STATUS, accessory_status_changed_cb);
-		um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: vconf_ignore_key_changed(VCONFKEY_USB_ACCESSORY_status");
+		int ret = accBackend()->unwatch_status(accessory_status_changed_cb);
+		um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: unwatch_status()\n");
 	}
 	__USB_FUNC_EXIT__ ;
 
@@ -126,49 +164,83 @@ int usb_accessory_connection_unset_cb()
 }
  
 
-int usb_accessory_has_permission(usb_accessory_h accessory, bool* is_granted)
+int usb_accessory_set_connection_filter(usb_accessory_filter_h filter)
 {
 	__USB_FUNC_ENTER__ ;
-	if (!accessory) return USB_ERROR_INVALID_PARAMETER;
 	if (is_emul_bin()) {
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
-	if (accessory->accPermission == true) {
-		__USB_FUNC_EXIT__ ;
-		return USB_ERROR_NONE;
-	} else {
-		int ret = -1;
-		int ipc_result = -1;
-		int sock_remote;
-		char buf[SOCK_STR_LEN];
-		char *app_id = get_app_id();
-		if(app_id == NULL) {
-			USB_LOG("FAIL: get_app_id()\n");
-			*is_granted = false;
-			return USB_ERROR_NONE;
-		}
+	int ret = set_connection_filter(filter);
+	um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: set_connection_filter(filter)\n");
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+
+int usb_accessory_set_connection_debounce(unsigned int settle_ms)
+{
+	__USB_FUNC_ENTER__ ;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	int ret = set_connection_debounce(settle_ms);
+	um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: set_connection_debounce(%u)\n", settle_ms);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
 
-		ret = ipc_request_client_init(&sock_remote);
-		um_retvm_if(ret < 0, USB_ERROR_PERMISSION_DENIED, "FAIL: ipc_request_client_init()\n");
 
-		ret = request_to_usb_server(sock_remote, HAS_ACC_PERMISSION, buf, app_id);
-		um_retvm_if(ret < 0, USB_ERROR_PERMISSION_DENIED, "FAIL: request_to_usb_server()\n");
+int usb_accessory_set_dispatch(usb_accessory_dispatch_e dispatch, void *main_context, unsigned int workers)
+{
+	__USB_FUNC_ENTER__ ;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	if (dispatch < USB_ACCESSORY_DISPATCH_INLINE || dispatch > USB_ACCESSORY_DISPATCH_WORKER_POOL)
+		return USB_ERROR_INVALID_PARAMETER;
+	if (dispatch == USB_ACCESSORY_DISPATCH_WORKER_POOL && (workers == 0 || workers > ACC_DISPATCH_MAX_WORKERS))
+		return USB_ERROR_INVALID_PARAMETER;
+	int ret = accDispatchSetMode(dispatch, main_context, workers);
+	um_retvm_if(ret != USB_ERROR_NONE, ret, "FAIL: accDispatchSetMode(%d)\n", dispatch);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
 
-		ret = ipc_request_client_close(&sock_remote);
-		um_retvm_if(ret < 0, USB_ERROR_PERMISSION_DENIED, "FAIL: ipc_request_client_close()\n");
 
-		FREE(app_id);
+int usb_accessory_get_suppressed_event_count(unsigned int *count)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!count) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	*count = get_suppressed_connection_events();
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
 
-		USB_LOG("Permission: %s\n", buf);
-		ipc_result = atoi(buf);
-		if (IPC_SUCCESS == ipc_result) {
-			accessory->accPermission = true;
-			*is_granted = true;
-		} else {
-			accessory->accPermission = false;
-			*is_granted = false;
-		}
+
+int usb_accessory_has_permission(usb_accessory_h accessory, bool* is_granted)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!accessory) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	if (acc->accPermission == true) {
+		*is_granted = true;
+		__USB_FUNC_EXIT__ ;
+		return USB_ERROR_NONE;
+	} else {
+		int ret = getAccPermission(acc, is_granted);
+		um_retvm_if(ret < 0, USB_ERROR_PERMISSION_DENIED, "FAIL: getAccPermission()\n");
 		__USB_FUNC_EXIT__ ;
 		return USB_ERROR_NONE;
 	}
@@ -183,8 +255,10 @@ int usb_accessory_open(usb_accessory_h accessory, FILE **fd)
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
-	if (accessory->accPermission == true) {
-		*fd = fopen(USB_ACCESSORY_NODE, "r+");
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	if (acc->accPermission == true) {
+		*fd = accBackend()->open_stream();
 		USB_LOG("file pointer: %d", *fd);
 	} else {
 		USB_LOG("Permission is not allowed");
@@ -203,7 +277,10 @@ int usb_accessory_get_description(usb_accessory_h accessory, char** description)
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
-	*description = strdup(accessory->description);
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	*description = dupAccField(acc, ACC_DESCRIPTION);
+	um_retvm_if(*description == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: dupAccField(acc, ACC_DESCRIPTION)\n");
 	__USB_FUNC_ENTER__ ;
     return USB_ERROR_NONE;
 }
@@ -217,7 +294,10 @@ int usb_accessory_get_manufacturer(usb_accessory_h accessory, char** manufacture
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
-	*manufacturer = strdup(accessory->manufacturer);
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	*manufacturer = dupAccField(acc, ACC_MANUFACTURER);
+	um_retvm_if(*manufacturer == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: dupAccField(acc, ACC_MANUFACTURER)\n");
 	__USB_FUNC_ENTER__ ;
     return USB_ERROR_NONE;
 }
@@ -231,7 +311,10 @@ int usb_accessory_get_model(usb_accessory_h accessory, char** model)
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
-	*model = strdup(accessory->model);
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	*model = dupAccField(acc, ACC_MODEL);
+	um_retvm_if(*model == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: dupAccField(acc, ACC_MODEL)\n");
 	__USB_FUNC_ENTER__ ;
     return USB_ERROR_NONE;
 }
@@ -245,7 +328,10 @@ int usb_accessory_get_serial(usb_accessory_h accessory, char** serial)
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
-	*serial = strdup(accessory->serial);
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	*serial = dupAccField(acc, ACC_SERIAL);
+	um_retvm_if(*serial == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: dupAccField(acc, ACC_SERIAL)\n");
 	__USB_FUNC_ENTER__ ;
     return USB_ERROR_NONE;
 }
@@ -259,7 +345,10 @@ int usb_accessory_get_version(usb_accessory_h accessory, char** version)
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
-	*version = strdup(accessory->version);
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	*version = dupAccField(acc, ACC_VERSION);
+	um_retvm_if(*version == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: dupAccField(acc, ACC_VERSION)\n");
 	__USB_FUNC_ENTER__ ;
     return USB_ERROR_NONE;
 }
@@ -274,8 +363,11 @@ int usb_accessory_is_connected(usb_accessory_h accessory, bool* is_connected)
 	}
 	int ret = -1;
 	int val = -1;
-	ret = vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS, &val);
-	um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS)\n");
+	ret = accShmReadStatus(&val);
+	if (ret < 0) {
+		ret = accBackend()->get_status(&val);
+		um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: get_status()\n");
+	}
 	switch (val) {
 	case VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED:
 		*is_connected = true;
@@ -297,9 +389,9 @@ int usb_accessory_request_permission(usb_accessory_h accessory, usb_accessory_pe
 		USB_LOG("FAIL:USB Accessory is not available with emulator.");
 		return USB_ERROR_NOT_SUPPORTED;
 	}
+	if (!acc_handle_get(accessory)) return USB_ERROR_INVALID_PARAMETER;
 	int ret = -1;
 	guint g_ret = 0;
-	int sock_remote;
 	char buf[SOCK_STR_LEN];
 	char *app_id = get_app_id();
 	accCbData->user_data = accessory;
@@ -309,51 +401,109 @@ int usb_accessory_request_permission(usb_accessory_h accessory, usb_accessory_pe
 	GIOStatus gio_ret;
 
 	int fd = ipc_noti_client_init();
-	GIOChannel *g_io_ch = g_io_channel_unix_new(fd);
-	g_ret = g_io_add_watch(g_io_ch, G_IO_IN, ipc_noti_client_cb, (gpointer)accCbData);
-	um_retvm_if (0 == g_ret, USB_ERROR_PERMISSION_DENIED, "FAIL: g_io_add_watch(g_io_ch, G_IO_IN)\n");
-
-	ret = ipc_request_client_init(&sock_remote);
-	if(ret < 0) {
-		USB_LOG("FAIL: ipc_request_client_init(&sock_remote)\n");
-		ret = ipc_request_client_close(&sock_remote);
-		if (ret < 0) USB_LOG("FAIL: ipc_request_client_close(&sock_remote)\n");
-		ret = ipc_noti_client_close(&fd);
-		if (ret < 0) USB_LOG("FAIL: ipc_noti_client_close(&fd)\n");
-		gio_ret = g_io_channel_shutdown(g_io_ch, TRUE, &err);
-		if (G_IO_STATUS_ERROR == gio_ret) USB_LOG("ERROR: g_io_channel_shutdown(g_io_ch)\n");
-		g_io_channel_unref(g_io_ch);
+	if (fd < 0) {
+		USB_LOG("FAIL: ipc_noti_client_init()\n");
 		FREE(app_id);
 		return USB_ERROR_PERMISSION_DENIED;
 	}
+	GIOChannel *g_io_ch = accGlib()->io_channel_unix_new(fd);
+	g_ret = accGlib()->io_add_watch(g_io_ch, G_IO_IN, ipc_noti_client_cb, (gpointer)accCbData);
+	um_retvm_if (0 == g_ret, USB_ERROR_PERMISSION_DENIED, "FAIL: g_io_add_watch(g_io_ch, G_IO_IN)\n");
 
-	ret = request_to_usb_server(sock_remote, REQ_ACC_PERMISSION, buf, app_id);
+	ret = accBackend()->request(REQ_ACC_PERMISSION, buf, app_id);
 	if(ret < 0) {
-		USB_LOG("FAIL: request_to_usb_server(REQ_ACC_PERMISSION)\n");
-		ret = ipc_request_client_close(&sock_remote);
-		if (ret < 0) USB_LOG("FAIL: ipc_request_client_close(&sock_remote)\n");
+		USB_LOG("FAIL: request(REQ_ACC_PERMISSION)\n");
 		ret = ipc_noti_client_close(&fd);
 		if (ret < 0) USB_LOG("FAIL: ipc_noti_client_close(&fd)\n");
-		gio_ret = g_io_channel_shutdown(g_io_ch, TRUE, &err);
+		gio_ret = accGlib()->io_channel_shutdown(g_io_ch, TRUE, &err);
 		if (G_IO_STATUS_ERROR == gio_ret) USB_LOG("ERROR: g_io_channel_shutdown(g_io_ch)\n");
-		g_io_channel_unref(g_io_ch);
+		accGlib()->io_channel_unref(g_io_ch);
 		FREE(app_id);
 		return USB_ERROR_PERMISSION_DENIED;
 	}
 
 	FREE(app_id);
 
-	ret = ipc_request_client_close(&sock_remote);
-	if (ret < 0) {
-		USB_LOG("FAIL: ipc_request_client_close(&sock_remote)\n");
-		ret = ipc_noti_client_close(&fd);
-		if (ret < 0) USB_LOG("FAIL: ipc_noti_client_close(&fd)\n");
-		gio_ret = g_io_channel_shutdown(g_io_ch, TRUE, &err);
-		if (G_IO_STATUS_ERROR == gio_ret) USB_LOG("ERROR: g_io_channel_shutdown(g_io_ch)\n");
-		g_io_channel_unref(g_io_ch);
-		return USB_ERROR_PERMISSION_DENIED;
+	__USB_FUNC_EXIT__ ;
+    return USB_ERROR_NONE;
+}
+
+
+int usb_accessory_get_fingerprint(usb_accessory_h accessory, uint64_t *fingerprint)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!fingerprint) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
 	}
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	*fingerprint = acc->fingerprint;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
 
+
+int usb_accessory_equals(usb_accessory_h accessory1, usb_accessory_h accessory2, bool *is_equal)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!is_equal) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	struct usb_accessory_s *acc1 = acc_handle_get(accessory1);
+	struct usb_accessory_s *acc2 = acc_handle_get(accessory2);
+	if (!acc1 || !acc2) return USB_ERROR_INVALID_PARAMETER;
+	*is_equal = (acc1->fingerprint == acc2->fingerprint) && sameAccIdentity(acc1, acc2);
 	__USB_FUNC_EXIT__ ;
-    return USB_ERROR_NONE;
+	return USB_ERROR_NONE;
+}
+
+
+int usb_accessory_filter_create(usb_accessory_filter_h *filter)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!filter) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	int ret = accFilterCreate(filter);
+	um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: accFilterCreate(filter)\n");
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+
+int usb_accessory_filter_destroy(usb_accessory_filter_h filter)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!filter) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	accFilterDestroy(filter);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+
+int usb_accessory_filter_add_rule(usb_accessory_filter_h filter, usb_accessory_field_e field, usb_accessory_match_e match, const char *pattern)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!filter || !pattern) return USB_ERROR_INVALID_PARAMETER;
+	if (field < USB_ACCESSORY_FIELD_MANUFACTURER || field > USB_ACCESSORY_FIELD_SERIAL) return USB_ERROR_INVALID_PARAMETER;
+	if (match < USB_ACCESSORY_MATCH_EXACT || match > USB_ACCESSORY_MATCH_GLOB) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	if (strlen(pattern) >= ACC_ELEMENT_LEN) return USB_ERROR_INVALID_PARAMETER;
+	int ret = accFilterAddRule(filter, (ACCESSORY_INFO)field, match, pattern);
+	um_retvm_if(ret < 0, USB_ERROR_OPERATION_FAILED, "FAIL: accFilterAddRule(filter, %d, %d, %s)\n", field, match, pattern);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
 }
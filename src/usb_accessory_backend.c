@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+#include <poll.h>
+
+/* Backends carry the requests to usb-server, the connection status and the data.
+ * The system backend talks to usb-server by sockets, vconf and the accessory node.
+ * It is the only one in the library. The benchmarks and the tests register
+ * their own backend (bench/acc_inproc_backend.c) and select it before the first use. */
+
+/* System backend */
+
+static int sysRequest(int request, char *answer, char *appId)
+{
+	int sock_remote = -1;
+	int ret = ipc_request_client_init(&sock_remote);
+	if (ret < 0) {
+		USB_LOG("FAIL: ipc_request_client_init(&sock_remote)\n");
+		if (sock_remote >= 0) ipc_request_client_close(&sock_remote);
+		return -1;
+	}
+	ret = request_to_usb_server(sock_remote, request, answer, appId);
+	ipc_request_client_close(&sock_remote);
+	um_retvm_if(ret < 0, -1, "FAIL: request_to_usb_server(%d)\n", request);
+	return 0;
+}
+
+static int sysGetStatus(int *status)
+{
+	int ret = vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS, status);
+	um_retvm_if(ret < 0, -1, "FAIL: vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS)\n");
+	return 0;
+}
+
+static int sysWatchStatus(vconf_callback_fn func, void *data)
+{
+	return vconf_notify_key_changed(VCONFKEY_USB_ACCESSORY_STATUS, func, data);
+}
+
+static int sysUnwatchStatus(vconf_callback_fn func)
+{
+	return vconf_ignore_key_changed(VCONFKEY_USB_ACCESSORY_STATUS, func);
+}
+
+static int sysListenAnswers(void)
+{
+	return ipc_listen_socket_init(ACC_SOCK_PATH);
+}
+
+static int sysListenEvents(void)
+{
+	return ipc_event_socket_init();
+}
+
+/* The socket is abstract, so nothing is left in the file system */
+static void sysUnlistenEvents(int sock)
+{
+	close(sock);
+}
+
+static int sysOpenChannel(void)
+{
+	int fd = open(getAccNodePath(), O_RDWR | O_CLOEXEC);
+	um_retvm_if(fd < 0, -1, "FAIL: open(%s) (%d)\n", getAccNodePath(), errno);
+	return fd;
+}
+
+static int sysReadChannel(int channel, void *buf, unsigned int len)
+{
+	return read(channel, buf, len);
+}
+
+static int sysPollChannel(int channel)
+{
+	struct pollfd pfd = { .fd = channel, .events = POLLIN, .revents = 0 };
+	int ret = poll(&pfd, 1, 0);
+	if (ret <= 0) return (ret < 0 && errno != EINTR) ? -1 : 0;
+	return 1;
+}
+
+static int sysWriteChannel(int channel, const void *buf, unsigned int len)
+{
+	return write(channel, buf, len);
+}
+
+static void sysCloseChannel(int channel)
+{
+	close(channel);
+}
+
+static FILE *sysOpenStream(void)
+{
+	return fopen(getAccNodePath(), "r+");
+}
+
+static const struct AccBackendOps systemBackend = {
+	.name = "system",
+	.sharedState = true,
+	.request = sysRequest,
+	.get_status = sysGetStatus,
+	.watch_status = sysWatchStatus,
+	.unwatch_status = sysUnwatchStatus,
+	.listen_answers = sysListenAnswers,
+	.listen_events = sysListenEvents,
+	.unlisten_events = sysUnlistenEvents,
+	.open_channel = sysOpenChannel,
+	.read_channel = sysReadChannel,
+	.poll_channel = sysPollChannel,
+	.write_channel = sysWriteChannel,
+	.close_channel = sysCloseChannel,
+	.open_stream = sysOpenStream,
+};
+
+static const struct AccBackendOps *backends[ACC_BACKEND_MAX] = {
+	&systemBackend,
+};
+static unsigned int backendCnt = 1;
+
+static const struct AccBackendOps *currentBackend = &systemBackend;
+static pthread_mutex_t backendLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct AccBackendOps *findBackend(const char *name)
+{
+	unsigned int i;
+	for (i = 0 ; i < backendCnt ; i++) {
+		if (!strcmp(backends[i]->name, name)) return backends[i];
+	}
+	return NULL;
+}
+
+const struct AccBackendOps *accBackend(void)
+{
+	return currentBackend;
+}
+
+/* Add a backend which can be selected by name. It returns -1 if there is no room or the name is taken */
+int accBackendRegister(const struct AccBackendOps *ops)
+{
+	if (!ops || !ops->name) return -1;
+	pthread_mutex_lock(&backendLock);
+	if (backendCnt >= ACC_BACKEND_MAX || findBackend(ops->name)) {
+		pthread_mutex_unlock(&backendLock);
+		USB_LOG_ERROR("ERROR: Backend %s cannot be registered\n", ops->name);
+		return -1;
+	}
+	backends[backendCnt++] = ops;
+	pthread_mutex_unlock(&backendLock);
+	return 0;
+}
+
+/* Select a backend by name before the library is used. It returns -1 if there is no such backend */
+int accBackendSelect(const char *name)
+{
+	const struct AccBackendOps *ops = NULL;
+	if (!name) return -1;
+	pthread_mutex_lock(&backendLock);
+	ops = findBackend(name);
+	if (ops) currentBackend = ops;
+	pthread_mutex_unlock(&backendLock);
+	um_retvm_if(ops == NULL, -1, "ERROR: Unknown backend %s\n", name);
+	USB_LOG("Backend: %s\n", name);
+	return 0;
+}
@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Broadcast ring of a session. A receiver thread fills the entries in sequence
+ * and publishes each by moving the published sequence, and every consumer reads
+ * them in place at its own sequence. An entry is overwritten only when the gates
+ * of all the consumers are past it. The receiver keeps a lower bound of the gates,
+ * so that it takes the lock only when the ring may be full.
+ * With the DROP policy, the receiver does not wait for the consumers, and overwrites
+ * the entries of those a whole ring behind. Each entry is marked with the sequence
+ * it holds, which a consumer checks after it read the entry, and a consumer which
+ * finds its entry overwritten is dropped. */
+
+static inline uint64_t broadcastNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void freeBroadcast(struct AccBroadcast *ring)
+{
+	if (ring->region) munmap(ring->region, ring->regionLen);
+	FREE(ring->entries);
+	pthread_cond_destroy(&ring->spaceCond);
+	pthread_cond_destroy(&ring->dataCond);
+	pthread_mutex_destroy(&ring->lock);
+	FREE(ring);
+}
+
+void accBroadcastRelease(struct AccBroadcast *ring)
+{
+	if (__sync_sub_and_fetch(&ring->refs, 1) == 0) freeBroadcast(ring);
+}
+
+/* Called by a consumer after its gate moved */
+static void wakeReceiver(struct AccBroadcast *ring)
+{
+	__sync_synchronize();
+	if (!ring->spaceWaiting) return;
+	pthread_mutex_lock(&ring->lock);
+	pthread_cond_signal(&ring->spaceCond);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+static void wakeConsumers(struct AccBroadcast *ring)
+{
+	__sync_synchronize();
+	if (__sync_fetch_and_add(&ring->dataWaiters, 0) == 0) return;
+	pthread_mutex_lock(&ring->lock);
+	pthread_cond_broadcast(&ring->dataCond);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+/* Wait until the entry of seq is free with the BLOCK policy. It returns -1 if stopped */
+static int waitForSpace(struct AccBroadcast *ring, uint64_t seq)
+{
+	struct usb_accessory_consumer_s *consumer = NULL;
+	struct usb_accessory_consumer_s *slowest = NULL;
+	struct usb_accessory_consumer_s *stalled = NULL;
+	uint64_t minGate;
+	uint64_t gate;
+	uint64_t start;
+
+	if (seq < ring->minGate + ring->count) return 0;
+
+	pthread_mutex_lock(&ring->lock);
+	ring->spaceWaiting = 1;
+	__sync_synchronize();
+	while (!ring->stopping) {
+		minGate = seq;
+		slowest = NULL;
+		for (consumer = ring->consumers ; consumer ; consumer = consumer->next) {
+			gate = consumer->gate;
+			if (gate == ACC_BROADCAST_DETACHED) continue;
+			if (gate < minGate) {
+				minGate = gate;
+				slowest = consumer;
+			}
+		}
+		ring->minGate = minGate;
+		if (minGate + ring->count > seq) break;
+
+		/* A stall is counted once for each consumer waited for */
+		if (slowest != stalled) slowest->stalls++;
+		stalled = slowest;
+		start = broadcastNow();
+		pthread_cond_wait(&ring->spaceCond, &ring->lock);
+		/* The consumer may be destroyed while waiting */
+		for (consumer = ring->consumers ; consumer && consumer != slowest ; consumer = consumer->next);
+		if (consumer) consumer->stallNs += broadcastNow() - start;
+	}
+	ring->spaceWaiting = 0;
+	pthread_mutex_unlock(&ring->lock);
+	return ring->stopping ? -1 : 0;
+}
+
+/* Wait until the entry of seq is published or the ring ends. It returns the published sequence */
+static uint64_t waitForData(struct AccBroadcast *ring, uint64_t seq)
+{
+	uint64_t published;
+	int spin;
+
+	for (spin = 0 ; spin < ACC_BROADCAST_SPIN ; spin++) {
+		if (ring->published > seq || ring->ended) goto out;
+	}
+	pthread_mutex_lock(&ring->lock);
+	ring->dataWaiters++;
+	__sync_synchronize();
+	while (ring->published <= seq && !ring->ended)
+		pthread_cond_wait(&ring->dataCond, &ring->lock);
+	ring->dataWaiters--;
+	pthread_mutex_unlock(&ring->lock);
+out:
+	/* The final sequence is published before the end */
+	published = ring->published;
+	__sync_synchronize();
+	return published;
+}
+
+static void endBroadcast(struct AccBroadcast *ring)
+{
+	ring->ended = true;
+	__sync_synchronize();
+	pthread_mutex_lock(&ring->lock);
+	pthread_cond_broadcast(&ring->dataCond);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+static void *broadcastReceiver(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct usb_accessory_session_s *session = (struct usb_accessory_session_s *)data;
+	struct AccBroadcast *ring = session->broadcast;
+	struct AccBroadcastEntry *entry = NULL;
+	uint64_t seq = ring->published;
+	unsigned int len;
+	int ret;
+
+	while (!ring->stopping) {
+		if (ring->policy == USB_ACCESSORY_BROADCAST_BLOCK && waitForSpace(ring, seq) < 0) break;
+		entry = &(ring->entries[seq & ring->mask]);
+		entry->seq = ACC_BROADCAST_FILLING;
+		__sync_synchronize();
+		if (session->framed) {
+			ret = accFrameReceive(session, entry->data, ring->size, &len);
+			if (ret != USB_ERROR_NONE) ret = -1;
+		} else {
+			ret = accSessionRead(session, entry->data, ring->size);
+			len = ret;
+		}
+		if (ret < 0 || (!session->framed && ret == 0)) break;
+		entry->len = len;
+		__sync_synchronize();
+		entry->seq = seq;
+		ring->published = ++seq;
+		wakeConsumers(ring);
+	}
+	USB_LOG("Broadcast receiver stops after %llu entries\n", (unsigned long long)seq);
+	endBroadcast(ring);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+int accBroadcastStart(struct usb_accessory_session_s *session)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccBroadcast *ring = session->broadcast;
+	unsigned int i;
+	int ret;
+
+	if (ring->size == 0) ring->size = session->framed ? session->frameMax : session->raSize;
+	ring->stride = (ring->size + ACC_BUF_ALIGN - 1) & ~(ACC_BUF_ALIGN - 1);
+	ring->regionLen = (size_t)ring->stride * ring->count;
+	ring->region = mmap(NULL, ring->regionLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring->region == MAP_FAILED) {
+		ring->region = NULL;
+		USB_LOG("FAIL: mmap(%zu) (%d)\n", ring->regionLen, errno);
+		return -1;
+	}
+	ring->entries = (struct AccBroadcastEntry *)calloc(ring->count, sizeof(struct AccBroadcastEntry));
+	um_retvm_if(ring->entries == NULL, -1, "FAIL: calloc(AccBroadcastEntry)\n");
+	for (i = 0 ; i < ring->count ; i++) {
+		ring->entries[i].data = ring->region + (size_t)i * ring->stride;
+		ring->entries[i].seq = ACC_BROADCAST_FILLING;
+	}
+
+	ret = pthread_create(&ring->receiver, NULL, broadcastReceiver, session);
+	if (ret != 0) {
+		USB_LOG("FAIL: pthread_create(receiver) (%d)\n", ret);
+		return -1;
+	}
+	ring->receiverRunning = true;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* The session must be stopping, so that the receiver does not wait for the accessory.
+ * The entries stay for the consumers until the ring is released */
+void accBroadcastStop(struct usb_accessory_session_s *session)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccBroadcast *ring = session->broadcast;
+
+	if (!ring) return;
+	pthread_mutex_lock(&ring->lock);
+	ring->stopping = true;
+	pthread_cond_signal(&ring->spaceCond);
+	pthread_mutex_unlock(&ring->lock);
+	if (ring->receiverRunning) {
+		pthread_join(ring->receiver, NULL);
+		ring->receiverRunning = false;
+	}
+	endBroadcast(ring);
+	__USB_FUNC_EXIT__ ;
+}
+
+int usb_accessory_session_set_broadcast(usb_accessory_session_h session, unsigned int entries, unsigned int entry_size,
+		usb_accessory_broadcast_policy_e policy)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (entries > ACC_BROADCAST_MAX_ENTRIES || entry_size > ACC_BROADCAST_MAX_SIZE) return USB_ERROR_INVALID_PARAMETER;
+	if (policy != USB_ACCESSORY_BROADCAST_BLOCK && policy != USB_ACCESSORY_BROADCAST_DROP) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started || (entries > 0 && (session->pipeline || session->poolCount > 0))) return USB_ERROR_INVALID_OPERATION;
+	if (session->broadcast && session->broadcast->consumers) return USB_ERROR_INVALID_OPERATION;
+	struct AccBroadcast *ring = NULL;
+	unsigned int count = 1;
+
+	if (session->broadcast) {
+		accBroadcastRelease(session->broadcast);
+		session->broadcast = NULL;
+	}
+	if (entries == 0) {
+		__USB_FUNC_EXIT__ ;
+		return USB_ERROR_NONE;
+	}
+
+	ring = (struct AccBroadcast *)calloc(1, sizeof(struct AccBroadcast));
+	um_retvm_if(ring == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: calloc(AccBroadcast)\n");
+	while (count < entries) count <<= 1;
+	ring->count = count;
+	ring->mask = count - 1;
+	ring->size = entry_size;
+	ring->policy = policy;
+	ring->refs = 1;
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->dataCond, NULL);
+	pthread_cond_init(&ring->spaceCond, NULL);
+	session->broadcast = ring;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_consumer_create(usb_accessory_session_h session, usb_accessory_consumer_h *consumer)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session || !consumer) return USB_ERROR_INVALID_PARAMETER;
+	if (!session->broadcast) return USB_ERROR_INVALID_OPERATION;
+	struct AccBroadcast *ring = session->broadcast;
+	struct usb_accessory_consumer_s *newConsumer = NULL;
+
+	newConsumer = (struct usb_accessory_consumer_s *)calloc(1, sizeof(struct usb_accessory_consumer_s));
+	um_retvm_if(newConsumer == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: calloc(usb_accessory_consumer_s)\n");
+	newConsumer->ring = ring;
+	__sync_fetch_and_add(&ring->refs, 1);
+
+	/* The receiver reads the gates under the lock, so the new one starts at the published sequence */
+	pthread_mutex_lock(&ring->lock);
+	newConsumer->seq = ring->published;
+	newConsumer->gate = newConsumer->seq;
+	newConsumer->next = ring->consumers;
+	ring->consumers = newConsumer;
+	pthread_mutex_unlock(&ring->lock);
+
+	*consumer = newConsumer;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_consumer_destroy(usb_accessory_consumer_h consumer)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!consumer) return USB_ERROR_INVALID_PARAMETER;
+	struct AccBroadcast *ring = consumer->ring;
+	struct usb_accessory_consumer_s **link = NULL;
+
+	pthread_mutex_lock(&ring->lock);
+	for (link = &(ring->consumers) ; *link ; link = &((*link)->next)) {
+		if (*link == consumer) {
+			*link = consumer->next;
+			break;
+		}
+	}
+	pthread_cond_signal(&ring->spaceCond);
+	pthread_mutex_unlock(&ring->lock);
+
+	FREE(consumer);
+	accBroadcastRelease(ring);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+/* Called by a consumer which found an entry it read overwritten */
+static int dropConsumer(struct usb_accessory_consumer_s *consumer, const void **data, unsigned int *len)
+{
+	USB_LOG("A consumer is %llu entries behind and is dropped\n",
+			(unsigned long long)(consumer->ring->published - consumer->seq));
+	consumer->dropped = true;
+	consumer->gate = ACC_BROADCAST_DETACHED;
+	*data = NULL;
+	*len = 0;
+	return USB_ERROR_RESOURCE_BUSY;
+}
+
+int usb_accessory_consumer_next(usb_accessory_consumer_h consumer, const void **data, unsigned int *len)
+{
+	if (!consumer || !data || !len) return USB_ERROR_INVALID_PARAMETER;
+	struct AccBroadcast *ring = consumer->ring;
+	struct AccBroadcastEntry *entry = NULL;
+	uint64_t seq = consumer->seq;
+	uint64_t published;
+
+	if (consumer->gate == ACC_BROADCAST_DETACHED) return USB_ERROR_RESOURCE_BUSY;
+	/* With DROP, the entry held since the last call may have been overwritten while the app read it */
+	if (ring->policy == USB_ACCESSORY_BROADCAST_DROP && consumer->entries > 0) {
+		__sync_synchronize();
+		if (ring->entries[(seq - 1) & ring->mask].seq != seq - 1) return dropConsumer(consumer, data, len);
+	}
+	/* Release the entry held since the last call */
+	consumer->gate = seq;
+	wakeReceiver(ring);
+
+	published = waitForData(ring, seq);
+	if (published <= seq) {
+		*data = NULL;
+		*len = 0;
+		return USB_ERROR_NOT_CONNECTED;
+	}
+	if (published - seq > ring->count) return dropConsumer(consumer, data, len);
+	entry = &(ring->entries[seq & ring->mask]);
+	*data = entry->data;
+	*len = entry->len;
+	__sync_synchronize();
+	if (entry->seq != seq) return dropConsumer(consumer, data, len);
+	if (published - seq - 1 > consumer->maxLag) consumer->maxLag = published - seq - 1;
+	consumer->entries++;
+	consumer->bytes += entry->len;
+	consumer->seq = seq + 1;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_consumer_get_stats(usb_accessory_consumer_h consumer, usb_accessory_consumer_stats_s *stats)
+{
+	if (!consumer || !stats) return USB_ERROR_INVALID_PARAMETER;
+	struct AccBroadcast *ring = consumer->ring;
+	uint64_t published = ring->published;
+	uint64_t seq = consumer->seq;
+
+	memset(stats, 0, sizeof(usb_accessory_consumer_stats_s));
+	stats->entries = consumer->entries;
+	stats->bytes = consumer->bytes;
+	stats->lag = (published > seq) ? published - seq : 0;
+	stats->max_lag = consumer->maxLag;
+	pthread_mutex_lock(&ring->lock);
+	stats->stalls = consumer->stalls;
+	stats->stall_us = consumer->stallNs / 1000;
+	pthread_mutex_unlock(&ring->lock);
+	stats->dropped = consumer->dropped;
+	return USB_ERROR_NONE;
+}
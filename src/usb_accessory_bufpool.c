@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Receive buffer pool of a session. The buffers are slots of one mapping,
+ * each starting on a cache line. A receiver thread fills a free slot with
+ * a unit of data and hands it to the app as a view. Views are headers from
+ * a fixed set, and a slot returns to the pool when its last view is released.
+ * The pool is held by the session and by each slot out of the pool,
+ * so the app may keep buffers after the session is destroyed. */
+
+static void freeBufPool(struct AccBufPool *pool)
+{
+	if (pool->region) munmap(pool->region, pool->regionLen);
+	accLfQueueDestroy(&pool->freeSlots);
+	accLfQueueDestroy(&pool->freeViews);
+	FREE(pool->slots);
+	FREE(pool->views);
+	FREE(pool);
+}
+
+static void releaseBufPool(struct AccBufPool *pool)
+{
+	if (__sync_sub_and_fetch(&pool->refs, 1) == 0) freeBufPool(pool);
+}
+
+static void releaseBufSlot(struct AccBufSlot *slot)
+{
+	struct AccBufPool *pool = slot->pool;
+	if (__sync_sub_and_fetch(&slot->refs, 1) > 0) return;
+	accLfQueuePush(&pool->freeSlots, slot);
+	releaseBufPool(pool);
+}
+
+/* Hugepages are mapped explicitly if the system has them, and requested from THP otherwise */
+static int mapBufPool(struct AccBufPool *pool)
+{
+	size_t len = (size_t)pool->stride * pool->count;
+
+	if (pool->options & USB_ACCESSORY_BUFFER_POOL_HUGEPAGES) {
+		pool->regionLen = (len + ACC_BUF_HUGEPAGE_SIZE - 1) & ~((size_t)ACC_BUF_HUGEPAGE_SIZE - 1);
+		pool->region = mmap(NULL, pool->regionLen, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (pool->region != MAP_FAILED) return 0;
+		USB_LOG("No hugepages are reserved (%d). Transparent hugepages are requested\n", errno);
+	} else {
+		pool->regionLen = len;
+	}
+	pool->region = mmap(NULL, pool->regionLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pool->region == MAP_FAILED) {
+		pool->region = NULL;
+		USB_LOG("FAIL: mmap(%zu) (%d)\n", pool->regionLen, errno);
+		return -1;
+	}
+	if (pool->options & USB_ACCESSORY_BUFFER_POOL_HUGEPAGES)
+		madvise(pool->region, pool->regionLen, MADV_HUGEPAGE);
+	return 0;
+}
+
+static void *bufPoolReceiver(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct usb_accessory_session_s *session = (struct usb_accessory_session_s *)data;
+	struct AccBufPool *pool = session->bufPool;
+	struct AccBufSlot *slot = NULL;
+	struct usb_accessory_buffer_s *view = NULL;
+	uint64_t units = 0;
+	unsigned int len;
+	int ret;
+
+	while (!pool->stopping) {
+		slot = (struct AccBufSlot *)accLfQueuePopWait(&pool->freeSlots, &pool->stopping);
+		if (!slot) break;
+		view = (struct usb_accessory_buffer_s *)accLfQueuePopWait(&pool->freeViews, &pool->stopping);
+		if (!view) {
+			accLfQueuePush(&pool->freeSlots, slot);
+			break;
+		}
+		if (session->framed) {
+			ret = accFrameReceive(session, slot->data, pool->size, &len);
+			if (ret != USB_ERROR_NONE) ret = -1;
+		} else {
+			ret = accSessionRead(session, slot->data, pool->size);
+			len = ret;
+		}
+		if (ret < 0 || (!session->framed && ret == 0)) {
+			accLfQueuePush(&pool->freeViews, view);
+			accLfQueuePush(&pool->freeSlots, slot);
+			break;
+		}
+		__sync_fetch_and_add(&pool->refs, 1);
+		slot->refs = 1;
+		view->slot = slot;
+		view->data = slot->data;
+		view->len = len;
+		view->refs = 1;
+		units++;
+		pool->callback(session, view, pool->userData);
+	}
+	USB_LOG("Buffer pool receiver stops after %llu units\n", (unsigned long long)units);
+	pool->callback(session, NULL, pool->userData);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+int accBufPoolStart(struct usb_accessory_session_s *session)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccBufPool *pool = NULL;
+	unsigned int viewCnt = session->poolCount * ACC_BUF_VIEWS_PER_BUFFER;
+	unsigned int i;
+	int ret;
+
+	/* A smaller buffer could not take every message, and the receiver would stop at the first one it cannot take */
+	if (session->framed && session->poolSize > 0 && session->poolSize < session->frameMax) {
+		USB_LOG("ERROR: The buffers (%u) are smaller than the messages (%u)\n", session->poolSize, session->frameMax);
+		return -1;
+	}
+	pool = (struct AccBufPool *)calloc(1, sizeof(struct AccBufPool));
+	um_retvm_if(pool == NULL, -1, "FAIL: calloc(AccBufPool)\n");
+	pool->count = session->poolCount;
+	pool->size = session->poolSize;
+	if (pool->size == 0) pool->size = session->framed ? session->frameMax : session->raSize;
+	pool->stride = (pool->size + ACC_BUF_ALIGN - 1) & ~(ACC_BUF_ALIGN - 1);
+	pool->options = session->poolOptions;
+	pool->callback = session->poolCb;
+	pool->userData = session->poolUserData;
+	pool->refs = 1;
+
+	pool->slots = (struct AccBufSlot *)calloc(pool->count, sizeof(struct AccBufSlot));
+	pool->views = (struct usb_accessory_buffer_s *)calloc(viewCnt, sizeof(struct usb_accessory_buffer_s));
+	if (!pool->slots || !pool->views || mapBufPool(pool) < 0
+			|| accLfQueueInit(&pool->freeSlots, pool->count) < 0
+			|| accLfQueueInit(&pool->freeViews, viewCnt) < 0) {
+		USB_LOG("FAIL: allocate buffer pool\n");
+		freeBufPool(pool);
+		return -1;
+	}
+	for (i = 0 ; i < pool->count ; i++) {
+		pool->slots[i].pool = pool;
+		pool->slots[i].data = pool->region + (size_t)i * pool->stride;
+		accLfQueuePush(&pool->freeSlots, &pool->slots[i]);
+	}
+	for (i = 0 ; i < viewCnt ; i++) {
+		pool->views[i].pool = pool;
+		accLfQueuePush(&pool->freeViews, &pool->views[i]);
+	}
+
+	session->bufPool = pool;
+	ret = pthread_create(&pool->receiver, NULL, bufPoolReceiver, session);
+	if (ret != 0) {
+		USB_LOG("FAIL: pthread_create(receiver) (%d)\n", ret);
+		session->bufPool = NULL;
+		freeBufPool(pool);
+		return -1;
+	}
+	pool->receiverRunning = true;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* The session must be stopping, so that the receiver does not wait for the accessory */
+void accBufPoolStop(struct usb_accessory_session_s *session)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccBufPool *pool = session->bufPool;
+
+	if (!pool) return;
+	pool->stopping = true;
+	__sync_synchronize();
+	accLfQueueWake(&pool->freeSlots, 1);
+	accLfQueueWake(&pool->freeViews, 1);
+	if (pool->receiverRunning) {
+		pthread_join(pool->receiver, NULL);
+		pool->receiverRunning = false;
+	}
+	session->bufPool = NULL;
+	releaseBufPool(pool);
+	__USB_FUNC_EXIT__ ;
+}
+
+int usb_accessory_session_set_buffer_pool(usb_accessory_session_h session, unsigned int count, unsigned int buffer_size,
+		unsigned int options, usb_accessory_receive_cb callback, void *user_data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (count > ACC_BUF_MAX_COUNT || buffer_size > ACC_BUF_MAX_SIZE) return USB_ERROR_INVALID_PARAMETER;
+	if (options & ~USB_ACCESSORY_BUFFER_POOL_HUGEPAGES) return USB_ERROR_INVALID_PARAMETER;
+	if (count > 0 && !callback) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started || (count > 0 && (session->pipeline || session->broadcast))) return USB_ERROR_INVALID_OPERATION;
+	session->poolCount = count;
+	session->poolSize = buffer_size;
+	session->poolOptions = options;
+	session->poolCb = callback;
+	session->poolUserData = user_data;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_buffer_get_data(usb_accessory_buffer_h buffer, const void **data, unsigned int *len)
+{
+	if (!buffer || !data || !len) return USB_ERROR_INVALID_PARAMETER;
+	*data = buffer->data;
+	*len = buffer->len;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_buffer_ref(usb_accessory_buffer_h buffer)
+{
+	if (!buffer) return USB_ERROR_INVALID_PARAMETER;
+	__sync_fetch_and_add(&buffer->refs, 1);
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_buffer_unref(usb_accessory_buffer_h buffer)
+{
+	if (!buffer) return USB_ERROR_INVALID_PARAMETER;
+	struct AccBufSlot *slot = buffer->slot;
+
+	if (__sync_sub_and_fetch(&buffer->refs, 1) > 0) return USB_ERROR_NONE;
+	/* The header goes back first, because releasing the slot may free the pool */
+	buffer->slot = NULL;
+	accLfQueuePush(&buffer->pool->freeViews, buffer);
+	releaseBufSlot(slot);
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_buffer_create_view(usb_accessory_buffer_h buffer, unsigned int offset, unsigned int len, usb_accessory_buffer_h *view)
+{
+	if (!buffer || !view) return USB_ERROR_INVALID_PARAMETER;
+	if (offset > buffer->len || len > buffer->len - offset) return USB_ERROR_INVALID_PARAMETER;
+	struct usb_accessory_buffer_s *newView = NULL;
+
+	newView = (struct usb_accessory_buffer_s *)accLfQueuePop(&buffer->pool->freeViews);
+	if (!newView) return USB_ERROR_RESOURCE_BUSY;
+	__sync_fetch_and_add(&buffer->slot->refs, 1);
+	newView->slot = buffer->slot;
+	newView->data = buffer->data + offset;
+	newView->len = len;
+	newView->refs = 1;
+	*view = newView;
+	return USB_ERROR_NONE;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Adaptive busy polling of the data channel.
+ * A read which expects data, because a write waits for its reply or data came
+ * within the window before, polls the channel for up to the window
+ * and then waits in read() as usual. The window follows twice the average wait
+ * of the reads which found data, and it is halved when nothing came.
+ * Every ACC_BUSY_POLL_PROBE_INTERVAL-th such read does not poll,
+ * so that the cost of waking up from read() is measured on the same traffic. */
+
+static inline uint64_t pollNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void pollRelax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause");
+#elif defined(__arm__) || defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static void pollAdapt(struct AccBusyPoll *poll, bool hit, uint64_t waited)
+{
+	uint64_t window;
+
+	if (hit) {
+		poll->avgWaitNs += ((int64_t)waited - (int64_t)poll->avgWaitNs) / 8;
+		window = poll->avgWaitNs * 2;
+	} else {
+		window = poll->windowNs / 2;
+	}
+	if (window < ACC_BUSY_POLL_MIN_NS) window = ACC_BUSY_POLL_MIN_NS;
+	if (window > poll->maxNs) window = poll->maxNs;
+	poll->windowNs = window;
+}
+
+int accBusyPollRead(struct usb_accessory_session_s *session, void *buf, unsigned int len)
+{
+	struct AccBusyPoll *poll = &(session->poll);
+	uint64_t start = pollNow();
+	uint64_t deadline;
+	uint64_t now;
+	bool expected;
+	int ready = 0;
+	int ret;
+
+	expected = (session->stats.pendingNs != 0)
+			|| (poll->lastDataNs != 0 && start - poll->lastDataNs < poll->windowNs);
+	if (!expected) {
+		ret = accBackend()->read_channel(session->fd, buf, len);
+		if (ret > 0) poll->lastDataNs = pollNow();
+		return ret;
+	}
+
+	if (++poll->expected % ACC_BUSY_POLL_PROBE_INTERVAL == 0) {
+		ret = accBackend()->read_channel(session->fd, buf, len);
+		now = pollNow();
+		if (ret > 0) {
+			poll->lastDataNs = now;
+			__sync_fetch_and_add(&poll->probes, 1);
+			__sync_fetch_and_add(&poll->probeNs, now - start);
+		}
+		return ret;
+	}
+
+	deadline = start + poll->windowNs;
+	do {
+		ready = accBackend()->poll_channel(session->fd);
+		if (ready != 0) break;
+		pollRelax();
+		now = pollNow();
+	} while (now < deadline);
+	now = pollNow();
+	__sync_fetch_and_add(&poll->spinNs, now - start);
+
+	if (ready > 0) {
+		__sync_fetch_and_add(&poll->hits, 1);
+		pollAdapt(poll, true, now - start);
+	} else {
+		__sync_fetch_and_add(&poll->misses, 1);
+		pollAdapt(poll, false, 0);
+	}
+	ret = accBackend()->read_channel(session->fd, buf, len);
+	if (ret > 0) {
+		now = pollNow();
+		poll->lastDataNs = now;
+		__sync_fetch_and_add(&poll->polledReads, 1);
+		__sync_fetch_and_add(&poll->polledNs, now - start);
+	}
+	return ret;
+}
+
+void accBusyPollReset(struct AccBusyPoll *poll)
+{
+	uint64_t maxNs = poll->maxNs;
+	memset(poll, 0, sizeof(struct AccBusyPoll));
+	poll->maxNs = maxNs;
+	poll->windowNs = maxNs;
+	poll->avgWaitNs = maxNs / 2;
+}
+
+int usb_accessory_session_set_busy_poll(usb_accessory_session_h session, unsigned int max_window_us)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (max_window_us > ACC_BUSY_POLL_MAX_US) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	session->poll.maxNs = (uint64_t)max_window_us * 1000;
+	if (session->poll.maxNs > 0 && session->poll.maxNs < ACC_BUSY_POLL_MIN_NS)
+		session->poll.maxNs = ACC_BUSY_POLL_MIN_NS;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_get_busy_poll_stats(usb_accessory_session_h session, usb_accessory_session_poll_stats_s *stats)
+{
+	if (!session || !stats) return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || session->poll.maxNs == 0) return USB_ERROR_INVALID_OPERATION;
+	struct AccBusyPoll *poll = &(session->poll);
+	uint64_t polledReads = poll->polledReads;
+	uint64_t polledNs = poll->polledNs;
+	uint64_t probes = poll->probes;
+	uint64_t probeNs = poll->probeNs;
+
+	memset(stats, 0, sizeof(usb_accessory_session_poll_stats_s));
+	stats->window_us = poll->windowNs / 1000;
+	stats->hits = poll->hits;
+	stats->misses = poll->misses;
+	stats->spin_us = poll->spinNs / 1000;
+	stats->probes = probes;
+	if (polledReads > 0) stats->polled_mean_us = polledNs / polledReads / 1000;
+	if (probes > 0) stats->probe_mean_us = probeNs / probes / 1000;
+	if (polledReads > 0 && probes > 0 && probeNs / probes > polledNs / polledReads)
+		stats->saved_us = (probeNs / probes - polledNs / polledReads) * polledReads / 1000;
+	return USB_ERROR_NONE;
+}
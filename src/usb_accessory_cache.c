@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+#include <sys/file.h>
+
+/* Cache file of an app with the accessories seen recently and the last permission verdicts.
+ * The processes of the app share the file. Writers hold flock() and make seq odd
+ * while they update it, and readers retry when seq was odd or changed, as with the state segment.
+ * A writer which died in the middle leaves seq odd, and the next open repairs the file. */
+
+static struct {
+	pthread_mutex_t	lock;
+	struct AccCacheFile *file;
+	int		fd;
+} accCache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.file = NULL,
+	.fd = -1,
+};
+static pthread_once_t defaultOnce = PTHREAD_ONCE_INIT;
+
+static bool isCacheEntryValid(struct AccCacheEntry *entry)
+{
+	unsigned short offset[ACC_INFO_NUM];
+	unsigned short len[ACC_INFO_NUM];
+
+	if (entry->seenTime == 0) return true;
+	if (entry->rawLen >= SOCK_STR_LEN) return false;
+	if (entry->permission > USB_ACCESSORY_PERMISSION_DENIED) return false;
+	indexRawInfo(entry->raw, entry->rawLen, offset, len);
+	return getAccFingerprint(entry->raw, offset, len) == entry->fingerprint;
+}
+
+/* Called with flock() held */
+static void initCacheFile(struct AccCacheFile *file, bool repair)
+{
+	unsigned int i;
+
+	if (repair) {
+		USB_LOG("Repair the cache file (seq: %u)\n", file->seq);
+		for (i = 0 ; i < ACC_CACHE_MAX_ENTRIES ; i++) {
+			if (!isCacheEntryValid(&(file->entries[i])))
+				memset(&(file->entries[i]), 0, sizeof(struct AccCacheEntry));
+		}
+		file->seq++;
+		return;
+	}
+	memset(file, 0, sizeof(struct AccCacheFile));
+	file->version = ACC_CACHE_VERSION;
+	file->entryCnt = ACC_CACHE_MAX_ENTRIES;
+	__sync_synchronize();
+	file->magic = ACC_CACHE_MAGIC;
+}
+
+static int openCache(const char *path, struct AccCacheFile **file)
+{
+	__USB_FUNC_ENTER__ ;
+	struct stat st;
+	void *addr;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	um_retvm_if(fd < 0, -1, "FAIL: open(%s) (%d)\n", path, errno);
+	if (flock(fd, LOCK_EX) < 0 || fstat(fd, &st) < 0) {
+		USB_LOG("FAIL: flock(%s) (%d)\n", path, errno);
+		close(fd);
+		return -1;
+	}
+	if (st.st_size != sizeof(struct AccCacheFile) && ftruncate(fd, sizeof(struct AccCacheFile)) < 0) {
+		USB_LOG("FAIL: ftruncate(%s) (%d)\n", path, errno);
+		close(fd);
+		return -1;
+	}
+	addr = mmap(NULL, sizeof(struct AccCacheFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		USB_LOG("FAIL: mmap(%s) (%d)\n", path, errno);
+		close(fd);
+		return -1;
+	}
+	*file = (struct AccCacheFile *)addr;
+	if ((*file)->magic != ACC_CACHE_MAGIC || (*file)->version != ACC_CACHE_VERSION
+			|| (*file)->entryCnt != ACC_CACHE_MAX_ENTRIES)
+		initCacheFile(*file, false);
+	else if ((*file)->seq & 1)
+		initCacheFile(*file, true);
+	flock(fd, LOCK_UN);
+	USB_LOG("Cache file: %s\n", path);
+	__USB_FUNC_EXIT__ ;
+	return fd;
+}
+
+/* Called with the cache lock held */
+static void closeCache(void)
+{
+	if (!accCache.file) return;
+	munmap(accCache.file, sizeof(struct AccCacheFile));
+	close(accCache.fd);
+	accCache.file = NULL;
+	accCache.fd = -1;
+}
+
+static void openDefaultCache(void)
+{
+	const char *path = getenv(ACC_CACHE_ENV);
+	struct AccCacheFile *file = NULL;
+	int fd;
+
+	if (!path || !*path) return;
+	fd = openCache(path, &file);
+	if (fd < 0) return;
+	pthread_mutex_lock(&accCache.lock);
+	accCache.file = file;
+	accCache.fd = fd;
+	pthread_mutex_unlock(&accCache.lock);
+}
+
+/* Copy the entries of the cache. It returns -1 if there is no cache */
+static int readCache(struct AccCacheEntry entries[])
+{
+	struct AccCacheFile *file = NULL;
+	uint32_t seq;
+	int retry;
+
+	pthread_once(&defaultOnce, openDefaultCache);
+	pthread_mutex_lock(&accCache.lock);
+	file = accCache.file;
+	if (!file) {
+		pthread_mutex_unlock(&accCache.lock);
+		return -1;
+	}
+	for (retry = 0 ; retry < ACC_CACHE_READ_RETRY ; retry++) {
+		seq = file->seq;
+		__sync_synchronize();
+		if (seq & 1) continue;
+		memcpy(entries, file->entries, sizeof(file->entries));
+		__sync_synchronize();
+		if (file->seq == seq) break;
+	}
+	if (retry == ACC_CACHE_READ_RETRY) {
+		/* A writer is busy for long. Wait for it */
+		flock(accCache.fd, LOCK_SH);
+		memcpy(entries, file->entries, sizeof(file->entries));
+		flock(accCache.fd, LOCK_UN);
+	}
+	pthread_mutex_unlock(&accCache.lock);
+	return 0;
+}
+
+/* It returns NULL with the cache lock released if there is no cache */
+static struct AccCacheFile *beginCacheWrite(void)
+{
+	pthread_once(&defaultOnce, openDefaultCache);
+	pthread_mutex_lock(&accCache.lock);
+	if (!accCache.file) {
+		pthread_mutex_unlock(&accCache.lock);
+		return NULL;
+	}
+	flock(accCache.fd, LOCK_EX);
+	accCache.file->seq++;
+	__sync_synchronize();
+	return accCache.file;
+}
+
+static void endCacheWrite(struct AccCacheFile *file)
+{
+	__sync_synchronize();
+	file->seq++;
+	flock(accCache.fd, LOCK_UN);
+	pthread_mutex_unlock(&accCache.lock);
+}
+
+/* The entry of the accessory, or the entry to be replaced which is empty or the oldest */
+static struct AccCacheEntry *findCacheEntry(struct AccCacheFile *file, uint64_t fingerprint, bool *found)
+{
+	struct AccCacheEntry *victim = NULL;
+	unsigned int i;
+
+	*found = false;
+	for (i = 0 ; i < ACC_CACHE_MAX_ENTRIES ; i++) {
+		struct AccCacheEntry *entry = &(file->entries[i]);
+		if (entry->seenTime != 0 && entry->fingerprint == fingerprint) {
+			*found = true;
+			return entry;
+		}
+		if (!victim || entry->seenTime < victim->seenTime) victim = entry;
+	}
+	return victim;
+}
+
+static struct AccCacheEntry *getCacheEntry(struct AccCacheFile *file, struct usb_accessory_s *accessory)
+{
+	struct AccCacheEntry *entry = NULL;
+	bool found;
+
+	entry = findCacheEntry(file, accessory->fingerprint, &found);
+	if (!found) {
+		memset(entry, 0, sizeof(struct AccCacheEntry));
+		entry->fingerprint = accessory->fingerprint;
+		entry->permission = USB_ACCESSORY_PERMISSION_UNKNOWN;
+	}
+	memcpy(entry->raw, accessory->raw, accessory->rawLen + 1);
+	entry->rawLen = accessory->rawLen;
+	entry->seenTime = time(NULL);
+	return entry;
+}
+
+/* Record the accessories attached now. The others are marked detached */
+void accCacheRecordList(struct usb_accessory_list *accList)
+{
+	struct AccCacheFile *file = beginCacheWrite();
+	struct usb_accessory_s *accessory = NULL;
+	unsigned int i;
+
+	if (!file) return;
+	for (i = 0 ; i < ACC_CACHE_MAX_ENTRIES ; i++)
+		file->entries[i].attached = 0;
+	for ( ; accList ; accList = accList->next) {
+		accessory = acc_handle_get(accList->accessory);
+		if (accessory) getCacheEntry(file, accessory)->attached = 1;
+	}
+	endCacheWrite(file);
+}
+
+void accCacheRecordPermission(struct usb_accessory_s *accessory, bool granted)
+{
+	struct AccCacheFile *file = NULL;
+	struct AccCacheEntry *entry = NULL;
+
+	if (!accessory) return;
+	file = beginCacheWrite();
+	if (!file) return;
+	entry = getCacheEntry(file, accessory);
+	entry->permission = granted ? USB_ACCESSORY_PERMISSION_GRANTED : USB_ACCESSORY_PERMISSION_DENIED;
+	entry->permTime = entry->seenTime;
+	endCacheWrite(file);
+}
+
+/* Make a handle from the information kept in the cache.
+ * The cached verdict does not allow the accessory to be opened */
+static usb_accessory_h makeCachedAcc(struct AccCacheEntry *entry)
+{
+	usb_accessory_h handle = acc_handle_alloc();
+	struct usb_accessory_s *accessory = acc_handle_get(handle);
+
+	um_retvm_if(accessory == NULL, NULL, "FAIL: acc_handle_alloc()\n");
+	setAccRaw(accessory, entry->raw);
+	indexAccRaw(accessory);
+	accessory->fingerprint = entry->fingerprint;
+	accessory->accPermission = false;
+	return handle;
+}
+
+static usb_accessory_permission_e getCachedPermission(struct AccCacheEntry *entry, time_t now)
+{
+	if (now - entry->permTime > ACC_CACHE_MAX_AGE_SEC) return USB_ACCESSORY_PERMISSION_UNKNOWN;
+	return (usb_accessory_permission_e)entry->permission;
+}
+
+static void runCacheTask(struct AccDispatchTask *task)
+{
+	struct AccCacheTask *cacheTask = (struct AccCacheTask *)task;
+	cacheTask->func(cacheTask->accessory, cacheTask->attached, cacheTask->permission, cacheTask->userData);
+	acc_handle_free(cacheTask->accessory);
+	FREE(cacheTask);
+}
+
+/* Call the change callback of the app. The accessory is freed after the callback */
+static void dispatchCacheEvent(struct AccCacheConfirm *confirm, usb_accessory_h accessory,
+		bool attached, usb_accessory_permission_e permission)
+{
+	struct AccCacheTask *task = NULL;
+
+	USB_LOG("Cache is not right (attached: %d, permission: %d)\n", attached, permission);
+	task = (struct AccCacheTask *)calloc(1, sizeof(struct AccCacheTask));
+	if (!task) {
+		USB_LOG("FAIL: calloc(AccCacheTask)\n");
+		confirm->func(accessory, attached, permission, confirm->userData);
+		acc_handle_free(accessory);
+		return;
+	}
+	task->task.run = runCacheTask;
+	task->func = confirm->func;
+	task->userData = confirm->userData;
+	task->accessory = accessory;
+	task->attached = attached;
+	task->permission = permission;
+	accDispatch(ACC_DISPATCH_CACHE, &task->task);
+}
+
+/* Ask usb-server, and report what differs from the provisional answer.
+ * getAccList() and getAccPermission() update the cache */
+static void *confirmCache(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccCacheConfirm *confirm = (struct AccCacheConfirm *)data;
+	struct usb_accessory_list *accList = NULL;
+	struct usb_accessory_list *node = NULL;
+	struct usb_accessory_s *accessory = NULL;
+	usb_accessory_permission_e permission;
+	bool matched[ACC_CACHE_MAX_ENTRIES] = { false, };
+	bool granted;
+	unsigned int i;
+
+	if (!getAccList(&accList, NULL)) {
+		USB_LOG("FAIL: getAccList(&accList). The cache is not confirmed\n");
+		FREE(confirm);
+		return NULL;
+	}
+	for (node = accList ; node ; node = node->next) {
+		accessory = acc_handle_get(node->accessory);
+		if (!accessory) continue;
+		permission = USB_ACCESSORY_PERMISSION_UNKNOWN;
+		if (getAccPermission(accessory, &granted) == 0)
+			permission = granted ? USB_ACCESSORY_PERMISSION_GRANTED : USB_ACCESSORY_PERMISSION_DENIED;
+
+		for (i = 0 ; i < confirm->cnt ; i++) {
+			if (confirm->entries[i].fingerprint == accessory->fingerprint) break;
+		}
+		if (i < confirm->cnt) {
+			matched[i] = true;
+			if (permission == USB_ACCESSORY_PERMISSION_UNKNOWN || permission == confirm->permissions[i])
+				continue;
+		}
+		if (!confirm->func) continue;
+		/* Take the handle from the list instead of copying it */
+		dispatchCacheEvent(confirm, node->accessory, true, permission);
+		node->accessory = NULL;
+	}
+	freeAccList(accList);
+
+	for (i = 0 ; i < confirm->cnt && confirm->func ; i++) {
+		usb_accessory_h handle = NULL;
+		if (matched[i]) continue;
+		handle = makeCachedAcc(&(confirm->entries[i]));
+		if (handle) dispatchCacheEvent(confirm, handle, false, confirm->permissions[i]);
+	}
+	FREE(confirm);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+int usb_accessory_set_cache(const char *path)
+{
+	__USB_FUNC_ENTER__ ;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	struct AccCacheFile *file = NULL;
+	int fd = -1;
+
+	/* The environment must not replace the cache set here */
+	pthread_once(&defaultOnce, openDefaultCache);
+	if (path) {
+		fd = openCache(path, &file);
+		um_retvm_if(fd < 0, USB_ERROR_OPERATION_FAILED, "FAIL: openCache(%s)\n", path);
+	}
+	pthread_mutex_lock(&accCache.lock);
+	closeCache();
+	accCache.file = file;
+	accCache.fd = fd;
+	pthread_mutex_unlock(&accCache.lock);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_foreach_cached(usb_accessory_cached_cb callback, usb_accessory_cache_changed_cb changed_cb, void *user_data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (callback == NULL) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	struct AccCacheEntry entries[ACC_CACHE_MAX_ENTRIES];
+	struct AccCacheConfirm *confirm = NULL;
+	pthread_attr_t attr;
+	pthread_t thread;
+	time_t now = time(NULL);
+	unsigned int i;
+	bool more = true;
+	int ret;
+
+	confirm = (struct AccCacheConfirm *)calloc(1, sizeof(struct AccCacheConfirm));
+	um_retvm_if(confirm == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: calloc(AccCacheConfirm)\n");
+	confirm->func = changed_cb;
+	confirm->userData = user_data;
+
+	if (readCache(entries) == 0) {
+		for (i = 0 ; i < ACC_CACHE_MAX_ENTRIES ; i++) {
+			if (entries[i].seenTime == 0 || !entries[i].attached) continue;
+			if (now - entries[i].seenTime > ACC_CACHE_MAX_AGE_SEC) continue;
+			confirm->permissions[confirm->cnt] = getCachedPermission(&entries[i], now);
+			memcpy(&(confirm->entries[confirm->cnt]), &entries[i], sizeof(struct AccCacheEntry));
+			confirm->cnt++;
+		}
+	}
+
+	for (i = 0 ; i < confirm->cnt && more ; i++) {
+		usb_accessory_h handle = makeCachedAcc(&(confirm->entries[i]));
+		if (!handle) break;
+		more = callback(handle, confirm->permissions[i], user_data);
+		acc_handle_free(handle);
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread, &attr, confirmCache, confirm);
+	pthread_attr_destroy(&attr);
+	if (ret != 0) {
+		USB_LOG("FAIL: pthread_create(confirmCache) (%d)\n", ret);
+		FREE(confirm);
+		return USB_ERROR_OPERATION_FAILED;
+	}
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
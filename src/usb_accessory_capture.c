@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Traffic capture. Records are written to a ring in a mapped file
+ * (see usb_accessory_capture_private.h for the layout).
+ * Space is reserved with a compare-and-swap on head,
+ * so the reader and the writer of a session record without a lock or an allocation. */
+
+static pthread_once_t defaultOnce = PTHREAD_ONCE_INIT;
+static struct AccCapture *defaultCapture = NULL;
+
+static inline uint64_t captureNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline char *captureBlock(struct AccCapture *capture, uint64_t pos)
+{
+	struct AccCaptureHeader *hdr = capture->hdr;
+	return capture->blocks + ((pos / hdr->blockSize) % hdr->blockCnt) * (size_t)hdr->blockSize;
+}
+
+struct AccCapture *accCaptureOpen(const char *path, unsigned int size, unsigned int snapLen)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!path) return NULL;
+	struct AccCapture *capture = NULL;
+	struct AccCaptureHeader *hdr = NULL;
+	unsigned int blockCnt;
+	size_t mapLen;
+	void *addr;
+	int fd;
+	int ret;
+
+	blockCnt = (size + ACC_CAPTURE_BLOCK_SIZE - 1) / ACC_CAPTURE_BLOCK_SIZE;
+	if (blockCnt < 2) blockCnt = 2;
+	if (snapLen > ACC_CAPTURE_MAX_SNAP) snapLen = ACC_CAPTURE_MAX_SNAP;
+	mapLen = sizeof(struct AccCaptureHeader) + (size_t)blockCnt * ACC_CAPTURE_BLOCK_SIZE;
+
+	capture = (struct AccCapture *)calloc(1, sizeof(struct AccCapture));
+	um_retvm_if(capture == NULL, NULL, "FAIL: calloc(AccCapture)\n");
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		USB_LOG("FAIL: open(%s) (%d)\n", path, errno);
+		FREE(capture);
+		return NULL;
+	}
+	/* Allocate the blocks now, so that a full disk does not fault the hot path */
+	ret = posix_fallocate(fd, 0, mapLen);
+	if (ret != 0) {
+		USB_LOG("FAIL: posix_fallocate(%s) (%d)\n", path, ret);
+		close(fd);
+		FREE(capture);
+		return NULL;
+	}
+	addr = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		USB_LOG("FAIL: mmap(%s) (%d)\n", path, errno);
+		FREE(capture);
+		return NULL;
+	}
+
+	hdr = (struct AccCaptureHeader *)addr;
+	hdr->version = ACC_CAPTURE_VERSION;
+	hdr->headerLen = sizeof(struct AccCaptureHeader);
+	hdr->blockSize = ACC_CAPTURE_BLOCK_SIZE;
+	hdr->blockCnt = blockCnt;
+	hdr->snapLen = snapLen;
+	hdr->head = 0;
+	hdr->startNs = captureNow();
+	__sync_synchronize();
+	hdr->magic = ACC_CAPTURE_MAGIC;
+
+	capture->hdr = hdr;
+	capture->blocks = (char *)addr + sizeof(struct AccCaptureHeader);
+	capture->mapLen = mapLen;
+	USB_LOG("Capture to %s (%u blocks, snap %u)\n", path, blockCnt, snapLen);
+	__USB_FUNC_EXIT__ ;
+	return capture;
+}
+
+void accCaptureClose(struct AccCapture *capture)
+{
+	if (!capture || capture == defaultCapture) return;
+	munmap(capture->hdr, capture->mapLen);
+	FREE(capture);
+}
+
+static void openDefaultCapture(void)
+{
+	const char *path = getenv(ACC_CAPTURE_ENV);
+	if (!path || !*path) return;
+	defaultCapture = accCaptureOpen(path, ACC_CAPTURE_DEFAULT_SIZE, ACC_CAPTURE_DEFAULT_SNAP);
+}
+
+/* The capture of all sessions set by the environment. It stays until the process exits */
+struct AccCapture *accCaptureDefault(void)
+{
+	pthread_once(&defaultOnce, openDefaultCapture);
+	return defaultCapture;
+}
+
+/* Reserve recLen bytes in a block. If the rest of the block is too small,
+ * it is closed and the record goes to the next block */
+static char *reserveCapture(struct AccCapture *capture, uint32_t recLen)
+{
+	struct AccCaptureHeader *hdr = capture->hdr;
+	uint64_t head;
+	uint64_t start;
+	uint32_t off;
+	char *block;
+
+	do {
+		head = hdr->head;
+		off = head % hdr->blockSize;
+		start = head;
+		if (off != 0 && off + recLen > hdr->blockSize)
+			start += hdr->blockSize - off;
+		if (start % hdr->blockSize == 0)
+			start += ACC_CAPTURE_BLOCK_HEADER_LEN;
+	} while (!__sync_bool_compare_and_swap(&hdr->head, head, start + recLen));
+
+	if (off != 0 && start != head)
+		*(uint32_t *)(captureBlock(capture, head) + off) = 0;
+	block = captureBlock(capture, start);
+	if (start % hdr->blockSize == ACC_CAPTURE_BLOCK_HEADER_LEN)
+		*(uint64_t *)block = start / hdr->blockSize;
+	return block + start % hdr->blockSize;
+}
+
+void accCaptureRecord(struct AccCapture *capture, unsigned int flags, const void *buf, int ret)
+{
+	struct AccCaptureRecord *rec = NULL;
+	uint32_t capLen = 0;
+	uint32_t recLen;
+	int err = errno;
+
+	if (ret > 0) {
+		capLen = ((uint32_t)ret < capture->hdr->snapLen) ? (uint32_t)ret : capture->hdr->snapLen;
+	} else if (ret < 0) {
+		flags |= ACC_CAPTURE_ERROR;
+	}
+	recLen = (sizeof(struct AccCaptureRecord) + capLen + ACC_CAPTURE_ALIGN - 1) & ~(ACC_CAPTURE_ALIGN - 1);
+
+	rec = (struct AccCaptureRecord *)reserveCapture(capture, recLen);
+	rec->recLen = 0;
+	rec->flags = flags;
+	rec->reserved = 0;
+	rec->timeNs = captureNow();
+	rec->len = (ret < 0) ? err : ret;
+	rec->capLen = capLen;
+	if (capLen > 0) memcpy(rec + 1, buf, capLen);
+	/* The record is complete when the decoder sees its length */
+	__sync_synchronize();
+	rec->recLen = recLen;
+	errno = err;
+}
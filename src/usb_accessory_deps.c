@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+#include <dlfcn.h>
+
+/* AUL, glib and lz4 are not linked to the library.
+ * They are loaded when they are used for the first time,
+ * so that apps which only check the connection status do not pay for them.
+ * If a library cannot be loaded, the functions in the table fail. */
+
+static pthread_once_t aulOnce = PTHREAD_ONCE_INIT;
+static pthread_once_t glibOnce = PTHREAD_ONCE_INIT;
+static pthread_once_t lz4Once = PTHREAD_ONCE_INIT;
+static struct AccAulOps aulOps;
+static struct AccGlibOps glibOps;
+static struct AccLz4Ops lz4Ops;
+
+static int fail_app_get_appid_bypid(int pid, char *appid, int len)
+{
+	return -1;
+}
+
+static GIOChannel *fail_io_channel_unix_new(int fd)
+{
+	return NULL;
+}
+
+static gint fail_io_channel_unix_get_fd(GIOChannel *channel)
+{
+	return -1;
+}
+
+static guint fail_io_add_watch(GIOChannel *channel, GIOCondition condition, GIOFunc func, gpointer user_data)
+{
+	return 0;
+}
+
+static GIOStatus fail_io_channel_shutdown(GIOChannel *channel, gboolean flush, GError **err)
+{
+	return G_IO_STATUS_ERROR;
+}
+
+static void fail_io_channel_unref(GIOChannel *channel)
+{
+}
+
+static guint fail_timeout_add(guint interval, GSourceFunc function, gpointer data)
+{
+	return 0;
+}
+
+static guint fail_idle_add(GSourceFunc function, gpointer data)
+{
+	return 0;
+}
+
+static gboolean fail_source_remove(guint tag)
+{
+	return FALSE;
+}
+
+static GSource *fail_idle_source_new(void)
+{
+	return NULL;
+}
+
+static void fail_source_set_callback(GSource *source, GSourceFunc func, gpointer data, GDestroyNotify notify)
+{
+}
+
+static guint fail_source_attach(GSource *source, GMainContext *context)
+{
+	return 0;
+}
+
+static void fail_source_destroy(GSource *source)
+{
+}
+
+static void fail_source_unref(GSource *source)
+{
+}
+
+static GMainContext *fail_main_context_ref(GMainContext *context)
+{
+	return context;
+}
+
+static void fail_main_context_unref(GMainContext *context)
+{
+}
+
+static int fail_compress_bound(int inputSize)
+{
+	return 0;
+}
+
+static int fail_compress_default(const char *src, char *dst, int srcSize, int dstCapacity)
+{
+	return 0;
+}
+
+static int fail_decompress_safe(const char *src, char *dst, int compressedSize, int dstCapacity)
+{
+	return -1;
+}
+
+/* Open a library. If the app has loaded it already, that one is used */
+static void *openDep(const char *name)
+{
+	void *lib = dlopen(name, RTLD_LAZY | RTLD_NOLOAD);
+	if (lib) return lib;
+	lib = dlopen(name, RTLD_LAZY);
+	if (!lib) USB_LOG_ERROR("FAIL: dlopen(%s): %s\n", name, dlerror());
+	return lib;
+}
+
+#define LOAD_DEP_SYM(lib, ops, field, sym, fallback) \
+	do { \
+		void *addr = (lib) ? dlsym((lib), (sym)) : NULL; \
+		if (addr) { \
+			*(void **)(&((ops).field)) = addr; \
+		} else { \
+			if (lib) USB_LOG_ERROR("FAIL: dlsym(%s)\n", (sym)); \
+			(ops).field = (fallback); \
+		} \
+	} while (0);
+
+static void loadAul(void)
+{
+	__USB_FUNC_ENTER__ ;
+	void *lib = openDep(ACC_AUL_LIB);
+	LOAD_DEP_SYM(lib, aulOps, app_get_appid_bypid, "aul_app_get_appid_bypid", fail_app_get_appid_bypid);
+	__USB_FUNC_EXIT__ ;
+}
+
+static void loadGlib(void)
+{
+	__USB_FUNC_ENTER__ ;
+	void *lib = openDep(ACC_GLIB_LIB);
+	LOAD_DEP_SYM(lib, glibOps, io_channel_unix_new, "g_io_channel_unix_new", fail_io_channel_unix_new);
+	LOAD_DEP_SYM(lib, glibOps, io_channel_unix_get_fd, "g_io_channel_unix_get_fd", fail_io_channel_unix_get_fd);
+	LOAD_DEP_SYM(lib, glibOps, io_add_watch, "g_io_add_watch", fail_io_add_watch);
+	LOAD_DEP_SYM(lib, glibOps, io_channel_shutdown, "g_io_channel_shutdown", fail_io_channel_shutdown);
+	LOAD_DEP_SYM(lib, glibOps, io_channel_unref, "g_io_channel_unref", fail_io_channel_unref);
+	LOAD_DEP_SYM(lib, glibOps, timeout_add, "g_timeout_add", fail_timeout_add);
+	LOAD_DEP_SYM(lib, glibOps, idle_add, "g_idle_add", fail_idle_add);
+	LOAD_DEP_SYM(lib, glibOps, source_remove, "g_source_remove", fail_source_remove);
+	LOAD_DEP_SYM(lib, glibOps, idle_source_new, "g_idle_source_new", fail_idle_source_new);
+	LOAD_DEP_SYM(lib, glibOps, source_set_callback, "g_source_set_callback", fail_source_set_callback);
+	LOAD_DEP_SYM(lib, glibOps, source_attach, "g_source_attach", fail_source_attach);
+	LOAD_DEP_SYM(lib, glibOps, source_destroy, "g_source_destroy", fail_source_destroy);
+	LOAD_DEP_SYM(lib, glibOps, source_unref, "g_source_unref", fail_source_unref);
+	LOAD_DEP_SYM(lib, glibOps, main_context_ref, "g_main_context_ref", fail_main_context_ref);
+	LOAD_DEP_SYM(lib, glibOps, main_context_unref, "g_main_context_unref", fail_main_context_unref);
+	__USB_FUNC_EXIT__ ;
+}
+
+static void loadLz4(void)
+{
+	__USB_FUNC_ENTER__ ;
+	void *lib = openDep(ACC_LZ4_LIB);
+	LOAD_DEP_SYM(lib, lz4Ops, compress_bound, "LZ4_compressBound", fail_compress_bound);
+	LOAD_DEP_SYM(lib, lz4Ops, compress_default, "LZ4_compress_default", fail_compress_default);
+	LOAD_DEP_SYM(lib, lz4Ops, decompress_safe, "LZ4_decompress_safe", fail_decompress_safe);
+	/* Compression is used only if all of them are there */
+	if (lz4Ops.compress_default == fail_compress_default || lz4Ops.decompress_safe == fail_decompress_safe)
+		lz4Ops.compress_bound = fail_compress_bound;
+	__USB_FUNC_EXIT__ ;
+}
+
+const struct AccAulOps *accAul(void)
+{
+	pthread_once(&aulOnce, loadAul);
+	return &aulOps;
+}
+
+const struct AccGlibOps *accGlib(void)
+{
+	pthread_once(&glibOnce, loadGlib);
+	return &glibOps;
+}
+
+const struct AccLz4Ops *accLz4(void)
+{
+	pthread_once(&lz4Once, loadLz4);
+	return &lz4Ops;
+}
+
+/* Whether or not the binary runs on the emulator does not change,
+ * so uname() is called only once */
+static pthread_once_t emulOnce = PTHREAD_ONCE_INIT;
+static bool isEmul = true;
+
+static void checkEmul(void)
+{
+	__USB_FUNC_ENTER__ ;
+	struct utsname name;
+	if (uname(&name) < 0) {
+		isEmul = true;
+	} else {
+		USB_LOG("Machine name: %s", name.machine);
+		isEmul = (strcasestr(name.machine, "emul") != NULL);
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+bool is_emul_bin()
+{
+	pthread_once(&emulOnce, checkEmul);
+	return isEmul;
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Callback dispatch. Each subscriber has a queue of tasks.
+ * A queue is scheduled when a task is added to the empty queue,
+ * and it stays scheduled until it is empty again, so only one task of a queue runs at a time.
+ * A scheduled queue waits in the ready list of the worker pool,
+ * or has an idle source in the main context.
+ * When the mode changes, the scheduled queues are handed over to the new target. */
+
+static struct {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	usb_accessory_dispatch_e mode;
+	GMainContext	*context;
+	pthread_t	workers[ACC_DISPATCH_MAX_WORKERS];
+	unsigned int	workerCnt;
+	bool		stopping;
+	struct AccDispatchQueue queues[ACC_DISPATCH_SUBSCRIBERS];
+	struct AccDispatchQueue *readyHead;
+	struct AccDispatchQueue *readyTail;
+} dispatcher = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.mode = USB_ACCESSORY_DISPATCH_INLINE,
+};
+
+/* Mode changes are made one at a time. The dispatcher lock cannot be held
+ * while the workers are joined, because they take it to run their tasks */
+static pthread_mutex_t switchLock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool requeueQueue(struct AccDispatchQueue *queue);
+static void drainQueue(struct AccDispatchQueue *queue);
+
+/* Called with the dispatcher lock held */
+static struct AccDispatchTask *popTask(struct AccDispatchQueue *queue)
+{
+	struct AccDispatchTask *task = queue->head;
+	if (!task) return NULL;
+	queue->head = task->next;
+	if (!queue->head) queue->tail = NULL;
+	task->next = NULL;
+	return task;
+}
+
+static void pushReady(struct AccDispatchQueue *queue)
+{
+	queue->nextReady = NULL;
+	if (dispatcher.readyTail) dispatcher.readyTail->nextReady = queue;
+	else dispatcher.readyHead = queue;
+	dispatcher.readyTail = queue;
+	pthread_cond_signal(&dispatcher.cond);
+}
+
+static void *dispatchWorker(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccDispatchQueue *queue = NULL;
+	struct AccDispatchTask *task = NULL;
+
+	pthread_mutex_lock(&dispatcher.lock);
+	while (1) {
+		queue = dispatcher.readyHead;
+		if (!queue) {
+			if (dispatcher.stopping) break;
+			pthread_cond_wait(&dispatcher.cond, &dispatcher.lock);
+			continue;
+		}
+		dispatcher.readyHead = queue->nextReady;
+		if (!dispatcher.readyHead) dispatcher.readyTail = NULL;
+		task = popTask(queue);
+		pthread_mutex_unlock(&dispatcher.lock);
+
+		if (task) task->run(task);
+
+		pthread_mutex_lock(&dispatcher.lock);
+		/* The next task of the queue runs after this one, maybe in another worker */
+		if (queue->head) pushReady(queue);
+		else queue->scheduled = false;
+	}
+	pthread_mutex_unlock(&dispatcher.lock);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+/* Called with the dispatcher lock held */
+static void releaseIdle(struct AccDispatchQueue *queue)
+{
+	if (!queue->idle) return;
+	accGlib()->source_unref(queue->idle);
+	queue->idle = NULL;
+}
+
+/* Run one task in each iteration of the main context until the queue is empty */
+static gboolean dispatchIdleCb(gpointer data)
+{
+	struct AccDispatchQueue *queue = (struct AccDispatchQueue *)data;
+	struct AccDispatchTask *task = NULL;
+	bool more;
+	bool drain;
+
+	pthread_mutex_lock(&dispatcher.lock);
+	/* Detached by a mode change, which has handed the queue over */
+	if (!queue->idle) {
+		pthread_mutex_unlock(&dispatcher.lock);
+		return FALSE;
+	}
+	task = popTask(queue);
+	if (!task) {
+		queue->scheduled = false;
+		releaseIdle(queue);
+		pthread_mutex_unlock(&dispatcher.lock);
+		return FALSE;
+	}
+	queue->running = true;
+	pthread_mutex_unlock(&dispatcher.lock);
+
+	task->run(task);
+
+	pthread_mutex_lock(&dispatcher.lock);
+	queue->running = false;
+	/* The mode changed while the task ran. The rest goes to the new target from here */
+	if (!queue->idle) {
+		drain = requeueQueue(queue);
+		pthread_mutex_unlock(&dispatcher.lock);
+		if (drain) drainQueue(queue);
+		return FALSE;
+	}
+	more = (queue->head != NULL);
+	if (!more) {
+		queue->scheduled = false;
+		releaseIdle(queue);
+	}
+	pthread_mutex_unlock(&dispatcher.lock);
+	return more ? TRUE : FALSE;
+}
+
+/* Called with the dispatcher lock held. It returns -1 if the queue cannot be scheduled */
+static int scheduleQueue(struct AccDispatchQueue *queue)
+{
+	GSource *source = NULL;
+
+	if (dispatcher.mode == USB_ACCESSORY_DISPATCH_WORKER_POOL) {
+		pushReady(queue);
+		return 0;
+	}
+	source = accGlib()->idle_source_new();
+	um_retvm_if(source == NULL, -1, "FAIL: g_idle_source_new()\n");
+	accGlib()->source_set_callback(source, dispatchIdleCb, queue, NULL);
+	/* The reference is kept, so that a mode change can destroy the source */
+	queue->idle = source;
+	if (accGlib()->source_attach(source, dispatcher.context) == 0) {
+		USB_LOG("FAIL: g_source_attach()\n");
+		releaseIdle(queue);
+		return -1;
+	}
+	return 0;
+}
+
+/* Hand a queue left by the old target over to the current one.
+ * Called with the dispatcher lock held. It returns true if the caller must run the tasks */
+static bool requeueQueue(struct AccDispatchQueue *queue)
+{
+	if (!queue->scheduled || queue->running) return false;
+	if (!queue->head) {
+		queue->scheduled = false;
+		return false;
+	}
+	if (dispatcher.mode == USB_ACCESSORY_DISPATCH_INLINE) return true;
+	return (scheduleQueue(queue) < 0);
+}
+
+/* Run the tasks of a scheduled queue in the calling thread until it is empty */
+static void drainQueue(struct AccDispatchQueue *queue)
+{
+	struct AccDispatchTask *task = NULL;
+
+	while (1) {
+		pthread_mutex_lock(&dispatcher.lock);
+		task = popTask(queue);
+		if (!task) queue->scheduled = false;
+		pthread_mutex_unlock(&dispatcher.lock);
+		if (!task) break;
+		task->run(task);
+	}
+}
+
+/* Destroy the idle sources in the old main context. Called with the dispatcher lock held */
+static void detachIdleSources(void)
+{
+	unsigned int i;
+	for (i = 0 ; i < ACC_DISPATCH_SUBSCRIBERS ; i++) {
+		struct AccDispatchQueue *queue = &(dispatcher.queues[i]);
+		if (!queue->idle) continue;
+		accGlib()->source_destroy(queue->idle);
+		releaseIdle(queue);
+	}
+}
+
+void accDispatch(ACC_DISPATCH_SUBSCRIBER subscriber, struct AccDispatchTask *task)
+{
+	if (!task) return;
+	if (subscriber < 0 || subscriber >= ACC_DISPATCH_SUBSCRIBERS) return;
+	struct AccDispatchQueue *queue = &(dispatcher.queues[subscriber]);
+
+	pthread_mutex_lock(&dispatcher.lock);
+	/* Tasks queued before the mode became inline run first */
+	if (dispatcher.mode == USB_ACCESSORY_DISPATCH_INLINE && !queue->scheduled) {
+		pthread_mutex_unlock(&dispatcher.lock);
+		task->run(task);
+		return;
+	}
+
+	task->next = NULL;
+	if (queue->tail) queue->tail->next = task;
+	else queue->head = task;
+	queue->tail = task;
+
+	if (!queue->scheduled) {
+		if (scheduleQueue(queue) < 0) {
+			/* Nothing else is queued, so the task is the only one */
+			popTask(queue);
+			pthread_mutex_unlock(&dispatcher.lock);
+			task->run(task);
+			return;
+		}
+		queue->scheduled = true;
+	}
+	pthread_mutex_unlock(&dispatcher.lock);
+}
+
+/* Let the workers run all queued tasks and exit */
+static void stopWorkers(void)
+{
+	unsigned int i;
+	unsigned int workerCnt;
+
+	pthread_mutex_lock(&dispatcher.lock);
+	dispatcher.stopping = true;
+	pthread_cond_broadcast(&dispatcher.cond);
+	workerCnt = dispatcher.workerCnt;
+	pthread_mutex_unlock(&dispatcher.lock);
+
+	for (i = 0 ; i < workerCnt ; i++)
+		pthread_join(dispatcher.workers[i], NULL);
+
+	pthread_mutex_lock(&dispatcher.lock);
+	dispatcher.workerCnt = 0;
+	dispatcher.stopping = false;
+	pthread_mutex_unlock(&dispatcher.lock);
+}
+
+/* Whether a task runs in the thread which posts it */
+bool accDispatchInline(void)
+{
+	bool isInline;
+	pthread_mutex_lock(&dispatcher.lock);
+	isInline = (dispatcher.mode == USB_ACCESSORY_DISPATCH_INLINE);
+	pthread_mutex_unlock(&dispatcher.lock);
+	return isInline;
+}
+
+int accDispatchSetMode(usb_accessory_dispatch_e mode, void *context, unsigned int workers)
+{
+	__USB_FUNC_ENTER__ ;
+	bool drain[ACC_DISPATCH_SUBSCRIBERS];
+	unsigned int workerCnt;
+	unsigned int i;
+	int result = USB_ERROR_NONE;
+	int ret;
+
+	pthread_mutex_lock(&switchLock);
+	pthread_mutex_lock(&dispatcher.lock);
+	for (i = 0 ; i < dispatcher.workerCnt ; i++) {
+		if (pthread_equal(dispatcher.workers[i], pthread_self())) {
+			pthread_mutex_unlock(&dispatcher.lock);
+			pthread_mutex_unlock(&switchLock);
+			USB_LOG("ERROR: The dispatch mode cannot be changed by a worker\n");
+			return USB_ERROR_INVALID_OPERATION;
+		}
+	}
+	/* Nothing is scheduled on the old target from here */
+	dispatcher.mode = USB_ACCESSORY_DISPATCH_INLINE;
+	detachIdleSources();
+	workerCnt = dispatcher.workerCnt;
+	pthread_mutex_unlock(&dispatcher.lock);
+
+	if (workerCnt > 0) stopWorkers();
+
+	pthread_mutex_lock(&dispatcher.lock);
+	if (dispatcher.context) {
+		accGlib()->main_context_unref(dispatcher.context);
+		dispatcher.context = NULL;
+	}
+
+	switch (mode) {
+	case USB_ACCESSORY_DISPATCH_INLINE:
+		break;
+	case USB_ACCESSORY_DISPATCH_MAIN_CONTEXT:
+		if (context) dispatcher.context = accGlib()->main_context_ref((GMainContext *)context);
+		dispatcher.mode = mode;
+		break;
+	case USB_ACCESSORY_DISPATCH_WORKER_POOL:
+		for (i = 0 ; i < workers ; i++) {
+			ret = pthread_create(&dispatcher.workers[i], NULL, dispatchWorker, NULL);
+			if (ret != 0) {
+				USB_LOG("FAIL: pthread_create(dispatch worker) (%d)\n", ret);
+				break;
+			}
+			dispatcher.workerCnt++;
+		}
+		if (dispatcher.workerCnt == 0) {
+			result = USB_ERROR_OPERATION_FAILED;
+			break;
+		}
+		dispatcher.mode = mode;
+		break;
+	default:
+		break;
+	}
+
+	/* The tasks queued for the old target keep their order on the new one */
+	for (i = 0 ; i < ACC_DISPATCH_SUBSCRIBERS ; i++)
+		drain[i] = requeueQueue(&(dispatcher.queues[i]));
+	pthread_mutex_unlock(&dispatcher.lock);
+	pthread_mutex_unlock(&switchLock);
+
+	for (i = 0 ; i < ACC_DISPATCH_SUBSCRIBERS ; i++) {
+		if (drain[i]) drainQueue(&(dispatcher.queues[i]));
+	}
+	__USB_FUNC_EXIT__ ;
+	return result;
+}
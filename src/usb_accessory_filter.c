@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Rules for different fields must all match.
+ * Among the rules for the same field, one of them must match. */
+
+static unsigned int hashAccField(const char *str, unsigned int len)
+{
+	unsigned int hash = 2166136261U;
+	unsigned int i;
+	for (i = 0 ; i < len ; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/* '*' matches any string and '?' matches any character */
+static bool matchAccGlob(const char *pattern, unsigned int patLen, const char *str, unsigned int len)
+{
+	unsigned int p = 0;
+	unsigned int s = 0;
+	int starP = -1;
+	unsigned int starS = 0;
+
+	while (s < len) {
+		if (p < patLen && (pattern[p] == '?' || pattern[p] == str[s])) {
+			p++;
+			s++;
+		} else if (p < patLen && pattern[p] == '*') {
+			starP = p++;
+			starS = s;
+		} else if (starP >= 0) {
+			p = starP + 1;
+			s = ++starS;
+		} else {
+			return false;
+		}
+	}
+	while (p < patLen && pattern[p] == '*') p++;
+	return p == patLen;
+}
+
+int accFilterCreate(struct usb_accessory_filter_s **filter)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!filter) return -1;
+	*filter = (struct usb_accessory_filter_s *)calloc(1, sizeof(struct usb_accessory_filter_s));
+	um_retvm_if(*filter == NULL, -1, "FAIL: calloc(usb_accessory_filter_s)\n");
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+void accFilterDestroy(struct usb_accessory_filter_s *filter)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!filter) return;
+	FREE(filter->rules);
+	FREE(filter);
+	__USB_FUNC_EXIT__ ;
+}
+
+int accFilterAddRule(struct usb_accessory_filter_s *filter, ACCESSORY_INFO field, int match, const char *pattern)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!filter || !pattern) return -1;
+	if (field < 0 || field >= ACC_INFO_NUM) return -1;
+	struct AccFilterRule *rules = NULL;
+	struct AccFilterRule *rule = NULL;
+	unsigned int len = strlen(pattern);
+	um_retvm_if(len >= ACC_ELEMENT_LEN, -1, "ERROR: The pattern is too long (%u)\n", len);
+
+	rules = (struct AccFilterRule *)realloc(filter->rules, (filter->ruleCnt + 1) * sizeof(struct AccFilterRule));
+	um_retvm_if(rules == NULL, -1, "FAIL: realloc(filter->rules)\n");
+	filter->rules = rules;
+
+	rule = &(filter->rules[filter->ruleCnt]);
+	rule->field = field;
+	rule->match = match;
+	rule->len = len;
+	rule->hash = hashAccField(pattern, len);
+	memcpy(rule->pattern, pattern, len + 1);
+	filter->ruleCnt++;
+	filter->fieldMask |= (1 << field);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+int accFilterCopy(struct usb_accessory_filter_s *src, struct usb_accessory_filter_s **dst)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!src || !dst) return -1;
+	int ret = accFilterCreate(dst);
+	um_retvm_if(ret < 0, -1, "FAIL: accFilterCreate(dst)\n");
+	if (src->ruleCnt > 0) {
+		(*dst)->rules = (struct AccFilterRule *)malloc(src->ruleCnt * sizeof(struct AccFilterRule));
+		if (!(*dst)->rules) {
+			USB_LOG("FAIL: malloc(rules)\n");
+			accFilterDestroy(*dst);
+			*dst = NULL;
+			return -1;
+		}
+		memcpy((*dst)->rules, src->rules, src->ruleCnt * sizeof(struct AccFilterRule));
+	}
+	(*dst)->ruleCnt = src->ruleCnt;
+	(*dst)->fieldMask = src->fieldMask;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* Match the fields found by indexAccRaw() or indexRawInfo() against the filter */
+bool accFilterMatchFields(struct usb_accessory_filter_s *filter, const char *raw,
+		const unsigned short offset[], const unsigned short len[])
+{
+	if (!filter || filter->ruleCnt == 0) return true;
+	unsigned int matched = 0;
+	unsigned int hashed = 0;
+	unsigned int hash[ACC_INFO_NUM];
+	int i;
+
+	for (i = 0 ; i < filter->ruleCnt ; i++) {
+		struct AccFilterRule *rule = &(filter->rules[i]);
+		const char *str = raw + offset[rule->field];
+		unsigned int strLen = len[rule->field];
+		bool ret = false;
+
+		if (matched & (1 << rule->field)) continue;
+
+		switch (rule->match) {
+		case USB_ACCESSORY_MATCH_EXACT:
+			if (strLen != rule->len) break;
+			if (!(hashed & (1 << rule->field))) {
+				hash[rule->field] = hashAccField(str, strLen);
+				hashed |= (1 << rule->field);
+			}
+			ret = (hash[rule->field] == rule->hash) && !memcmp(str, rule->pattern, strLen);
+			break;
+		case USB_ACCESSORY_MATCH_PREFIX:
+			ret = (strLen >= rule->len) && !memcmp(str, rule->pattern, rule->len);
+			break;
+		case USB_ACCESSORY_MATCH_GLOB:
+			ret = matchAccGlob(rule->pattern, rule->len, str, strLen);
+			break;
+		default:
+			break;
+		}
+		if (ret) matched |= (1 << rule->field);
+	}
+	return matched == filter->fieldMask;
+}
+
+/* Match the information of an accessory before any handle is made for it */
+bool accFilterMatchRaw(struct usb_accessory_filter_s *filter, const char *raw)
+{
+	if (!filter || filter->ruleCnt == 0) return true;
+	unsigned short offset[ACC_INFO_NUM];
+	unsigned short len[ACC_INFO_NUM];
+	indexRawInfo(raw, strnlen(raw, SOCK_STR_LEN), offset, len);
+	return accFilterMatchFields(filter, raw, offset, len);
+}
+
+bool accFilterMatch(struct usb_accessory_filter_s *filter, struct usb_accessory_s *accessory)
+{
+	if (!filter || filter->ruleCnt == 0) return true;
+	if (!accessory) return false;
+	indexAccRaw(accessory);
+	return accFilterMatchFields(filter, accessory->raw, accessory->fieldOffset, accessory->fieldLen);
+}
@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Framed sessions. Both sides start with a hello:
+ *   magic(4) version(2) options(2) max message size(4) reserved(4)
+ * and then exchange frames:
+ *   length on the wire(4) message length(3) flags(1) payload
+ * All numbers are little endian. A compressed payload is one LZ4 block,
+ * and it is sent only when it is smaller than the message.
+ * A bulk message may be sent as slices, each a frame with the slice flag,
+ * the first with the first flag and all but the last with the more flag.
+ * The receiver puts them together, and whole messages may come between them.
+ * A first slice drops what is left of a message the sender gave up on.
+ * Control messages take the channel before the next slice of bulk ones. */
+
+static inline uint64_t frameNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void putLe16(unsigned char *p, uint16_t val)
+{
+	p[0] = val & 0xFF;
+	p[1] = (val >> 8) & 0xFF;
+}
+
+static void putLe32(unsigned char *p, uint32_t val)
+{
+	p[0] = val & 0xFF;
+	p[1] = (val >> 8) & 0xFF;
+	p[2] = (val >> 16) & 0xFF;
+	p[3] = (val >> 24) & 0xFF;
+}
+
+static uint16_t getLe16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t getLe32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static unsigned int frameBoundOf(unsigned int options, unsigned int len)
+{
+	if (options & USB_ACCESSORY_FRAME_LZ4) return accLz4()->compress_bound(len);
+	return len;
+}
+
+/* Wait until a read would not wait. It returns -1 if the deadline passes first */
+static int frameWaitReadable(struct usb_accessory_session_s *session, uint64_t deadline)
+{
+	int ready;
+
+	for (;;) {
+		if (session->raDepth > 0) {
+			pthread_mutex_lock(&session->lock);
+			ready = (session->raFilled > 0 || session->eof || session->readError);
+			pthread_mutex_unlock(&session->lock);
+		} else {
+			ready = accBackend()->poll_channel(session->fd);
+		}
+		/* An error is reported by the read */
+		if (ready != 0) return 0;
+		if (frameNow() >= deadline) return -1;
+		usleep(ACC_FRAME_HELLO_POLL_US);
+	}
+}
+
+/* Read the hello of the peer, which must come within ACC_FRAME_HELLO_TIMEOUT_MS */
+static int frameReadHello(struct usb_accessory_session_s *session, unsigned char *hello)
+{
+	uint64_t deadline = frameNow() + (uint64_t)ACC_FRAME_HELLO_TIMEOUT_MS * 1000000ULL;
+	unsigned int done = 0;
+	int ret;
+
+	while (done < ACC_FRAME_HELLO_LEN) {
+		if (frameWaitReadable(session, deadline) < 0) {
+			USB_LOG("ERROR: No hello in %d ms\n", ACC_FRAME_HELLO_TIMEOUT_MS);
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		ret = accSessionRead(session, (char *)hello + done, ACC_FRAME_HELLO_LEN - done);
+		if (ret <= 0) return -1;
+		done += ret;
+	}
+	return done;
+}
+
+/* Lower frameMax until a frame of it fits in the send queue. It returns -1 if not even the hello fits */
+static int capBufferedFrame(struct usb_accessory_session_s *session, unsigned int options)
+{
+	unsigned int room;
+	unsigned int bound;
+	unsigned int max = session->frameMax;
+
+	if (session->sendLimit < ACC_FRAME_HELLO_LEN || session->sendLimit <= ACC_FRAME_HEADER_LEN) return -1;
+	room = session->sendLimit - ACC_FRAME_HEADER_LEN;
+	if (max > room) max = room;
+	/* The bound grows with the length, so each step gets closer */
+	while (max > 0 && (bound = frameBoundOf(options, max)) > room)
+		max = (bound - room < max) ? max - (bound - room) : 0;
+	if (max == 0) return -1;
+	if (max < session->frameMax) {
+		USB_LOG("Message size is capped to %u by the send queue\n", max);
+		session->frameMax = max;
+	}
+	return 0;
+}
+
+/* Exchange the hello and prepare the frame buffers */
+int accFrameStart(struct usb_accessory_session_s *session)
+{
+	__USB_FUNC_ENTER__ ;
+	unsigned char hello[ACC_FRAME_HELLO_LEN];
+	unsigned int options = session->frameOptions;
+	unsigned int peerOptions;
+	unsigned int peerMax;
+	int ret;
+
+	if ((options & USB_ACCESSORY_FRAME_LZ4) && accLz4()->compress_bound(1) <= 0) {
+		USB_LOG("LZ4 is not available\n");
+		options &= ~USB_ACCESSORY_FRAME_LZ4;
+	}
+
+	/* A buffered frame is queued whole, so the largest one must fit in the send queue.
+	 * The peer is offered no more than that */
+	if (session->sendHigh > 0) {
+		ret = capBufferedFrame(session, options);
+		um_retvm_if(ret < 0, -1, "ERROR: The send queue of %u bytes is too small for framing\n", session->sendLimit);
+	}
+
+	/* Slices are always accepted */
+	options |= ACC_FRAME_OPT_SLICES;
+	memset(hello, 0, sizeof(hello));
+	putLe32(hello, ACC_FRAME_MAGIC);
+	putLe16(hello + 4, ACC_FRAME_VERSION);
+	putLe16(hello + 6, options);
+	putLe32(hello + 8, session->frameMax);
+	ret = accSessionWriteAll(session, (const char *)hello, sizeof(hello));
+	um_retvm_if(ret != sizeof(hello), -1, "FAIL: send hello (%d)\n", errno);
+
+	ret = frameReadHello(session, hello);
+	um_retvm_if(ret != sizeof(hello), -1, "FAIL: receive hello (%d)\n", errno);
+	um_retvm_if(getLe32(hello) != ACC_FRAME_MAGIC, -1, "ERROR: The peer does not support framing\n");
+	peerOptions = getLe16(hello + 6);
+	peerMax = getLe32(hello + 8);
+	um_retvm_if(peerMax == 0, -1, "ERROR: The peer does not accept messages\n");
+	USB_LOG("Peer framing version: %d, options: 0x%x, max: %u\n", getLe16(hello + 4), peerOptions, peerMax);
+
+	session->frameOptions = options & peerOptions;
+	if (peerMax < session->frameMax) session->frameMax = peerMax;
+	/* A buffered message is queued whole or not at all, so it is not sliced */
+	session->frameSlice = 0;
+	if ((session->frameOptions & ACC_FRAME_OPT_SLICES) && session->sendHigh == 0)
+		session->frameSlice = session->sliceSize;
+	memset(session->sendClass, 0, sizeof(session->sendClass));
+	session->asmLen = 0;
+	session->asmReady = false;
+	session->frameBound = session->frameMax;
+	if (session->frameOptions & USB_ACCESSORY_FRAME_LZ4) {
+		session->frameBound = accLz4()->compress_bound(session->frameMax);
+		session->frameRecvBuf = (char *)malloc(session->frameBound);
+		um_retvm_if(session->frameRecvBuf == NULL, -1, "FAIL: malloc(frameRecvBuf)\n");
+	}
+	session->frameSendBuf = (char *)malloc(ACC_FRAME_HEADER_LEN + session->frameBound);
+	if (!session->frameSendBuf) {
+		USB_LOG("FAIL: malloc(frameSendBuf)\n");
+		FREE(session->frameRecvBuf);
+		return -1;
+	}
+	session->framed = true;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+void accFrameFree(struct usb_accessory_session_s *session)
+{
+	FREE(session->frameSendBuf);
+	FREE(session->frameRecvBuf);
+	FREE(session->asmBuf);
+	session->framed = false;
+}
+
+int usb_accessory_session_set_framing(usb_accessory_session_h session, unsigned int options, unsigned int max_message_size)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (options & ~USB_ACCESSORY_FRAME_LZ4) return USB_ERROR_INVALID_PARAMETER;
+	if (max_message_size > ACC_FRAME_MAX_SIZE) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	session->frameOptions = options;
+	session->frameMax = (max_message_size > 0) ? max_message_size : ACC_FRAME_DEFAULT_SIZE;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_get_framing(usb_accessory_session_h session, unsigned int *options, unsigned int *max_message_size)
+{
+	if (!session || !options || !max_message_size) return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || !session->framed) return USB_ERROR_INVALID_OPERATION;
+	*options = session->frameOptions & ~ACC_FRAME_OPT_SLICES;
+	*max_message_size = session->frameMax;
+	return USB_ERROR_NONE;
+}
+
+/* Send a message or a slice as one frame. The caller holds frameSendLock */
+static int frameSend(struct usb_accessory_session_s *session, const void *buf, unsigned int len, unsigned int flags)
+{
+	unsigned char *frame = (unsigned char *)session->frameSendBuf;
+	unsigned int wireLen = len;
+	int ret;
+
+	if ((session->frameOptions & USB_ACCESSORY_FRAME_LZ4) && len >= ACC_FRAME_COMPRESS_MIN) {
+		ret = accLz4()->compress_default((const char *)buf, (char *)frame + ACC_FRAME_HEADER_LEN,
+				len, session->frameBound);
+		if (ret > 0 && ret < len) {
+			wireLen = ret;
+			flags |= ACC_FRAME_FLAG_LZ4;
+		}
+	}
+	if (!(flags & ACC_FRAME_FLAG_LZ4) && len > 0)
+		memcpy(frame + ACC_FRAME_HEADER_LEN, buf, len);
+	putLe32(frame, wireLen);
+	putLe32(frame + 4, len | (flags << 24));
+	return accSessionWriteAll(session, (const char *)frame, ACC_FRAME_HEADER_LEN + wireLen);
+}
+
+int usb_accessory_session_send_message(usb_accessory_session_h session, const void *buf, unsigned int len)
+{
+	return usb_accessory_session_send_message_class(session, buf, len, USB_ACCESSORY_SEND_BULK);
+}
+
+int usb_accessory_session_send_message_class(usb_accessory_session_h session, const void *buf, unsigned int len,
+		usb_accessory_send_class_e send_class)
+{
+	if (!session || (!buf && len > 0)) return USB_ERROR_INVALID_PARAMETER;
+	if (send_class != USB_ACCESSORY_SEND_CONTROL && send_class != USB_ACCESSORY_SEND_BULK)
+		return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || !session->framed) return USB_ERROR_INVALID_OPERATION;
+	if (len > session->frameMax) return USB_ERROR_INVALID_PARAMETER;
+	struct AccSendClass *sc = &(session->sendClass[send_class]);
+	bool bulk = (send_class == USB_ACCESSORY_SEND_BULK);
+	uint64_t start = frameNow();
+	uint64_t wait = 0;
+	unsigned int slices = 0;
+	unsigned int done = 0;
+	unsigned int part;
+	unsigned int flags;
+	int ret;
+
+	if (!accSessionEnter(session)) return USB_ERROR_INVALID_OPERATION;
+	pthread_mutex_lock(&session->schedLock);
+	sc->queued++;
+	if (sc->queued > sc->maxQueued) sc->maxQueued = sc->queued;
+	if (bulk) session->bulkPending++;
+	pthread_mutex_unlock(&session->schedLock);
+
+	/* Bulk messages go one at a time, so that their slices are not mixed */
+	if (bulk) pthread_mutex_lock(&session->frameBulkLock);
+	do {
+		part = len - done;
+		flags = 0;
+		if (bulk && session->frameSlice > 0 && len > session->frameSlice) {
+			flags = ACC_FRAME_FLAG_SLICE;
+			if (done == 0) flags |= ACC_FRAME_FLAG_FIRST;
+			if (part > session->frameSlice) {
+				part = session->frameSlice;
+				flags |= ACC_FRAME_FLAG_MORE;
+			}
+		}
+		/* Control messages go first, but a bulk slice waits for no more than a burst of them.
+		 * The ones let through are on the wire before the slice */
+		pthread_mutex_lock(&session->schedLock);
+		if (bulk) {
+			while (session->controlInFlight > 0 || (session->sendClass[USB_ACCESSORY_SEND_CONTROL].queued > 0
+					&& session->controlRun < ACC_SEND_CONTROL_BURST))
+				pthread_cond_wait(&session->schedCond, &session->schedLock);
+		} else {
+			while (session->bulkPending > 0 && session->controlRun >= ACC_SEND_CONTROL_BURST)
+				pthread_cond_wait(&session->schedCond, &session->schedLock);
+			if (session->controlRun < ACC_SEND_CONTROL_BURST) session->controlRun++;
+			session->controlInFlight++;
+		}
+		pthread_mutex_unlock(&session->schedLock);
+
+		pthread_mutex_lock(&session->frameSendLock);
+		if (done == 0) wait = frameNow() - start;
+		ret = frameSend(session, (const char *)buf + done, part, flags);
+		pthread_mutex_lock(&session->schedLock);
+		/* Counted before the next frame goes, so that the count follows the wire.
+		 * The control messages let through during a slice follow it */
+		if (bulk) session->controlRun = session->controlInFlight;
+		else session->controlInFlight--;
+		if (bulk || session->controlInFlight == 0) pthread_cond_broadcast(&session->schedCond);
+		pthread_mutex_unlock(&session->schedLock);
+		pthread_mutex_unlock(&session->frameSendLock);
+		if (ret <= 0) break;
+		slices++;
+		done += part;
+	} while (done < len);
+	if (bulk) pthread_mutex_unlock(&session->frameBulkLock);
+
+	pthread_mutex_lock(&session->schedLock);
+	sc->queued--;
+	sc->slices += slices;
+	if (ret > 0) {
+		sc->waitSumNs += wait;
+		if (wait > sc->waitMaxNs) sc->waitMaxNs = wait;
+		sc->messages++;
+		sc->bytes += len;
+	}
+	if (bulk) session->bulkPending--;
+	if (bulk || sc->queued == 0 || session->controlRun >= ACC_SEND_CONTROL_BURST)
+		pthread_cond_broadcast(&session->schedCond);
+	pthread_mutex_unlock(&session->schedLock);
+	accSessionLeave(session);
+
+	if (ret < 0) {
+		USB_LOG("FAIL: send message (%d)\n", errno);
+		return USB_ERROR_OPERATION_FAILED;
+	}
+	if (ret == 0) return USB_ERROR_RESOURCE_BUSY;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_set_send_slice(usb_accessory_session_h session, unsigned int slice_size)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (slice_size > ACC_FRAME_MAX_SIZE) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	session->sliceSize = slice_size;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_get_send_class_stats(usb_accessory_session_h session, usb_accessory_send_class_e send_class,
+		usb_accessory_send_class_stats_s *stats)
+{
+	if (!session || !stats) return USB_ERROR_INVALID_PARAMETER;
+	if (send_class != USB_ACCESSORY_SEND_CONTROL && send_class != USB_ACCESSORY_SEND_BULK)
+		return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || !session->framed) return USB_ERROR_INVALID_OPERATION;
+	struct AccSendClass *sc = &(session->sendClass[send_class]);
+	uint64_t sent;
+
+	pthread_mutex_lock(&session->schedLock);
+	memset(stats, 0, sizeof(usb_accessory_send_class_stats_s));
+	stats->messages = sc->messages;
+	stats->bytes = sc->bytes;
+	stats->slices = sc->slices;
+	stats->queued = sc->queued;
+	stats->max_queued = sc->maxQueued;
+	sent = sc->messages;
+	if (sent > 0) stats->mean_wait_us = sc->waitSumNs / sent / 1000;
+	stats->max_wait_us = sc->waitMaxNs / 1000;
+	pthread_mutex_unlock(&session->schedLock);
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_receive_message(usb_accessory_session_h session, void *buf, unsigned int size, unsigned int *len)
+{
+	if (!session || !len || (!buf && size > 0)) return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || !session->framed) return USB_ERROR_INVALID_OPERATION;
+	if (session->pipeline || session->poolCount > 0 || session->broadcast) return USB_ERROR_INVALID_OPERATION;
+	int ret;
+
+	if (!accSessionEnter(session)) return USB_ERROR_INVALID_OPERATION;
+	ret = accFrameReceive(session, buf, size, len);
+	accSessionLeave(session);
+	return ret;
+}
+
+/* Hand over the bulk message put together from slices */
+static int frameTakeAssembled(struct usb_accessory_session_s *session, void *buf, unsigned int size, unsigned int *len)
+{
+	*len = session->asmLen;
+	if (session->asmLen > size) return USB_ERROR_INVALID_PARAMETER;
+	memcpy(buf, session->asmBuf, session->asmLen);
+	session->asmLen = 0;
+	session->asmReady = false;
+	return USB_ERROR_NONE;
+}
+
+/* Drop the payload of a broken frame */
+static int frameSkip(struct usb_accessory_session_s *session, unsigned int len)
+{
+	char drop[ACC_FRAME_SKIP_CHUNK];
+	unsigned int part;
+
+	while (len > 0) {
+		part = (len > sizeof(drop)) ? sizeof(drop) : len;
+		if (accSessionReadAll(session, drop, part) != part) return -1;
+		len -= part;
+	}
+	return 0;
+}
+
+int accFrameReceive(struct usb_accessory_session_s *session, void *buf, unsigned int size, unsigned int *len)
+{
+	unsigned char header[ACC_FRAME_HEADER_LEN];
+	unsigned int msgLen;
+	unsigned int flags;
+	char *dest;
+	int ret;
+
+	pthread_mutex_lock(&session->frameRecvLock);
+	if (session->frameBroken) {
+		pthread_mutex_unlock(&session->frameRecvLock);
+		*len = 0;
+		return USB_ERROR_OPERATION_FAILED;
+	}
+	for (;;) {
+		if (session->asmReady) {
+			ret = frameTakeAssembled(session, buf, size, len);
+			pthread_mutex_unlock(&session->frameRecvLock);
+			return ret;
+		}
+		if (!session->frameHeld) {
+			ret = accSessionReadAll(session, (char *)header, sizeof(header));
+			if (ret != sizeof(header)) {
+				pthread_mutex_unlock(&session->frameRecvLock);
+				USB_LOG("FAIL: receive frame header (%d)\n", errno);
+				return USB_ERROR_OPERATION_FAILED;
+			}
+			session->heldLen = getLe32(header);
+			session->heldInfo = getLe32(header + 4);
+			session->frameHeld = true;
+		}
+		msgLen = session->heldInfo & ACC_FRAME_MAX_SIZE;
+		flags = session->heldInfo >> 24;
+		if ((flags & ACC_FRAME_FLAG_FIRST) && session->asmLen > 0) {
+			USB_LOG("ERROR: A message is not finished (%u bytes are dropped)\n", session->asmLen);
+			session->asmLen = 0;
+		}
+
+		if (msgLen > session->frameMax || session->heldLen > session->frameBound
+				|| (!(flags & ACC_FRAME_FLAG_LZ4) && session->heldLen != msgLen)
+				|| ((flags & ACC_FRAME_FLAG_LZ4) && !session->frameRecvBuf)
+				|| ((flags & ACC_FRAME_FLAG_SLICE) && session->asmLen + msgLen > session->frameMax)) {
+			USB_LOG("ERROR: The frame is broken (len: %u, info: 0x%x)\n", session->heldLen, session->heldInfo);
+			session->frameHeld = false;
+			session->asmLen = 0;
+			/* Without a length to trust, the next header cannot be found */
+			if (session->heldLen > session->frameBound || frameSkip(session, session->heldLen) < 0) {
+				USB_LOG("ERROR: The stream is out of sync, no more messages are received\n");
+				session->frameBroken = true;
+			}
+			pthread_mutex_unlock(&session->frameRecvLock);
+			*len = msgLen;
+			return USB_ERROR_OPERATION_FAILED;
+		}
+		if (!(flags & ACC_FRAME_FLAG_SLICE)) {
+			*len = msgLen;
+			if (msgLen > size) {
+				pthread_mutex_unlock(&session->frameRecvLock);
+				return USB_ERROR_INVALID_PARAMETER;
+			}
+			dest = (char *)buf;
+		} else {
+			if (!session->asmBuf) session->asmBuf = (char *)malloc(session->frameMax);
+			if (!session->asmBuf) {
+				pthread_mutex_unlock(&session->frameRecvLock);
+				USB_LOG("FAIL: malloc(asmBuf)\n");
+				*len = 0;
+				return USB_ERROR_OPERATION_FAILED;
+			}
+			dest = session->asmBuf + session->asmLen;
+		}
+
+		session->frameHeld = false;
+		if (flags & ACC_FRAME_FLAG_LZ4) {
+			ret = accSessionReadAll(session, session->frameRecvBuf, session->heldLen);
+			if (ret == session->heldLen)
+				ret = accLz4()->decompress_safe(session->frameRecvBuf, dest, session->heldLen, msgLen);
+		} else {
+			ret = accSessionReadAll(session, dest, msgLen);
+		}
+		if (ret != msgLen) {
+			if (flags & ACC_FRAME_FLAG_SLICE) session->asmLen = 0;
+			pthread_mutex_unlock(&session->frameRecvLock);
+			USB_LOG("FAIL: receive message (ret: %d, len: %u)\n", ret, msgLen);
+			*len = 0;
+			return USB_ERROR_OPERATION_FAILED;
+		}
+		if (!(flags & ACC_FRAME_FLAG_SLICE)) break;
+		session->asmLen += msgLen;
+		if (!(flags & ACC_FRAME_FLAG_MORE)) session->asmReady = true;
+	}
+	pthread_mutex_unlock(&session->frameRecvLock);
+	return USB_ERROR_NONE;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Accessory handles are not pointers.
+ * A handle is (generation << ACC_HANDLE_INDEX_BITS) | (slot index + 1),
+ * and the slot keeps the generation of the handle which owns it now.
+ * Destroying a handle bumps the generation of its slot,
+ * so a stale or double destroyed handle does not match any more.
+ * acc_handle_get() checks a handle without slabLock,
+ * so the generation and inUse of a slot are only changed behind a barrier. */
+
+struct AccSlot {
+	struct usb_accessory_s	accessory;
+	volatile unsigned int	generation;
+	volatile bool		inUse;
+	int			nextFree;
+};
+
+static struct AccSlot *slabChunks[ACC_SLAB_MAX_CHUNKS];
+static volatile int slabChunkCnt = 0;
+static int slabFreeHead = -1;
+static pthread_mutex_t slabLock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline struct AccSlot *getSlot(int index)
+{
+	return &(slabChunks[index / ACC_SLAB_CHUNK_SLOTS][index % ACC_SLAB_CHUNK_SLOTS]);
+}
+
+/* Add a chunk of free slots. slabLock must be held */
+static int addSlabChunk(void)
+{
+	__USB_FUNC_ENTER__ ;
+	int i;
+	int base;
+	struct AccSlot *chunk = NULL;
+
+	um_retvm_if(slabChunkCnt >= ACC_SLAB_MAX_CHUNKS, -1, "ERROR: Accessory slab is full\n");
+	chunk = (struct AccSlot *)calloc(ACC_SLAB_CHUNK_SLOTS, sizeof(struct AccSlot));
+	um_retvm_if(chunk == NULL, -1, "FAIL: calloc(ACC_SLAB_CHUNK_SLOTS)\n");
+
+	base = slabChunkCnt * ACC_SLAB_CHUNK_SLOTS;
+	for (i = 0 ; i < ACC_SLAB_CHUNK_SLOTS ; i++) {
+		chunk[i].generation = 1;
+		chunk[i].inUse = false;
+		chunk[i].nextFree = (i + 1 < ACC_SLAB_CHUNK_SLOTS) ? base + i + 1 : slabFreeHead;
+	}
+
+	slabChunks[slabChunkCnt] = chunk;
+	/* acc_handle_get() reads the chunk table without slabLock */
+	__sync_synchronize();
+	slabChunkCnt++;
+	slabFreeHead = base;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* Take a slot from the free list and return the handle of it */
+usb_accessory_h acc_handle_alloc(void)
+{
+	int index;
+	struct AccSlot *slot = NULL;
+	uintptr_t handle;
+
+	pthread_mutex_lock(&slabLock);
+	if (slabFreeHead < 0 && addSlabChunk() < 0) {
+		pthread_mutex_unlock(&slabLock);
+		return NULL;
+	}
+	index = slabFreeHead;
+	slot = getSlot(index);
+	slabFreeHead = slot->nextFree;
+	slot->nextFree = -1;
+	slot->accessory.accPermission = false;
+	slot->accessory.raw[0] = '\0';
+	slot->accessory.rawLen = 0;
+	slot->accessory.indexed = false;
+	slot->accessory.decoding = 0;
+	slot->accessory.decoded = 0;
+	slot->accessory.fingerprint = 0;
+	/* The accessory is reset before the slot is seen live */
+	__sync_synchronize();
+	slot->inUse = true;
+	handle = ((uintptr_t)slot->generation << ACC_HANDLE_INDEX_BITS) | (uintptr_t)(index + 1);
+	pthread_mutex_unlock(&slabLock);
+
+	return (usb_accessory_h)handle;
+}
+
+/* Return the accessory of a live handle, or NULL for a stale or invalid handle.
+ * The handle is live when it is checked. Destroying it at the same time is still the bug of the caller */
+struct usb_accessory_s *acc_handle_get(usb_accessory_h handle)
+{
+	uintptr_t value = (uintptr_t)handle;
+	int index = (int)(value & ACC_HANDLE_INDEX_MASK) - 1;
+	unsigned int generation = (unsigned int)(value >> ACC_HANDLE_INDEX_BITS) & ACC_HANDLE_GEN_MASK;
+	struct AccSlot *slot = NULL;
+	int chunkCnt = slabChunkCnt;
+
+	__sync_synchronize();
+	if (index < 0 || index >= chunkCnt * ACC_SLAB_CHUNK_SLOTS) return NULL;
+	slot = getSlot(index);
+	if (slot->generation != generation) return NULL;
+	__sync_synchronize();
+	if (!slot->inUse) return NULL;
+	/* A free and an alloc in between bump the generation, so check it again */
+	__sync_synchronize();
+	if (slot->generation != generation) return NULL;
+	return &(slot->accessory);
+}
+
+/* Give the slot of a handle back to the free list */
+int acc_handle_free(usb_accessory_h handle)
+{
+	uintptr_t value = (uintptr_t)handle;
+	int index = (int)(value & ACC_HANDLE_INDEX_MASK) - 1;
+	unsigned int generation = (unsigned int)(value >> ACC_HANDLE_INDEX_BITS) & ACC_HANDLE_GEN_MASK;
+	struct AccSlot *slot = NULL;
+
+	pthread_mutex_lock(&slabLock);
+	if (index < 0 || index >= slabChunkCnt * ACC_SLAB_CHUNK_SLOTS) {
+		pthread_mutex_unlock(&slabLock);
+		USB_LOG_ERROR("ERROR: Invalid accessory handle %p\n", handle);
+		return -1;
+	}
+	slot = getSlot(index);
+	if (!slot->inUse || slot->generation != generation) {
+		pthread_mutex_unlock(&slabLock);
+		USB_LOG_ERROR("ERROR: Stale accessory handle %p\n", handle);
+		return -1;
+	}
+	slot->inUse = false;
+	__sync_synchronize();
+	slot->generation = (slot->generation + 1) & ACC_HANDLE_GEN_MASK;
+	slot->nextFree = slabFreeHead;
+	slabFreeHead = index;
+	pthread_mutex_unlock(&slabLock);
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Bounded lock-free queue for many producers and many consumers.
+ * Each cell has a sequence number which says whether it is ready
+ * to be filled (seq == pos) or to be taken (seq == pos + 1) at the position pos.
+ * A consumer which finds the queue empty spins for a while
+ * and then sleeps on a semaphore which producers post only when someone sleeps. */
+
+int accLfQueueInit(struct AccLfQueue *queue, unsigned int size)
+{
+	__USB_FUNC_ENTER__ ;
+	unsigned int cap = 2;
+	unsigned int i;
+
+	while (cap < size) cap <<= 1;
+	queue->cells = (struct AccLfCell *)calloc(cap, sizeof(struct AccLfCell));
+	um_retvm_if(queue->cells == NULL, -1, "FAIL: calloc(AccLfCell)\n");
+	for (i = 0 ; i < cap ; i++) queue->cells[i].seq = i;
+	queue->mask = cap - 1;
+	queue->enqPos = 0;
+	queue->deqPos = 0;
+	queue->waiters = 0;
+	if (sem_init(&queue->sem, 0, 0) < 0) {
+		USB_LOG("FAIL: sem_init() (%d)\n", errno);
+		FREE(queue->cells);
+		return -1;
+	}
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+void accLfQueueDestroy(struct AccLfQueue *queue)
+{
+	if (!queue->cells) return;
+	sem_destroy(&queue->sem);
+	FREE(queue->cells);
+}
+
+/* It returns -1 if the queue is full */
+int accLfQueuePush(struct AccLfQueue *queue, void *data)
+{
+	struct AccLfCell *cell = NULL;
+	uint32_t pos = queue->enqPos;
+	int32_t dif;
+
+	while (1) {
+		cell = &(queue->cells[pos & queue->mask]);
+		dif = (int32_t)(cell->seq - pos);
+		if (dif == 0) {
+			if (__sync_bool_compare_and_swap(&queue->enqPos, pos, pos + 1)) break;
+		} else if (dif < 0) {
+			return -1;
+		}
+		pos = queue->enqPos;
+	}
+	cell->data = data;
+	__sync_synchronize();
+	cell->seq = pos + 1;
+
+	if (__sync_fetch_and_add(&queue->waiters, 0) > 0) sem_post(&queue->sem);
+	return 0;
+}
+
+/* It returns NULL if the queue is empty */
+void *accLfQueuePop(struct AccLfQueue *queue)
+{
+	struct AccLfCell *cell = NULL;
+	uint32_t pos = queue->deqPos;
+	int32_t dif;
+	void *data;
+
+	while (1) {
+		cell = &(queue->cells[pos & queue->mask]);
+		dif = (int32_t)(cell->seq - (pos + 1));
+		if (dif == 0) {
+			if (__sync_bool_compare_and_swap(&queue->deqPos, pos, pos + 1)) break;
+		} else if (dif < 0) {
+			return NULL;
+		}
+		pos = queue->deqPos;
+	}
+	data = cell->data;
+	__sync_synchronize();
+	cell->seq = pos + queue->mask + 1;
+	return data;
+}
+
+/* Wait until there is data or *stop is set. It returns NULL if stopped */
+void *accLfQueuePopWait(struct AccLfQueue *queue, volatile bool *stop)
+{
+	void *data;
+	int spin;
+
+	while (!*stop) {
+		for (spin = 0 ; spin < ACC_LFQ_SPIN ; spin++) {
+			data = accLfQueuePop(queue);
+			if (data) return data;
+		}
+		__sync_fetch_and_add(&queue->waiters, 1);
+		/* Checked again after announcing the wait, so that a push in between is not missed */
+		data = accLfQueuePop(queue);
+		if (data || *stop) {
+			__sync_fetch_and_sub(&queue->waiters, 1);
+			if (data) return data;
+			break;
+		}
+		while (sem_wait(&queue->sem) < 0 && errno == EINTR);
+		__sync_fetch_and_sub(&queue->waiters, 1);
+	}
+	return NULL;
+}
+
+/* Wake the consumers sleeping in accLfQueuePopWait(), e.g. to let them see the stop flag */
+void accLfQueueWake(struct AccLfQueue *queue, unsigned int count)
+{
+	unsigned int i;
+	for (i = 0 ; i < count ; i++) sem_post(&queue->sem);
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Decode pipeline of a session:
+ *   reader --workQ--> workers --window--> deliverer --freeQ--> reader
+ * The reader numbers the units it reads. A worker puts the decoded slot
+ * in the reorder window at seq % slotCnt, which is free because
+ * no more than slotCnt slots are in flight, and the deliverer takes them in order. */
+
+static void wakeDeliverer(struct AccPipeline *pipe)
+{
+	if (__sync_fetch_and_add(&pipe->deliverWaiters, 0) > 0) sem_post(&pipe->deliverSem);
+}
+
+static void *pipelineReader(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct usb_accessory_session_s *session = (struct usb_accessory_session_s *)data;
+	struct AccPipeline *pipe = session->pipeline;
+	struct AccPipeSlot *slot = NULL;
+	unsigned int len;
+	uint64_t seq = 0;
+	int ret;
+
+	while (!pipe->stopping) {
+		slot = (struct AccPipeSlot *)accLfQueuePopWait(&pipe->freeQ, &pipe->stopping);
+		if (!slot) break;
+		if (session->framed) {
+			ret = accFrameReceive(session, slot->in, pipe->inSize, &len);
+			if (ret != USB_ERROR_NONE) break;
+		} else {
+			ret = accSessionRead(session, slot->in, pipe->inSize);
+			if (ret <= 0) break;
+			len = ret;
+		}
+		slot->seq = seq++;
+		slot->inLen = len;
+		/* workQ has room for all slots */
+		accLfQueuePush(&pipe->workQ, slot);
+	}
+	USB_LOG("Pipeline reader stops after %llu units\n", (unsigned long long)seq);
+	pipe->endSeq = seq;
+	__sync_synchronize();
+	pipe->readerDone = true;
+	wakeDeliverer(pipe);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+static void *pipelineWorker(void *data)
+{
+	struct AccPipeline *pipe = (struct AccPipeline *)data;
+	struct AccPipeSlot *slot = NULL;
+	unsigned int outLen;
+	int ret;
+
+	while (!pipe->stopping) {
+		slot = (struct AccPipeSlot *)accLfQueuePopWait(&pipe->workQ, &pipe->stopping);
+		if (!slot) break;
+		outLen = 0;
+		ret = pipe->decode(slot->in, slot->inLen, slot->out, pipe->outSize, &outLen, pipe->userData);
+		if (outLen > pipe->outSize) outLen = pipe->outSize;
+		/* Any error is negative. -ret of INT_MIN would overflow, so a negative ret is kept as it is */
+		if (ret == 0) slot->outLen = (int)outLen;
+		else slot->outLen = (ret < 0) ? ret : -ret;
+		__sync_synchronize();
+		pipe->window[slot->seq % pipe->slotCnt] = slot;
+		wakeDeliverer(pipe);
+	}
+	return NULL;
+}
+
+/* Whether all the units read have been delivered. endSeq is set before readerDone */
+static bool pipelineEnded(struct AccPipeline *pipe, uint64_t next)
+{
+	if (!pipe->readerDone) return false;
+	__sync_synchronize();
+	return next == pipe->endSeq;
+}
+
+static void *pipelineDeliverer(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccPipeline *pipe = (struct AccPipeline *)data;
+	struct AccPipeSlot *slot = NULL;
+	uint64_t next = 0;
+	unsigned int idx;
+	int spin = 0;
+
+	while (!pipe->stopping) {
+		idx = next % pipe->slotCnt;
+		slot = pipe->window[idx];
+		if (slot && slot->seq == next) {
+			__sync_synchronize();
+			pipe->window[idx] = NULL;
+			pipe->deliver(next, (slot->outLen >= 0) ? slot->out : NULL, slot->outLen, pipe->userData);
+			next++;
+			spin = 0;
+			accLfQueuePush(&pipe->freeQ, slot);
+			continue;
+		}
+		if (pipelineEnded(pipe, next)) break;
+		if (spin++ < ACC_LFQ_SPIN) continue;
+
+		/* The units still decoding after the reader stops are waited for too */
+		spin = 0;
+		__sync_fetch_and_add(&pipe->deliverWaiters, 1);
+		slot = pipe->window[idx];
+		if (!(slot && slot->seq == next) && !pipelineEnded(pipe, next) && !pipe->stopping)
+			while (sem_wait(&pipe->deliverSem) < 0 && errno == EINTR);
+		__sync_fetch_and_sub(&pipe->deliverWaiters, 1);
+	}
+	/* The end is delivered once, also when the session is stopped before the data ends.
+	 * The units decoded but not delivered yet are dropped then */
+	pipe->deliver(next, NULL, 0, pipe->userData);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+static void freePipelineSlots(struct AccPipeline *pipe)
+{
+	unsigned int i;
+	if (pipe->slots) {
+		for (i = 0 ; i < pipe->slotCnt ; i++) {
+			FREE(pipe->slots[i].in);
+			FREE(pipe->slots[i].out);
+		}
+		FREE(pipe->slots);
+	}
+	FREE(pipe->window);
+	accLfQueueDestroy(&pipe->freeQ);
+	accLfQueueDestroy(&pipe->workQ);
+}
+
+static int allocPipelineSlots(struct AccPipeline *pipe)
+{
+	unsigned int i;
+
+	pipe->slots = (struct AccPipeSlot *)calloc(pipe->slotCnt, sizeof(struct AccPipeSlot));
+	pipe->window = (struct AccPipeSlot * volatile *)calloc(pipe->slotCnt, sizeof(struct AccPipeSlot *));
+	if (!pipe->slots || !pipe->window) goto fail;
+	if (accLfQueueInit(&pipe->freeQ, pipe->slotCnt) < 0) goto fail;
+	if (accLfQueueInit(&pipe->workQ, pipe->slotCnt) < 0) goto fail;
+	for (i = 0 ; i < pipe->slotCnt ; i++) {
+		pipe->slots[i].in = (char *)malloc(pipe->inSize);
+		pipe->slots[i].out = (char *)malloc(pipe->outSize);
+		if (!pipe->slots[i].in || !pipe->slots[i].out) goto fail;
+		accLfQueuePush(&pipe->freeQ, &pipe->slots[i]);
+	}
+	return 0;
+fail:
+	USB_LOG("FAIL: allocate pipeline slots\n");
+	freePipelineSlots(pipe);
+	return -1;
+}
+
+int accPipelineStart(struct usb_accessory_session_s *session)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccPipeline *pipe = session->pipeline;
+	unsigned int i;
+	int ret;
+
+	pipe->inSize = session->framed ? session->frameMax : session->raSize;
+	pipe->slotCnt = pipe->workerCnt * ACC_PIPELINE_SLOTS_PER_WORKER;
+	pipe->stopping = false;
+	pipe->readerDone = false;
+	pipe->endSeq = 0;
+	pipe->deliverWaiters = 0;
+	ret = allocPipelineSlots(pipe);
+	um_retvm_if(ret < 0, -1, "FAIL: allocPipelineSlots()\n");
+	if (sem_init(&pipe->deliverSem, 0, 0) < 0) {
+		USB_LOG("FAIL: sem_init() (%d)\n", errno);
+		freePipelineSlots(pipe);
+		return -1;
+	}
+
+	for (i = 0 ; i < pipe->workerCnt ; i++) {
+		ret = pthread_create(&pipe->workers[i], NULL, pipelineWorker, pipe);
+		if (ret != 0) break;
+		pipe->runningWorkers++;
+	}
+	if (ret == 0) {
+		ret = pthread_create(&pipe->deliverer, NULL, pipelineDeliverer, pipe);
+		if (ret == 0) pipe->delivererRunning = true;
+	}
+	if (ret == 0) {
+		ret = pthread_create(&pipe->reader, NULL, pipelineReader, session);
+		if (ret == 0) pipe->readerRunning = true;
+	}
+	if (ret != 0) {
+		USB_LOG("FAIL: pthread_create(pipeline) (%d)\n", ret);
+		accPipelineStop(session);
+		return -1;
+	}
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* The session must be stopping, so that the reader does not wait for the accessory */
+void accPipelineStop(struct usb_accessory_session_s *session)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccPipeline *pipe = session->pipeline;
+	unsigned int i;
+
+	if (!pipe || !pipe->slots) return;
+	pipe->stopping = true;
+	__sync_synchronize();
+	accLfQueueWake(&pipe->freeQ, 1);
+	accLfQueueWake(&pipe->workQ, pipe->runningWorkers);
+	sem_post(&pipe->deliverSem);
+
+	if (pipe->readerRunning) {
+		pthread_join(pipe->reader, NULL);
+		pipe->readerRunning = false;
+	}
+	for (i = 0 ; i < pipe->runningWorkers ; i++)
+		pthread_join(pipe->workers[i], NULL);
+	pipe->runningWorkers = 0;
+	if (pipe->delivererRunning) {
+		pthread_join(pipe->deliverer, NULL);
+		pipe->delivererRunning = false;
+	}
+	sem_destroy(&pipe->deliverSem);
+	freePipelineSlots(pipe);
+	__USB_FUNC_EXIT__ ;
+}
+
+int usb_accessory_session_set_pipeline(usb_accessory_session_h session, unsigned int workers,
+		unsigned int output_size, usb_accessory_decode_cb decode, usb_accessory_deliver_cb deliver, void *user_data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (workers > ACC_PIPELINE_MAX_WORKERS) return USB_ERROR_INVALID_PARAMETER;
+	if (workers > 0 && (!decode || !deliver || output_size == 0)) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started || (workers > 0 && (session->poolCount > 0 || session->broadcast))) return USB_ERROR_INVALID_OPERATION;
+
+	if (workers == 0) {
+		FREE(session->pipeline);
+		__USB_FUNC_EXIT__ ;
+		return USB_ERROR_NONE;
+	}
+	if (!session->pipeline) {
+		session->pipeline = (struct AccPipeline *)calloc(1, sizeof(struct AccPipeline));
+		um_retvm_if(session->pipeline == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: calloc(AccPipeline)\n");
+	}
+	session->pipeline->workerCnt = workers;
+	session->pipeline->outSize = output_size;
+	session->pipeline->decode = decode;
+	session->pipeline->deliver = deliver;
+	session->pipeline->userData = user_data;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
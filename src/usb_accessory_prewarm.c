@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Sessions opened on connect. When an accessory which matches the identity
+ * connects, a thread asks for its permission, and creates, prepares and starts
+ * a session, and then posts the connection task, in which the app takes the session.
+ * The connection tasks after it are held until then, so that the events stay in order.
+ * A session which is not taken is destroyed after the callback. */
+
+static struct {
+	pthread_mutex_t	lock;
+	struct usb_accessory_filter_s *identity;
+	usb_accessory_session_prepare_cb prepare;
+	void		*userData;
+	/* Connection tasks held behind the prewarms in flight, and whether a thread posts them now */
+	struct AccDispatchTask *heldHead;
+	struct AccDispatchTask *heldTail;
+	bool		posting;
+} prewarmConf = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.identity = NULL,
+	.prepare = NULL,
+	.userData = NULL,
+	.heldHead = NULL,
+	.heldTail = NULL,
+	.posting = false,
+};
+
+/* Post the held tasks from the first one until one whose session is not ready.
+ * A task may be freed as soon as it is posted */
+static void postHeldTasks(void)
+{
+	struct AccDispatchTask *task = NULL;
+	struct AccPrewarm *prewarm = NULL;
+
+	for (;;) {
+		pthread_mutex_lock(&prewarmConf.lock);
+		task = prewarmConf.heldHead;
+		prewarm = task ? ((struct AccConnectionTask *)task)->prewarm : NULL;
+		if (!task || (prewarm && !prewarm->ready)) {
+			prewarmConf.posting = false;
+			pthread_mutex_unlock(&prewarmConf.lock);
+			return;
+		}
+		prewarmConf.heldHead = task->next;
+		if (!prewarmConf.heldHead) prewarmConf.heldTail = NULL;
+		pthread_mutex_unlock(&prewarmConf.lock);
+		accDispatch(ACC_DISPATCH_CONNECTION, task);
+	}
+}
+
+static gboolean postHeldTasksIdleCb(gpointer data)
+{
+	postHeldTasks();
+	return FALSE;
+}
+
+/* Mark the session of a prewarm ready, and post the tasks it held unless another thread does.
+ * Inline tasks would run in the prewarm thread, so they are posted from the default main context,
+ * where the events are received */
+static void prewarmDone(struct AccPrewarm *prewarm)
+{
+	pthread_mutex_lock(&prewarmConf.lock);
+	prewarm->ready = true;
+	if (prewarmConf.posting) {
+		pthread_mutex_unlock(&prewarmConf.lock);
+		return;
+	}
+	prewarmConf.posting = true;
+	pthread_mutex_unlock(&prewarmConf.lock);
+	if (accDispatchInline()) {
+		if (accGlib()->idle_add(postHeldTasksIdleCb, NULL) > 0) return;
+		USB_LOG("FAIL: idle_add(held tasks)\n");
+	}
+	postHeldTasks();
+}
+
+static void *prewarmThread(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct AccPrewarm *prewarm = (struct AccPrewarm *)data;
+	struct usb_accessory_s *acc = acc_handle_get(prewarm->accessory);
+	usb_accessory_session_h session = NULL;
+	bool granted = false;
+
+	if (!acc || getAccPermission(acc, &granted) != 0 || !granted) {
+		USB_LOG("The accessory has no permission. No session is opened\n");
+		prewarmDone(prewarm);
+		return NULL;
+	}
+	if (usb_accessory_session_create(prewarm->accessory, &session) != USB_ERROR_NONE) {
+		USB_LOG("FAIL: usb_accessory_session_create()\n");
+		prewarmDone(prewarm);
+		return NULL;
+	}
+	if (prewarm->prepare) prewarm->prepare(session, prewarm->userData);
+	if (usb_accessory_session_start(session) != USB_ERROR_NONE) {
+		USB_LOG("FAIL: usb_accessory_session_start()\n");
+		usb_accessory_session_destroy(session);
+		prewarmDone(prewarm);
+		return NULL;
+	}
+	prewarm->session = session;
+	prewarmDone(prewarm);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+/* Start a prewarm for the accessory of a connection task.
+ * It returns NULL if the accessory is not to be prewarmed */
+static struct AccPrewarm *startPrewarm(usb_accessory_h accessory)
+{
+	struct AccPrewarm *prewarm = NULL;
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	pthread_t thread;
+	int ret;
+
+	if (!acc) return NULL;
+	pthread_mutex_lock(&prewarmConf.lock);
+	if (!prewarmConf.identity || !accFilterMatch(prewarmConf.identity, acc)) {
+		pthread_mutex_unlock(&prewarmConf.lock);
+		return NULL;
+	}
+	prewarm = (struct AccPrewarm *)calloc(1, sizeof(struct AccPrewarm));
+	if (!prewarm) {
+		pthread_mutex_unlock(&prewarmConf.lock);
+		USB_LOG("FAIL: calloc(AccPrewarm)\n");
+		return NULL;
+	}
+	prewarm->accessory = accessory;
+	prewarm->prepare = prewarmConf.prepare;
+	prewarm->userData = prewarmConf.userData;
+	pthread_mutex_unlock(&prewarmConf.lock);
+
+	ret = pthread_create(&thread, NULL, prewarmThread, prewarm);
+	if (ret != 0) {
+		USB_LOG("FAIL: pthread_create(prewarm) (%d)\n", ret);
+		FREE(prewarm);
+		return NULL;
+	}
+	pthread_detach(thread);
+	return prewarm;
+}
+
+/* Post a connection task. A connect to be prewarmed is posted by the prewarm thread
+ * when the session is ready, and the tasks after it wait for it */
+void accPrewarmDispatch(struct AccConnectionTask *task)
+{
+	if (task->accessory && task->connected) task->prewarm = startPrewarm(task->accessory);
+
+	pthread_mutex_lock(&prewarmConf.lock);
+	if (!task->prewarm && !prewarmConf.heldHead && !prewarmConf.posting) {
+		pthread_mutex_unlock(&prewarmConf.lock);
+		accDispatch(ACC_DISPATCH_CONNECTION, &task->task);
+		return;
+	}
+	task->task.next = NULL;
+	if (prewarmConf.heldTail) prewarmConf.heldTail->next = &task->task;
+	else prewarmConf.heldHead = &task->task;
+	prewarmConf.heldTail = &task->task;
+	pthread_mutex_unlock(&prewarmConf.lock);
+}
+
+/* Lend the session to the accessory for the callback. The task runs after the session is ready */
+void accPrewarmAttach(struct AccPrewarm *prewarm)
+{
+	struct usb_accessory_s *acc = NULL;
+
+	if (!prewarm) return;
+	acc = acc_handle_get(prewarm->accessory);
+	if (acc) acc->prewarmed = prewarm->session;
+	else if (prewarm->session) usb_accessory_session_destroy(prewarm->session);
+}
+
+/* Destroy the session if the app did not take it in the callback */
+void accPrewarmRelease(struct AccPrewarm *prewarm)
+{
+	struct usb_accessory_s *acc = NULL;
+
+	if (!prewarm) return;
+	acc = acc_handle_get(prewarm->accessory);
+	if (acc && acc->prewarmed) {
+		USB_LOG("The prewarmed session is not taken\n");
+		usb_accessory_session_destroy(acc->prewarmed);
+		acc->prewarmed = NULL;
+	}
+	FREE(prewarm);
+}
+
+int usb_accessory_set_prewarm(usb_accessory_filter_h identity, usb_accessory_session_prepare_cb prepare, void *user_data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	struct usb_accessory_filter_s *copied = NULL;
+
+	if (identity) {
+		um_retvm_if(accFilterCopy(identity, &copied) < 0, USB_ERROR_OPERATION_FAILED, "FAIL: accFilterCopy()\n");
+	}
+	pthread_mutex_lock(&prewarmConf.lock);
+	if (prewarmConf.identity) accFilterDestroy(prewarmConf.identity);
+	prewarmConf.identity = copied;
+	prewarmConf.prepare = prepare;
+	prewarmConf.userData = user_data;
+	pthread_mutex_unlock(&prewarmConf.lock);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_get_prewarmed_session(usb_accessory_h accessory, usb_accessory_session_h *session)
+{
+	__USB_FUNC_ENTER__ ;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	if (!acc->prewarmed) return USB_ERROR_INVALID_OPERATION;
+	*session = acc->prewarmed;
+	acc->prewarmed = NULL;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
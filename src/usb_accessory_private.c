@@ -76,23 +76,54 @@ int request_to_usb_server(int sock_remote, int request, char *answer, char *pkgN
 	return 0;
 }
 
+static void runPermissionTask(struct AccDispatchTask *task)
+{
+	struct AccPermissionTask *permTask = (struct AccPermissionTask *)task;
+	permTask->func(permTask->accessory, permTask->granted);
+	FREE(permTask);
+}
+
+/* Call the permission callback of the app, now or later by the dispatcher */
+static void dispatchPermissionEvent(struct AccCbData *permCbData, bool granted)
+{
+	struct AccPermissionTask *task = NULL;
+	task = (struct AccPermissionTask *)calloc(1, sizeof(struct AccPermissionTask));
+	if (!task) {
+		USB_LOG("FAIL: calloc(AccPermissionTask)\n");
+		permCbData->request_perm_cb_func((usb_accessory_h)(permCbData->user_data), granted);
+		return;
+	}
+	task->task.run = runPermissionTask;
+	task->func = permCbData->request_perm_cb_func;
+	task->accessory = (usb_accessory_h)(permCbData->user_data);
+	task->granted = granted;
+	accDispatch(ACC_DISPATCH_PERMISSION, &task->task);
+}
+
 int handle_input_to_server(void *data, char *buf)
 {
 	__USB_FUNC_ENTER__ ;
 	if (!data) return -1;
 	if (!buf) return -1;
 	struct AccCbData *permCbData = (struct AccCbData *)data;
+	struct usb_accessory_s *accessory = acc_handle_get(permCbData->accessory);
+	if (!accessory) {
+		USB_LOG("ERROR: The accessory handle is already destroyed\n");
+		return -1;
+	}
 	int input = atoi(buf);
 	USB_LOG("Input: %d\n", input);
 
 	switch (input) {
 	case REQ_ACC_PERM_NOTI_YES_BTN:
-		permCbData->accessory->accPermission = true;
-		permCbData->request_perm_cb_func((struct usb_accessory_s*)(permCbData->user_data), true);
+		accessory->accPermission = true;
+		accCacheRecordPermission(accessory, true);
+		dispatchPermissionEvent(permCbData, true);
 		break;
 	case REQ_ACC_PERM_NOTI_NO_BTN:
-		permCbData->accessory->accPermission = false;
-		permCbData->request_perm_cb_func((struct usb_accessory_s*)(permCbData->user_data), false);
+		accessory->accPermission = false;
+		accCacheRecordPermission(accessory, false);
+		dispatchPermissionEvent(permCbData, false);
 		break;
 	default:
 		break;
@@ -122,7 +153,8 @@ static int read_message(int fd, char *str, int len)
 	}
 }
 
-int ipc_noti_client_init(void)
+/* This function makes a listening socket which usb-server connects to */
+int ipc_listen_socket_init(const char *path)
 {
 	__USB_FUNC_ENTER__ ;
 	int sock_local;
@@ -137,7 +169,7 @@ int ipc_noti_client_init(void)
 		return -1;
 	}
 	serveraddr.sun_family = AF_UNIX;
-	strncpy(serveraddr.sun_path, ACC_SOCK_PATH, strlen(ACC_SOCK_PATH)+1);
+	strncpy(serveraddr.sun_path, path, strlen(path)+1);
 	USB_LOG("socket file name: %s\n", serveraddr.sun_path);
 	unlink(serveraddr.sun_path);
 	len = strlen(serveraddr.sun_path) + sizeof(serveraddr.sun_family);
@@ -145,17 +177,19 @@ int ipc_noti_client_init(void)
 	if (bind (sock_local, (struct sockaddr *)&serveraddr, len) < 0) {
 		perror("bind");
 		USB_LOG("FAIL: bind (sock_local, (struct sockaddr_un *)serveraddr)\n");
+		close(sock_local);
 		return -1;
 	}
 
-	ret = chown(ACC_SOCK_PATH, 5000, 5000);
-	if (ret < 0) USB_LOG("FAIL: chown(ACC_SOCK_PATH, 5000, 5000)");
-	ret = chmod(ACC_SOCK_PATH, 0777);
-	if (ret < 0) USB_LOG("FAIL: chmod(ACC_SOCK_PATH, 0777);");
+	ret = chown(path, 5000, 5000);
+	if (ret < 0) USB_LOG("FAIL: chown(%s, 5000, 5000)", path);
+	ret = chmod(path, 0777);
+	if (ret < 0) USB_LOG("FAIL: chmod(%s, 0777);", path);
 
 	if (listen (sock_local, 5) == -1) {
 		perror("listen");
 		USB_LOG("FAIL: listen (sock_local, 5)\n");
+		close(sock_local);
 		return -1;
 	}
 
@@ -163,6 +197,70 @@ int ipc_noti_client_init(void)
 	return sock_local;
 }
 
+/* This function makes the listening socket of the pushed events.
+ * The name is abstract and has the pid in it, so each process has its own,
+ * and no file is created that another process could replace or open */
+int ipc_event_socket_init(void)
+{
+	__USB_FUNC_ENTER__ ;
+	int sock_local;
+	socklen_t len;
+	struct sockaddr_un serveraddr;
+
+	sock_local = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sock_local < 0) {
+		perror("socket");
+		USB_LOG("FAIL: socket(AF_UNIX, SOCK_STREAM, 0)\n");
+		return -1;
+	}
+	memset(&serveraddr, 0, sizeof(serveraddr));
+	serveraddr.sun_family = AF_UNIX;
+	/* sun_path[0] stays '\0' for the abstract namespace */
+	snprintf(serveraddr.sun_path + 1, sizeof(serveraddr.sun_path) - 1, "%s.%d",
+			ACC_EVENT_SOCK_NAME, (int)getpid());
+	USB_LOG("socket name: @%s\n", serveraddr.sun_path + 1);
+	len = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(serveraddr.sun_path + 1);
+
+	if (bind(sock_local, (struct sockaddr *)&serveraddr, len) < 0) {
+		perror("bind");
+		USB_LOG("FAIL: bind(sock_local, @%s)\n", serveraddr.sun_path + 1);
+		close(sock_local);
+		return -1;
+	}
+
+	if (listen(sock_local, 5) == -1) {
+		perror("listen");
+		USB_LOG("FAIL: listen (sock_local, 5)\n");
+		close(sock_local);
+		return -1;
+	}
+
+	__USB_FUNC_EXIT__ ;
+	return sock_local;
+}
+
+/* Anybody can connect to an abstract socket, so the sender must be usb-server */
+static bool isUsbServerPeer(int sock)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+		USB_LOG("FAIL: getsockopt(SO_PEERCRED) (%d)\n", errno);
+		return false;
+	}
+	if (cred.uid != USB_SERVER_UID) {
+		USB_LOG("ERROR: Event from pid %d, uid %d is ignored\n", (int)cred.pid, (int)cred.uid);
+		return false;
+	}
+	return true;
+}
+
+int ipc_noti_client_init(void)
+{
+	return accBackend()->listen_answers();
+}
+
 int ipc_noti_client_close(int *sock_remote)
 {
 	__USB_FUNC_ENTER__ ;
@@ -186,12 +284,12 @@ gboolean ipc_noti_client_cb(GIOChannel *g_io_ch, GIOCondition condition, gpointe
 	GError *err;
 	GIOStatus gio_ret;
 
-	fd = g_io_channel_unix_get_fd(g_io_ch);
+	fd = accGlib()->io_channel_unix_get_fd(g_io_ch);
 	if (fd < 0) {
 		USB_LOG("FAIL: g_io_channel_unix_get_fd(g_io_ch)\n");
-		gio_ret = g_io_channel_shutdown(g_io_ch, TRUE, &err);
+		gio_ret = accGlib()->io_channel_shutdown(g_io_ch, TRUE, &err);
 		if (G_IO_STATUS_ERROR == gio_ret) USB_LOG("ERROR: g_io_channel_shutdown(g_io_ch)\n");
-		g_io_channel_unref(g_io_ch);
+		accGlib()->io_channel_unref(g_io_ch);
 		return FALSE;
 	}
 
@@ -200,9 +298,9 @@ gboolean ipc_noti_client_cb(GIOChannel *g_io_ch, GIOCondition condition, gpointe
 	if (client_sockfd == -1) {
 		perror("accept");
 		USB_LOG("FAIL: accept(fd, (struct sockaddr *)&client_address, (socklen_t *)&client_len)\n");
-		gio_ret = g_io_channel_shutdown(g_io_ch, TRUE, &err);
+		gio_ret = accGlib()->io_channel_shutdown(g_io_ch, TRUE, &err);
 		if (G_IO_STATUS_ERROR == gio_ret) USB_LOG("ERROR: g_io_channel_shutdown(g_io_ch)\n");
-		g_io_channel_unref(g_io_ch);
+		accGlib()->io_channel_unref(g_io_ch);
 		ret = ipc_noti_client_close(&client_sockfd);
 		if (ret < 0) USB_LOG("FAIL: ipc_noti_client_close(client_sockfd)\n");
 		return FALSE;
@@ -213,9 +311,9 @@ gboolean ipc_noti_client_cb(GIOChannel *g_io_ch, GIOCondition condition, gpointe
 		snprintf(output_buf, strlen("FAIL"), "%d", IPC_FAIL);
 		ret = write(client_sockfd, &output_buf, sizeof(output_buf));
 		if (ret < 0) USB_LOG("FAIL: write(client_sockfd, &output_buf, sizeof(output_buf))\n");
-		gio_ret = g_io_channel_shutdown(g_io_ch, TRUE, &err);
+		gio_ret = accGlib()->io_channel_shutdown(g_io_ch, TRUE, &err);
 		if (G_IO_STATUS_ERROR == gio_ret) USB_LOG("ERROR: g_io_channel_shutdown(g_io_ch)\n");
-		g_io_channel_unref(g_io_ch);
+		accGlib()->io_channel_unref(g_io_ch);
 		ret = ipc_noti_client_close(&client_sockfd);
 		if (ret < 0) USB_LOG("FAIL: ipc_noti_client_close(client_sockfd)\n");
 		return FALSE;
@@ -224,9 +322,9 @@ gboolean ipc_noti_client_cb(GIOChannel *g_io_ch, GIOCondition condition, gpointe
 	snprintf(output_buf, SOCK_STR_LEN, "%d", IPC_SUCCESS);
 	ret = write(client_sockfd, &output_buf, sizeof(output_buf));
 	if (ret < 0) USB_LOG("FAIL: write(client_sockfd, &output_buf, sizeof(output_buf))\n");
-	gio_ret = g_io_channel_shutdown(g_io_ch, TRUE, &err);
+	gio_ret = accGlib()->io_channel_shutdown(g_io_ch, TRUE, &err);
 	if (G_IO_STATUS_ERROR == gio_ret) USB_LOG("ERROR: g_io_channel_shutdown(g_io_ch)\n");
-	g_io_channel_unref(g_io_ch);
+	accGlib()->io_channel_unref(g_io_ch);
 	ret = ipc_noti_client_close(&client_sockfd);
 	if (ret < 0) USB_LOG("FAIL: ipc_noti_client_close(client_sockfd)\n");
 
@@ -245,29 +343,80 @@ char *get_app_id()
 	int pid = getpid();
 	USB_LOG("pid: %d\n", pid);
 	char appId[APP_ID_LEN];
-	int ret = aul_app_get_appid_bypid(getpid(), appId, APP_ID_LEN);
+	int ret = accAul()->app_get_appid_bypid(getpid(), appId, APP_ID_LEN);
 	um_retvm_if(AUL_R_OK != ret, NULL, "FAIL: aul_app_get_appid_bypid(getpid(), appId)\n");
 	__USB_FUNC_EXIT__ ;
 	return strdup(appId);
 }
 
+/* Ask usb-server whether the app has the permission for the accessory, and keep the verdict.
+ * It returns 1 without asking if the app id is unknown, and -1 if usb-server cannot be asked */
+int getAccPermission(struct usb_accessory_s *accessory, bool *granted)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!accessory || !granted) return -1;
+	int ret = -1;
+	char buf[SOCK_STR_LEN];
+	char *app_id = get_app_id();
+	if (app_id == NULL) {
+		USB_LOG("FAIL: get_app_id()\n");
+		*granted = false;
+		return 1;
+	}
+
+	ret = accBackend()->request(HAS_ACC_PERMISSION, buf, app_id);
+	FREE(app_id);
+	um_retvm_if(ret < 0, -1, "FAIL: request(HAS_ACC_PERMISSION)\n");
+
+	USB_LOG("Permission: %s\n", buf);
+	accessory->accPermission = (IPC_SUCCESS == atoi(buf));
+	*granted = accessory->accPermission;
+	accCacheRecordPermission(accessory, *granted);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* The accessory node can be replaced, e.g. by a FIFO which loops the data back */
+const char *getAccNodePath(void)
+{
+	const char *path = getenv(USB_ACCESSORY_NODE_ENV);
+	return (path && *path) ? path : USB_ACCESSORY_NODE;
+}
+
+static struct AccEventPipe eventPipe = {
+	.settleMs = 0,
+	.settleTimer = 0,
+	.lastStatus = -1,
+	.pendingStatus = -1,
+	.pendingEdges = 0,
+	.suppressedEdges = 0,
+	.eventSock = -1,
+	.eventCh = NULL,
+	.eventWatch = 0,
+	.pushedAcc = NULL,
+	.pushedDropped = false,
+	.filter = NULL,
+	.connectedMatched = false
+};
+
 /* This function find an accessory attached just now
  * Currently This function supports just one accessory */
-static int getChangedAcc (struct usb_accessory_s **attAcc)
+static int getChangedAcc (usb_accessory_h *attAcc)
 {
 	__USB_FUNC_ENTER__ ;
 	if (attAcc == NULL) return -1;
 	struct usb_accessory_list *accList = NULL;
-	bool ret = getAccList(&accList);
-	um_retvm_if(ret == false, -1, "FAIL: getAccList(&accList)\n");
-	um_retvm_if(accList == NULL, -1, "accList == NULL\n");
-	*attAcc = (struct usb_accessory_s *)malloc(sizeof(struct usb_accessory_s));
-	snprintf((*attAcc)->manufacturer, ACC_ELEMENT_LEN, "%s", accList->accessory->manufacturer);
-	snprintf((*attAcc)->model, ACC_ELEMENT_LEN, "%s", accList->accessory->model);
-	snprintf((*attAcc)->description, ACC_ELEMENT_LEN, "%s", accList->accessory->description);
-	snprintf((*attAcc)->version, ACC_ELEMENT_LEN, "%s", accList->accessory->version);
-	snprintf((*attAcc)->uri, ACC_ELEMENT_LEN, "%s", accList->accessory->uri);
-	snprintf((*attAcc)->serial, ACC_ELEMENT_LEN, "%s", accList->accessory->serial);
+	bool ret = getAttachedAccList(&accList, eventPipe.filter);
+	um_retvm_if(ret == false, -1, "FAIL: getAttachedAccList(&accList)\n");
+	if (accList == NULL) {
+		/* The accessory is dropped by the filter */
+		*attAcc = NULL;
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+	/* Take the handle from the list instead of copying it */
+	*attAcc = accList->accessory;
+	accList->accessory = NULL;
 	ret = freeAccList(accList);
 	um_retvm_if(ret == false, -1, "FAIL: freeAccList(accList)\n");
 
@@ -276,39 +425,98 @@ static int getChangedAcc (struct usb_accessory_s **attAcc)
 }
 
 /* This func release memory of an accessory attached just now */
-static int freeChangedAcc (struct usb_accessory_s **attAcc)
+static int freeChangedAcc (usb_accessory_h *attAcc)
 {
 	__USB_FUNC_ENTER__ ;
 	if (attAcc == NULL) return -1;
-	FREE(*attAcc);
+	if (*attAcc && acc_handle_free(*attAcc) < 0) return -1;
+	*attAcc = NULL;
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
 
-/* Callback function which is called when accessory vconf key is changed */
-void accessory_status_changed_cb(keynode_t *in_key, void* data)
+static void runConnectionTask(struct AccDispatchTask *task)
+{
+	struct AccConnectionTask *conTask = (struct AccConnectionTask *)task;
+	accPrewarmAttach(conTask->prewarm);
+	conTask->func(conTask->accessory, conTask->connected, conTask->userData);
+	accPrewarmRelease(conTask->prewarm);
+	if (conTask->accessory) freeChangedAcc(&conTask->accessory);
+	FREE(conTask);
+}
+
+/* Call the connection callback of the app, now or later by the dispatcher.
+ * The accessory is freed after the callback.
+ * If it is to be prewarmed, the task is posted when a session for it is opened */
+static void dispatchConnectionEvent(struct AccCbData *conCbData, usb_accessory_h accessory, bool connected)
+{
+	struct AccConnectionTask *task = NULL;
+
+	task = (struct AccConnectionTask *)calloc(1, sizeof(struct AccConnectionTask));
+	if (!task) {
+		USB_LOG("FAIL: calloc(AccConnectionTask)\n");
+		conCbData->connection_cb_func(accessory, connected, conCbData->user_data);
+		if (accessory) freeChangedAcc(&accessory);
+		return;
+	}
+	task->task.run = runConnectionTask;
+	task->func = conCbData->connection_cb_func;
+	task->userData = conCbData->user_data;
+	task->accessory = accessory;
+	task->connected = connected;
+	accPrewarmDispatch(task);
+}
+
+/* Call the connection callback of the app with the accessory status */
+static void deliverConnectionEvent(struct AccCbData *conCbData, int val)
 {
 	__USB_FUNC_ENTER__ ;
-	if (!data)  return ;
-	struct AccCbData *conCbData = (struct AccCbData *)data;
-	struct usb_accessory_s *changedAcc = NULL;
+	usb_accessory_h changedAcc = NULL;
 	int ret = -1;
-	int val = -1;
-	ret = vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS, &val);
-	um_retm_if(ret < 0, "FAIL: vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS)\n");
+
+	/* The push and the status key each report the edge. Whichever comes second is dropped */
+	if (val == eventPipe.lastStatus) {
+		USB_LOG("Status %d is already delivered\n", val);
+		freeChangedAcc(&eventPipe.pushedAcc);
+		eventPipe.pushedDropped = false;
+		__USB_FUNC_EXIT__ ;
+		return ;
+	}
 
 	switch (val) {
 	case VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED:
-		conCbData->connection_cb_func(NULL, false, conCbData->user_data);
+		eventPipe.lastStatus = val;
+		freeChangedAcc(&eventPipe.pushedAcc);
+		eventPipe.pushedDropped = false;
+		if (eventPipe.filter && !eventPipe.connectedMatched) {
+			USB_LOG("The disconnected accessory did not match the filter\n");
+			break;
+		}
+		eventPipe.connectedMatched = false;
+		dispatchConnectionEvent(conCbData, NULL, false);
 		break;
 	case VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED:
-		ret = getChangedAcc(&changedAcc);
-		um_retm_if(ret < 0, "FAIL: getChangedAcc(&changedAcc)\n");
-
-		conCbData->connection_cb_func(changedAcc, true, conCbData->user_data);
-
-		ret = freeChangedAcc(&changedAcc);
-		um_retm_if(ret < 0, "FAIL: freeChangedAcc(&changedAcc)\n");
+		eventPipe.lastStatus = val;
+		if (eventPipe.pushedDropped) {
+			eventPipe.pushedDropped = false;
+			eventPipe.connectedMatched = false;
+			USB_LOG("The pushed accessory does not match the filter\n");
+			break;
+		}
+		if (eventPipe.pushedAcc) {
+			/* The information came with the event. No need to ask usb-server */
+			changedAcc = eventPipe.pushedAcc;
+			eventPipe.pushedAcc = NULL;
+		} else {
+			ret = getChangedAcc(&changedAcc);
+			um_retm_if(ret < 0, "FAIL: getChangedAcc(&changedAcc)\n");
+		}
+		if (changedAcc == NULL) {
+			eventPipe.connectedMatched = false;
+			break;
+		}
+		eventPipe.connectedMatched = true;
+		dispatchConnectionEvent(conCbData, changedAcc, true);
 		break;
 	default:
 		USB_LOG("ERROR: The value of VCONFKEY_USB_ACCESSORY_STATUS is invalid\n");
@@ -317,99 +525,401 @@ void accessory_status_changed_cb(keynode_t *in_key, void* data)
 	__USB_FUNC_EXIT__ ;
 }
 
-/* Get an element from a string which has all information of an accessory */
-static bool getAccElement(char *totalInfo[], char accInfo[])
+/* Called when the status key has been quiet for the settle window.
+ * Only the net transition of the collected edges is delivered */
+static gboolean connection_settle_timeout_cb(gpointer data)
 {
 	__USB_FUNC_ENTER__ ;
-	if (!totalInfo) return false;
-	if (!accInfo) return false;
+	struct AccCbData *conCbData = (struct AccCbData *)data;
+	int val = -1;
+	unsigned int edges = eventPipe.pendingEdges;
 
-	char *finder = *totalInfo;
+	eventPipe.settleTimer = 0;
+	eventPipe.pendingEdges = 0;
 
-	if (*totalInfo) {
-		while (1) {
-			if (finder == NULL) {
-				USB_LOG("ERROR: finder == NULL");
-				__USB_FUNC_EXIT__ ;
-				return false;
-			}
-			if (*finder == '|' || *finder == '\0') {
-				*finder = '\0';
-				snprintf(accInfo, ACC_ELEMENT_LEN, "%s", *totalInfo);
-				USB_LOG("Info: %s", accInfo);
-				*totalInfo = ++finder;
-				__USB_FUNC_EXIT__ ;
-				return true;
-			}
-			finder++;
-		}
+	if (accBackend()->get_status(&val) < 0) {
+		USB_LOG("FAIL: get_status()\n");
+		val = eventPipe.pendingStatus;
+	}
+
+	if (val == eventPipe.lastStatus) {
+		eventPipe.suppressedEdges += edges;
+		USB_LOG("Status is not changed after %u edges\n", edges);
+	} else {
+		if (edges > 1) eventPipe.suppressedEdges += edges - 1;
+		deliverConnectionEvent(conCbData, val);
+	}
+	__USB_FUNC_EXIT__ ;
+	return FALSE;
+}
+
+/* Pass a status edge to the settle window, or to the app if there is no window */
+static void feedConnectionEvent(struct AccCbData *conCbData, int val)
+{
+	__USB_FUNC_ENTER__ ;
+	if (eventPipe.settleMs == 0) {
+		deliverConnectionEvent(conCbData, val);
+		__USB_FUNC_EXIT__ ;
+		return ;
+	}
+
+	eventPipe.pendingStatus = val;
+	eventPipe.pendingEdges++;
+	if (eventPipe.settleTimer > 0) accGlib()->source_remove(eventPipe.settleTimer);
+	eventPipe.settleTimer = accGlib()->timeout_add(eventPipe.settleMs, connection_settle_timeout_cb, conCbData);
+	if (eventPipe.settleTimer == 0) {
+		USB_LOG("FAIL: g_timeout_add(settleMs)\n");
+		eventPipe.pendingEdges = 0;
+		deliverConnectionEvent(conCbData, val);
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Callback function which is called when accessory vconf key is changed */
+void accessory_status_changed_cb(keynode_t *in_key, void* data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!data)  return ;
+	struct AccCbData *conCbData = (struct AccCbData *)data;
+	int ret = -1;
+	int val = -1;
+	ret = accBackend()->get_status(&val);
+	um_retm_if(ret < 0, "FAIL: get_status()\n");
+
+	feedConnectionEvent(conCbData, val);
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Remember the current status so that the first settled event is a real transition */
+void init_connection_event_pipe(void)
+{
+	__USB_FUNC_ENTER__ ;
+	int val = -1;
+	if (accBackend()->get_status(&val) < 0) {
+		USB_LOG("FAIL: get_status()\n");
 	}
+	eventPipe.lastStatus = val;
+	eventPipe.pendingEdges = 0;
+	/* The accessory connected already is not known to match the filter.
+	 * Its disconnection is delivered not to be lost */
+	eventPipe.connectedMatched = (val == VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
 	__USB_FUNC_EXIT__ ;
-	return false;
+}
+
+/* Drop the pending settle window when the connection callback is unset */
+void reset_connection_event_pipe(void)
+{
+	__USB_FUNC_ENTER__ ;
+	if (eventPipe.settleTimer > 0) {
+		accGlib()->source_remove(eventPipe.settleTimer);
+		eventPipe.settleTimer = 0;
+	}
+	eventPipe.suppressedEdges += eventPipe.pendingEdges;
+	eventPipe.pendingEdges = 0;
+	eventPipe.pushedDropped = false;
+	eventPipe.connectedMatched = false;
+	freeChangedAcc(&eventPipe.pushedAcc);
+	__USB_FUNC_EXIT__ ;
+}
+
+int set_connection_debounce(unsigned int settleMs)
+{
+	__USB_FUNC_ENTER__ ;
+	eventPipe.settleMs = settleMs;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* The filter is copied. NULL removes the filter */
+int set_connection_filter(struct usb_accessory_filter_s *filter)
+{
+	__USB_FUNC_ENTER__ ;
+	struct usb_accessory_filter_s *copied = NULL;
+	if (filter) {
+		int ret = accFilterCopy(filter, &copied);
+		um_retvm_if(ret < 0, -1, "FAIL: accFilterCopy(filter)\n");
+	}
+	accFilterDestroy(eventPipe.filter);
+	eventPipe.filter = copied;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+unsigned int get_suppressed_connection_events(void)
+{
+	return eventPipe.suppressedEdges;
+}
+
+/* Keep the information of an accessory as it came from usb-server.
+ * Nothing is parsed until a field is read */
+int setAccRaw(struct usb_accessory_s *accessory, const char *totalInfo)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!accessory) return -1;
+	if (!totalInfo) return -1;
+	size_t len = strnlen(totalInfo, SOCK_STR_LEN - 1);
+
+	memcpy(accessory->raw, totalInfo, len);
+	accessory->raw[len] = '\0';
+	accessory->rawLen = len;
+	accessory->indexed = false;
+	accessory->decoding = 0;
+	accessory->decoded = 0;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* Find where each field starts in the raw information.
+ * The fields are separated with '|', and a missing field is empty */
+void indexRawInfo(const char *raw, unsigned int rawLen, unsigned short offset[], unsigned short len[])
+{
+	unsigned int pos = 0;
+	int field;
+	for (field = 0 ; field < ACC_INFO_NUM ; field++) {
+		const char *start = raw + pos;
+		const char *end = memchr(start, '|', rawLen - pos);
+		unsigned int fieldLen = end ? (unsigned int)(end - start) : rawLen - pos;
+		offset[field] = pos;
+		len[field] = fieldLen;
+		pos += fieldLen;
+		if (pos < rawLen) pos++;
+	}
+}
+
+/* Every handle is indexed before the app sees it,
+ * so the getters only read the offsets */
+bool indexAccRaw(struct usb_accessory_s *accessory)
+{
+	if (!accessory) return false;
+	if (accessory->indexed) return true;
+	indexRawInfo(accessory->raw, accessory->rawLen, accessory->fieldOffset, accessory->fieldLen);
+	__sync_synchronize();
+	accessory->indexed = true;
+	return true;
+}
+
+static void copyAccField(struct usb_accessory_s *accessory, ACCESSORY_INFO field, char *dest)
+{
+	unsigned int len = accessory->fieldLen[field];
+	if (len >= ACC_ELEMENT_LEN) len = ACC_ELEMENT_LEN - 1;
+	memcpy(dest, accessory->raw + accessory->fieldOffset[field], len);
+	dest[len] = '\0';
+}
+
+/* Copy a field of an accessory to a new string.
+ * The first thread which claims the field decodes it to info[] and publishes it.
+ * A thread which finds it claimed but not published copies it from raw[],
+ * so the getters never wait and never read a half written info[] */
+char *dupAccField(struct usb_accessory_s *accessory, ACCESSORY_INFO field)
+{
+	unsigned int bit;
+	char value[ACC_ELEMENT_LEN];
+	char *dup = NULL;
+
+	if (!accessory) return NULL;
+	if (field < 0 || field >= ACC_INFO_NUM) return NULL;
+	bit = 1U << field;
+	indexAccRaw(accessory);
+
+	if (!(accessory->decoded & bit)) {
+		if (!(__sync_fetch_and_or(&accessory->decoding, bit) & bit)) {
+			copyAccField(accessory, field, accessory->info[field]);
+			__sync_fetch_and_or(&accessory->decoded, bit);
+		} else {
+			copyAccField(accessory, field, value);
+			dup = strdup(value);
+			um_retvm_if(dup == NULL, NULL, "FAIL: strdup(value)\n");
+			return dup;
+		}
+	}
+	/* info[] is read only after its bit is seen */
+	__sync_synchronize();
+	dup = strdup(accessory->info[field]);
+	um_retvm_if(dup == NULL, NULL, "FAIL: strdup(info)\n");
+	return dup;
+}
+
+/* Description and uri do not identify an accessory */
+static const ACCESSORY_INFO idFields[] = { ACC_MANUFACTURER, ACC_MODEL, ACC_VERSION, ACC_SERIAL };
+
+/* 64-bit FNV-1a of manufacturer, model, version and serial */
+uint64_t getAccFingerprint(const char *raw, const unsigned short offset[], const unsigned short len[])
+{
+	uint64_t hash = 14695981039346656037ULL;
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0 ; i < sizeof(idFields) / sizeof(idFields[0]) ; i++) {
+		const char *str = raw + offset[idFields[i]];
+		for (j = 0 ; j < len[idFields[i]] ; j++) {
+			hash ^= (unsigned char)str[j];
+			hash *= 1099511628211ULL;
+		}
+		/* Separator, so that "ab|c" and "a|bc" differ */
+		hash ^= 0xFF;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/* Compare manufacturer, model, version and serial of two indexed accessories.
+ * The fingerprints may match by chance, so this decides */
+bool sameAccIdentity(struct usb_accessory_s *acc1, struct usb_accessory_s *acc2)
+{
+	unsigned int i;
+
+	for (i = 0 ; i < sizeof(idFields) / sizeof(idFields[0]) ; i++) {
+		ACCESSORY_INFO field = idFields[i];
+		if (acc1->fieldLen[field] != acc2->fieldLen[field]) return false;
+		if (memcmp(acc1->raw + acc1->fieldOffset[field], acc2->raw + acc2->fieldOffset[field],
+					acc1->fieldLen[field]) != 0)
+			return false;
+	}
+	return true;
 }
 
 /* Get all element separated from a string which has all information of an accessory */
 static int getAccInfo(char *totalInfo[], struct usb_accessory_s **accessory)
 {
 	__USB_FUNC_ENTER__ ;
-	bool ret = getAccElement(totalInfo, (*accessory)->manufacturer);
-	um_retvm_if(ret == false, -1, "FAIL: getAccElement(totalInfo, manufacturer)\n");
-	ret = getAccElement(totalInfo, (*accessory)->model);
-	um_retvm_if(ret == false, -1, "FAIL: getAccElement(totalInfo, model)\n");
-	ret = getAccElement(totalInfo, (*accessory)->description);
-	um_retvm_if(ret == false, -1, "FAIL: getAccElement(totalInfo, description)\n");
-	ret = getAccElement(totalInfo, (*accessory)->version);
-	um_retvm_if(ret == false, -1, "FAIL: getAccElement(totalInfo, version)\n");
-	ret = getAccElement(totalInfo, (*accessory)->uri);
-	um_retvm_if(ret == false, -1, "FAIL: getAccElement(totalInfo, uri)\n");
-	ret = getAccElement(totalInfo, (*accessory)->serial);
-	um_retvm_if(ret == false, -1, "FAIL: getAccElement(totalInfo, serial)\n");
+	if (!totalInfo || !(*totalInfo)) return -1;
+	int ret = setAccRaw(*accessory, *totalInfo);
+	um_retvm_if(ret < 0, -1, "FAIL: setAccRaw(accessory, totalInfo)\n");
+	indexAccRaw(*accessory);
+	(*accessory)->fingerprint = getAccFingerprint((*accessory)->raw,
+			(*accessory)->fieldOffset, (*accessory)->fieldLen);
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
 
 /* This function finds a list which contain all accessories attached
  * Currently, Tizen usb accessory is designed for just one accessory */
-//bool getAccList(struct usb_accessory_s **accList)
-bool getAccList(struct usb_accessory_list **accList)
+/* Make a handle for the information of an accessory and add it at the end of the list.
+ * The accessory is dropped if it does not match the filter */
+static bool appendAccList(struct usb_accessory_list **accList, char *info, struct usb_accessory_filter_s *filter)
 {
 	__USB_FUNC_ENTER__ ;
-	if (*accList != NULL) return false;
-	*accList = (struct usb_accessory_list *)malloc(sizeof(struct usb_accessory_list));
+	struct usb_accessory_list *node = NULL;
 	struct usb_accessory_s *accessory = NULL;
-	accessory = (struct usb_accessory_s *)malloc(sizeof(struct usb_accessory_s));
-	(*accList)->next = NULL;
-	(*accList)->accessory = accessory;
+	char *tempInfo = info;
+	int ret = -1;
+
+	if (!accFilterMatchRaw(filter, info)) {
+		USB_LOG("The accessory does not match the filter\n");
+		__USB_FUNC_EXIT__ ;
+		return true;
+	}
+
+	node = (struct usb_accessory_list *)malloc(sizeof(struct usb_accessory_list));
+	um_retvm_if(node == NULL, false, "FAIL: malloc(usb_accessory_list)\n");
+	node->next = NULL;
+	node->accessory = acc_handle_alloc();
+	accessory = acc_handle_get(node->accessory);
+	if (accessory == NULL) {
+		USB_LOG("FAIL: acc_handle_alloc()\n");
+		FREE(node);
+		return false;
+	}
 	accessory->accPermission = false;
 
-	int ret = -1;
-	int sock_remote;
+	ret = getAccInfo(&tempInfo, &accessory);
+	if (ret < 0) {
+		USB_LOG("FAIL: getAccInfo(&tempInfo, accList)\n");
+		acc_handle_free(node->accessory);
+		FREE(node);
+		return false;
+	}
+	USB_LOG("Acc info: %s\n", accessory->raw);
+
+	while (*accList) accList = &((*accList)->next);
+	*accList = node;
+	__USB_FUNC_EXIT__ ;
+	return true;
+}
+
+/* Read the accessories from the shared state segment.
+ * accCnt is the number of accessories in it, before the filter.
+ * It returns false if the caller must ask usb-server */
+static bool getAccListFromShm(struct usb_accessory_list **accList, struct usb_accessory_filter_s *filter, unsigned int *accCnt)
+{
+	__USB_FUNC_ENTER__ ;
 	char buf[SOCK_STR_LEN];
-	ret = ipc_request_client_init(&sock_remote);
-	um_retvm_if(ret < 0, false, "FAIL: ipc_request_client_init(&sock_remote)\n");
+	uint32_t firstGen = 0;
+	uint32_t gen = 0;
+	unsigned int idx;
+	int ret = -1;
 
-	ret = request_to_usb_server(sock_remote, GET_ACC_INFO, buf, NULL);
-	um_retvm_if(ret < 0, false, "FAIL: request_to_usb_server(GET_ACC_INFO)\n");
-	USB_LOG("GET_ACC_INFO: %s\n", buf);
+	for (idx = 0 ; ; idx++) {
+		ret = accShmReadAcc(idx, buf, sizeof(buf), &gen);
+		if (ret != 0) break;
+		if (idx == 0) firstGen = gen;
+		/* usb-server updated the segment between two accessories */
+		if (gen != firstGen) {
+			ret = -1;
+			break;
+		}
+		if (!appendAccList(accList, buf, filter)) {
+			ret = -1;
+			break;
+		}
+	}
+	if (ret < 0) {
+		freeAccList(*accList);
+		*accList = NULL;
+		__USB_FUNC_EXIT__ ;
+		return false;
+	}
+	*accCnt = idx;
+	__USB_FUNC_EXIT__ ;
+	return true;
+}
 
-	ret = ipc_request_client_close(&sock_remote);
-	um_retvm_if(ret < 0, false, "FAIL: ipc_request_client_close(&sock_remote)\n");
+/* If an accessory is known to be attached, an empty segment is not believed:
+ * usb-server may not have published it yet */
+static bool readAccList(struct usb_accessory_list **accList, struct usb_accessory_filter_s *filter, bool attached)
+{
+	__USB_FUNC_ENTER__ ;
+	unsigned int accCnt = 0;
 
-	char *tempInfo = buf;
-	ret = getAccInfo(&tempInfo, &((*accList)->accessory));
-	um_retvm_if(ret < 0, false, "FAIL: getAccInfo(&tempInfo, accList)\n");
+	if (*accList != NULL) return false;
 
-	USB_LOG("Acc manufacturer: %s\n", (*accList)->accessory->manufacturer);
-	USB_LOG("Acc model: %s\n", (*accList)->accessory->model);
-	USB_LOG("Acc description: %s\n", (*accList)->accessory->description);
-	USB_LOG("Acc version: %s\n", (*accList)->accessory->version);
-	USB_LOG("Acc uri: %s\n", (*accList)->accessory->uri);
-	USB_LOG("Acc serial: %s\n", (*accList)->accessory->serial);
+	if (getAccListFromShm(accList, filter, &accCnt)) {
+		if (accCnt > 0 || !attached) {
+			if (!filter) accCacheRecordList(*accList);
+			__USB_FUNC_EXIT__ ;
+			return true;
+		}
+		USB_LOG("Accessory state segment has no accessory yet\n");
+	}
 
+	int ret = -1;
+	char buf[SOCK_STR_LEN];
+	ret = accBackend()->request(GET_ACC_INFO, buf, NULL);
+	um_retvm_if(ret < 0, false, "FAIL: request(GET_ACC_INFO)\n");
+	USB_LOG("GET_ACC_INFO: %s\n", buf);
+
+	if (!appendAccList(accList, buf, filter)) return false;
+	if (!filter) accCacheRecordList(*accList);
 	__USB_FUNC_EXIT__ ;
 	return true;
 }
 
+/* This function finds a list which contain all accessories attached
+ * Currently, usb-server reports just one accessory by GET_ACC_INFO.
+ * If a filter is given, the accessories which do not match are dropped
+ * before handles are made for them, and the list can be empty. */
+bool getAccList(struct usb_accessory_list **accList, struct usb_accessory_filter_s *filter)
+{
+	return readAccList(accList, filter, false);
+}
+
+/* The same as getAccList(), on the connected edge.
+ * An empty list means that the filter dropped the accessory */
+bool getAttachedAccList(struct usb_accessory_list **accList, struct usb_accessory_filter_s *filter)
+{
+	return readAccList(accList, filter, true);
+}
+
 /* Release memory of accessory list */
 bool freeAccList(struct usb_accessory_list *accList)
 {
@@ -419,31 +929,142 @@ bool freeAccList(struct usb_accessory_list *accList)
 	while (accList) {
 		tmpList = accList;
 		accList = accList->next;
-		FREE(tmpList->accessory);
+		if (tmpList->accessory) acc_handle_free(tmpList->accessory);
 		FREE(tmpList);
 	}
 	__USB_FUNC_EXIT__ ;
 	return true;
 }
 
-bool is_emul_bin()
+/* Handle an event pushed from usb-server.
+ * The message is "event|manufacturer|model|description|version|uri|serial" */
+static int handle_pushed_event(struct AccCbData *conCbData, char *buf)
 {
 	__USB_FUNC_ENTER__ ;
+	usb_accessory_h handle = NULL;
+	struct usb_accessory_s *accessory = NULL;
+	char *tempInfo = NULL;
+	int event = atoi(buf);
 	int ret = -1;
-	struct utsname name;
-	ret = uname(&name);
-	if (ret < 0) {
-		__USB_FUNC_EXIT__ ;
-		return true;
-	} else {
-		USB_LOG("Machine name: %s", name.machine);
-		if (strcasestr(name.machine, "emul")) {
-			__USB_FUNC_EXIT__ ;
-			return true;
-		} else {
-			__USB_FUNC_EXIT__ ;
-			return false;
+	USB_LOG("Pushed event: %d\n", event);
+
+	switch (event) {
+	case ACC_CONNECTED_NOTI:
+		tempInfo = strchr(buf, '|');
+		um_retvm_if(tempInfo == NULL, -1, "ERROR: No accessory information in the event\n");
+		tempInfo++;
+		freeChangedAcc(&eventPipe.pushedAcc);
+		if (!accFilterMatchRaw(eventPipe.filter, tempInfo)) {
+			eventPipe.pushedDropped = true;
+			feedConnectionEvent(conCbData, VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+			break;
 		}
+		eventPipe.pushedDropped = false;
+		handle = acc_handle_alloc();
+		accessory = acc_handle_get(handle);
+		um_retvm_if(accessory == NULL, -1, "FAIL: acc_handle_alloc()\n");
+		accessory->accPermission = false;
+		ret = getAccInfo(&tempInfo, &accessory);
+		if (ret < 0) {
+			USB_LOG("FAIL: getAccInfo(&tempInfo, &accessory)\n");
+			freeChangedAcc(&handle);
+			return -1;
+		}
+		eventPipe.pushedAcc = handle;
+		feedConnectionEvent(conCbData, VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+		break;
+	case ACC_DISCONNECTED_NOTI:
+		freeChangedAcc(&eventPipe.pushedAcc);
+		eventPipe.pushedDropped = false;
+		feedConnectionEvent(conCbData, VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+		break;
+	default:
+		USB_LOG("ERROR: Unknown event %d\n", event);
+		return -1;
 	}
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
 
+static gboolean ipc_event_client_cb(GIOChannel *g_io_ch, GIOCondition condition, gpointer data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!data) return FALSE;
+	int fd;
+	int ret = -1;
+	struct sockaddr_un client_address;
+	int client_sockfd;
+	int client_len;
+	char input_buf[SOCK_STR_LEN];
+	char output_buf[SOCK_STR_LEN];
+
+	fd = accGlib()->io_channel_unix_get_fd(g_io_ch);
+	um_retvm_if(fd < 0, FALSE, "FAIL: g_io_channel_unix_get_fd(g_io_ch)\n");
+
+	client_len = sizeof(client_address);
+	client_sockfd = accept(fd, (struct sockaddr *)&client_address, (socklen_t *)&client_len);
+	if (client_sockfd == -1) {
+		perror("accept");
+		USB_LOG("FAIL: accept(fd, (struct sockaddr *)&client_address, (socklen_t *)&client_len)\n");
+		return TRUE;
+	}
+	if (!isUsbServerPeer(client_sockfd)) {
+		ipc_noti_client_close(&client_sockfd);
+		return TRUE;
+	}
+
+	memset(input_buf, 0, sizeof(input_buf));
+	ret = read_message(client_sockfd, input_buf, sizeof(input_buf) - 1);
+	snprintf(output_buf, SOCK_STR_LEN, "%d", (ret < 0) ? IPC_FAIL : IPC_SUCCESS);
+	if (write(client_sockfd, &output_buf, strlen(output_buf)+1) < 0)
+		USB_LOG("FAIL: write(client_sockfd, &output_buf)\n");
+	ipc_noti_client_close(&client_sockfd);
+	um_retvm_if(ret < 0, TRUE, "FAIL: read_message(client_sockfd, input_buf)\n");
+
+	USB_LOG("read(): %s\n", input_buf);
+	ret = handle_pushed_event((struct AccCbData *)data, input_buf);
+	if (ret < 0) USB_LOG("FAIL: handle_pushed_event(input_buf)\n");
+
+	__USB_FUNC_EXIT__ ;
+	return TRUE;
+}
+
+/* Listen to the events which usb-server pushes with the accessory information.
+ * If this fails, the vconf key is still used for connection events */
+int ipc_event_client_init(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!data) return -1;
+	if (eventPipe.eventWatch > 0) return 0;
+
+	eventPipe.eventSock = accBackend()->listen_events();
+	um_retvm_if(eventPipe.eventSock < 0, -1, "FAIL: listen_events()\n");
+
+	eventPipe.eventCh = accGlib()->io_channel_unix_new(eventPipe.eventSock);
+	eventPipe.eventWatch = accGlib()->io_add_watch(eventPipe.eventCh, G_IO_IN, ipc_event_client_cb, data);
+	if (eventPipe.eventWatch == 0) {
+		USB_LOG("FAIL: g_io_add_watch(eventCh, G_IO_IN)\n");
+		ipc_event_client_close();
+		return -1;
+	}
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+void ipc_event_client_close(void)
+{
+	__USB_FUNC_ENTER__ ;
+	if (eventPipe.eventWatch > 0) {
+		accGlib()->source_remove(eventPipe.eventWatch);
+		eventPipe.eventWatch = 0;
+	}
+	if (eventPipe.eventCh) {
+		accGlib()->io_channel_unref(eventPipe.eventCh);
+		eventPipe.eventCh = NULL;
+	}
+	if (eventPipe.eventSock >= 0) {
+		accBackend()->unlisten_events(eventPipe.eventSock);
+		eventPipe.eventSock = -1;
+	}
+	__USB_FUNC_EXIT__ ;
 }
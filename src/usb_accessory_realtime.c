@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+#include <sched.h>
+
+/* Real-time I/O threads of a session. The reader and the writer threads
+ * move to the CPU and to SCHED_FIFO when they start, and fault in their stacks.
+ * The buffers are mapped apart from the heap and locked, so that unlocking them does not
+ * unlock the pages of other allocations. What cannot be applied without privileges
+ * is skipped and reported in the stats, and the session runs as usual. */
+
+static inline uint64_t jitterNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void *accRealtimeAlloc(struct usb_accessory_session_s *session, size_t size)
+{
+	void *buf;
+
+	if (!session->rtEnabled) return malloc(size);
+	buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	um_retvm_if(buf == MAP_FAILED, NULL, "FAIL: mmap(%zu) (%d)\n", size, errno);
+	if (mlock(buf, size) < 0) {
+		USB_LOG("Buffers are not locked (%d)\n", errno);
+		__sync_fetch_and_or(&session->rtFailed, ACC_RT_MLOCK);
+	}
+	/* Fault in the pages now, not in the first read */
+	memset(buf, 0, size);
+	return buf;
+}
+
+void accRealtimeFree(struct usb_accessory_session_s *session, void *buf, size_t size)
+{
+	if (!buf) return;
+	if (!session->rtEnabled) {
+		free(buf);
+		return;
+	}
+	munmap(buf, size);
+}
+
+/* Fault in the pages the thread will use of its stack. Only the buffers are locked */
+static void prefaultStack(void)
+{
+	volatile char stack[ACC_RT_STACK_PREFAULT];
+	unsigned int i;
+	for (i = 0 ; i < sizeof(stack) ; i += 4096) stack[i] = 0;
+}
+
+/* Called by an I/O thread when it starts */
+void accRealtimeEnterThread(struct usb_accessory_session_s *session)
+{
+	struct sched_param param;
+	cpu_set_t cpus;
+	int ret;
+
+	if (!session->rtEnabled) return;
+	if (session->rtCpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(session->rtCpu, &cpus);
+		ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (ret != 0) {
+			USB_LOG("CPU affinity is not set (%d)\n", ret);
+			__sync_fetch_and_or(&session->rtFailed, ACC_RT_AFFINITY);
+		}
+	}
+	if (session->rtPriority > 0) {
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = session->rtPriority;
+		ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (ret != 0) {
+			USB_LOG("SCHED_FIFO is not permitted (%d). The thread stays in the normal class\n", ret);
+			__sync_fetch_and_or(&session->rtFailed, ACC_RT_SCHED);
+		}
+	}
+	prefaultStack();
+}
+
+/* Called by the reader thread after each read which returned data.
+ * The jitter is smoothed as in RFC 3550 from the differences of consecutive intervals */
+void accJitterRecord(struct AccJitterStats *jitter)
+{
+	uint64_t now = jitterNow();
+	uint64_t interval;
+	uint64_t dev;
+
+	if (jitter->lastNs == 0) {
+		jitter->lastNs = now;
+		return;
+	}
+	jitter->seq++;
+	__sync_synchronize();
+	interval = now - jitter->lastNs;
+	jitter->lastNs = now;
+	if (jitter->count == 0 || interval < jitter->minNs) jitter->minNs = interval;
+	if (interval > jitter->maxNs) jitter->maxNs = interval;
+	jitter->sumNs += interval;
+	if (jitter->count > 0) {
+		dev = (interval > jitter->lastIntervalNs) ? interval - jitter->lastIntervalNs : jitter->lastIntervalNs - interval;
+		if (dev > jitter->maxDevNs) jitter->maxDevNs = dev;
+		jitter->jitterNs += ((double)dev - jitter->jitterNs) / 16;
+	}
+	jitter->lastIntervalNs = interval;
+	jitter->count++;
+	__sync_synchronize();
+	jitter->seq++;
+}
+
+/* Copy the jitter of a running session. The reader thread updates it meanwhile */
+static void copyJitter(struct AccJitterStats *jitter, struct AccJitterStats *from)
+{
+	uint32_t seq;
+
+	do {
+		seq = from->seq;
+		__sync_synchronize();
+		memcpy(jitter, from, sizeof(struct AccJitterStats));
+		__sync_synchronize();
+	} while ((seq & 1) || from->seq != seq);
+}
+
+int usb_accessory_session_set_realtime(usb_accessory_session_h session, int cpu, int priority)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (cpu < -1 || cpu >= CPU_SETSIZE) return USB_ERROR_INVALID_PARAMETER;
+	if (priority < 0 || priority > sched_get_priority_max(SCHED_FIFO)) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	session->rtEnabled = true;
+	session->rtCpu = cpu;
+	session->rtPriority = priority;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_get_realtime_stats(usb_accessory_session_h session, usb_accessory_session_rt_stats_s *stats)
+{
+	if (!session || !stats) return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || !session->rtEnabled) return USB_ERROR_INVALID_OPERATION;
+	struct AccJitterStats jitter;
+
+	copyJitter(&jitter, &(session->jitter));
+	memset(stats, 0, sizeof(usb_accessory_session_rt_stats_s));
+	stats->affinity = (session->rtCpu >= 0) && !(session->rtFailed & ACC_RT_AFFINITY);
+	stats->realtime = (session->rtPriority > 0) && !(session->rtFailed & ACC_RT_SCHED);
+	stats->memory_locked = !(session->rtFailed & ACC_RT_MLOCK);
+	stats->intervals = jitter.count;
+	if (jitter.count > 0) {
+		stats->min_interval_us = jitter.minNs / 1000;
+		stats->max_interval_us = jitter.maxNs / 1000;
+		stats->mean_interval_us = jitter.sumNs / jitter.count / 1000;
+		stats->jitter_us = (unsigned long long)(jitter.jitterNs / 1000);
+		stats->max_jitter_us = jitter.maxDevNs / 1000;
+	}
+	return USB_ERROR_NONE;
+}
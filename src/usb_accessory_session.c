@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* A session owns a data channel of the backend, which is the accessory node by default.
+ * With read-ahead, a reader thread keeps reading the node into raDepth buffers
+ * while the app consumes the buffers filled before.
+ * With send watermarks, writes are copied to a ring and a writer thread sends them.
+ * Flow events are collected under the session lock
+ * and delivered together by one idle source in the main loop. */
+
+static int sessionRawRead(struct usb_accessory_session_s *session, void *buf, unsigned int len)
+{
+	int ret;
+	do {
+		if (session->poll.maxNs > 0)
+			ret = accBusyPollRead(session, buf, len);
+		else
+			ret = accBackend()->read_channel(session->fd, buf, len);
+	} while (ret < 0 && errno == EINTR);
+	accStatsReadDone(&session->stats, ret);
+	if (session->capture) accCaptureRecord(session->capture, ACC_CAPTURE_IN, buf, ret);
+	return ret;
+}
+
+static int sessionRawWrite(struct usb_accessory_session_s *session, const void *buf, unsigned int len)
+{
+	unsigned int written = 0;
+	int ret;
+	accStatsWriteStart(&session->stats);
+	while (written < len) {
+		ret = accBackend()->write_channel(session->fd, (const char *)buf + written, len - written);
+		if (ret < 0 && errno == EINTR) continue;
+		accStatsWriteDone(&session->stats, ret);
+		if (session->capture)
+			accCaptureRecord(session->capture, ACC_CAPTURE_OUT, (const char *)buf + written, ret);
+		if (ret < 0) return -1;
+		written += ret;
+	}
+	return written;
+}
+
+static bool isSessionDestroyed(struct usb_accessory_session_s *session)
+{
+	bool destroyed;
+	pthread_mutex_lock(&session->lock);
+	destroyed = session->destroyed;
+	pthread_mutex_unlock(&session->lock);
+	return destroyed;
+}
+
+static gboolean sessionFlowIdleCb(gpointer data)
+{
+	struct usb_accessory_session_s *session = (struct usb_accessory_session_s *)data;
+	usb_accessory_flow_cb flowCb;
+	void *flowUserData;
+	unsigned int pending;
+	unsigned int sendQueued;
+	unsigned int recvQueued;
+	int event;
+
+	pthread_mutex_lock(&session->lock);
+	pending = session->pendingFlow;
+	session->pendingFlow = 0;
+	session->flowSource = 0;
+	flowCb = session->flowCb;
+	flowUserData = session->flowUserData;
+	sendQueued = session->sendQueued;
+	recvQueued = session->recvQueued;
+	if (!flowCb || session->destroyed) {
+		pthread_mutex_unlock(&session->lock);
+		return FALSE;
+	}
+	/* The callback may destroy the session */
+	session->refs++;
+	pthread_mutex_unlock(&session->lock);
+
+	for (event = USB_ACCESSORY_FLOW_WRITABLE ; event <= USB_ACCESSORY_FLOW_RECEIVE_PRESSURE ; event++) {
+		if (!(pending & (1 << event))) continue;
+		flowCb(session, event,
+				(event <= USB_ACCESSORY_FLOW_SEND_PRESSURE) ? sendQueued : recvQueued,
+				flowUserData);
+		if (isSessionDestroyed(session)) break;
+	}
+	accSessionLeave(session);
+	return FALSE;
+}
+
+/* Called with the session lock held */
+static void queueFlowEvent(struct usb_accessory_session_s *session, usb_accessory_flow_event_e event)
+{
+	if (!session->flowCb) return;
+	session->pendingFlow |= (1 << event);
+	if (session->flowSource > 0) return;
+	session->flowSource = accGlib()->idle_add(sessionFlowIdleCb, session);
+	if (session->flowSource == 0) USB_LOG("FAIL: idle_add(flow event)\n");
+}
+
+static void *sessionReaderThread(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct usb_accessory_session_s *session = (struct usb_accessory_session_s *)data;
+	struct AccReadBuf *readBuf = NULL;
+	unsigned int size;
+	int ret;
+
+	/* The thread is canceled only while it waits in read() */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	accRealtimeEnterThread(session);
+
+	pthread_mutex_lock(&session->lock);
+	while (!session->stopping) {
+		if (session->raFilled >= session->tune.readDepth) {
+			pthread_cond_wait(&session->cond, &session->lock);
+			continue;
+		}
+		readBuf = &(session->raBufs[session->raTail]);
+		size = session->tune.readSize;
+		pthread_mutex_unlock(&session->lock);
+
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		ret = sessionRawRead(session, readBuf->data, size);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		if (ret > 0 && session->rtEnabled) accJitterRecord(&session->jitter);
+
+		pthread_mutex_lock(&session->lock);
+		if (ret <= 0) {
+			session->readError = (ret < 0) ? errno : 0;
+			session->eof = true;
+			USB_LOG("Reader stops (ret: %d, errno: %d)\n", ret, session->readError);
+			pthread_cond_broadcast(&session->cond);
+			break;
+		}
+		accTuneTick(session);
+		readBuf->len = ret;
+		readBuf->pos = 0;
+		session->raTail = (session->raTail + 1) % session->raDepth;
+		session->raFilled++;
+		if (session->recvQueued == 0)
+			queueFlowEvent(session, USB_ACCESSORY_FLOW_READABLE);
+		session->recvQueued += ret;
+		if (session->recvHigh > 0 && !session->recvPressure && session->recvQueued >= session->recvHigh) {
+			session->recvPressure = true;
+			queueFlowEvent(session, USB_ACCESSORY_FLOW_RECEIVE_PRESSURE);
+		}
+		pthread_cond_broadcast(&session->cond);
+	}
+	pthread_mutex_unlock(&session->lock);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+/* Copy the data read ahead. It waits only if nothing has been read yet */
+static int sessionReadAhead(struct usb_accessory_session_s *session, char *buf, unsigned int len)
+{
+	struct AccReadBuf *readBuf = NULL;
+	unsigned int copied = 0;
+	unsigned int size;
+
+	pthread_mutex_lock(&session->lock);
+	while (session->raFilled == 0 && !session->eof && !session->stopping)
+		pthread_cond_wait(&session->cond, &session->lock);
+
+	while (copied < len && session->raFilled > 0) {
+		readBuf = &(session->raBufs[session->raHead]);
+		size = readBuf->len - readBuf->pos;
+		if (size > len - copied) size = len - copied;
+		memcpy(buf + copied, readBuf->data + readBuf->pos, size);
+		readBuf->pos += size;
+		copied += size;
+		session->recvQueued -= size;
+		if (readBuf->pos == readBuf->len) {
+			session->raHead = (session->raHead + 1) % session->raDepth;
+			session->raFilled--;
+			pthread_cond_broadcast(&session->cond);
+		}
+	}
+	if (session->recvPressure && session->recvQueued <= session->recvLow)
+		session->recvPressure = false;
+	if (copied == 0 && session->readError) {
+		errno = session->readError;
+		pthread_mutex_unlock(&session->lock);
+		return -1;
+	}
+	pthread_mutex_unlock(&session->lock);
+	return copied;
+}
+
+static void *sessionWriterThread(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct usb_accessory_session_s *session = (struct usb_accessory_session_s *)data;
+	unsigned int len;
+	int ret;
+
+	/* The thread is canceled only while it waits in write() */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	accRealtimeEnterThread(session);
+
+	pthread_mutex_lock(&session->lock);
+	while (!session->stopping) {
+		if (session->sendQueued == 0) {
+			pthread_cond_wait(&session->sendCond, &session->lock);
+			continue;
+		}
+		/* Send the part of the ring up to its end. The app only appends after it */
+		len = session->sendLimit - session->sendHead;
+		if (len > session->sendQueued) len = session->sendQueued;
+		if (len > session->tune.writeSize) len = session->tune.writeSize;
+		pthread_mutex_unlock(&session->lock);
+
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		ret = sessionRawWrite(session, session->sendQueue + session->sendHead, len);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+		pthread_mutex_lock(&session->lock);
+		if (ret < 0) {
+			session->writeError = errno;
+			USB_LOG("Writer stops (errno: %d)\n", session->writeError);
+			break;
+		}
+		accTuneTick(session);
+		session->sendHead = (session->sendHead + len) % session->sendLimit;
+		session->sendQueued -= len;
+		if (session->sendPressure && session->sendQueued <= session->sendLow) {
+			session->sendPressure = false;
+			queueFlowEvent(session, USB_ACCESSORY_FLOW_WRITABLE);
+		}
+	}
+	pthread_mutex_unlock(&session->lock);
+	__USB_FUNC_EXIT__ ;
+	return NULL;
+}
+
+/* Append to the send queue without blocking. It returns the number of bytes queued.
+ * If whole is true, nothing is queued unless all of buf fits */
+static int sessionQueueWrite(struct usb_accessory_session_s *session, const char *buf, unsigned int len, bool whole)
+{
+	unsigned int tail;
+	unsigned int size;
+
+	pthread_mutex_lock(&session->lock);
+	if (session->writeError) {
+		errno = session->writeError;
+		pthread_mutex_unlock(&session->lock);
+		return -1;
+	}
+	if (len > session->sendLimit - session->sendQueued)
+		len = whole ? 0 : session->sendLimit - session->sendQueued;
+	tail = (session->sendHead + session->sendQueued) % session->sendLimit;
+	size = session->sendLimit - tail;
+	if (size > len) size = len;
+	memcpy(session->sendQueue + tail, buf, size);
+	memcpy(session->sendQueue, buf + size, len - size);
+	session->sendQueued += len;
+	if (len > 0) pthread_cond_signal(&session->sendCond);
+	if (!session->sendPressure && session->sendQueued >= session->sendHigh) {
+		session->sendPressure = true;
+		queueFlowEvent(session, USB_ACCESSORY_FLOW_SEND_PRESSURE);
+	}
+	pthread_mutex_unlock(&session->lock);
+	return len;
+}
+
+int accSessionRead(struct usb_accessory_session_s *session, char *buf, unsigned int len)
+{
+	if (session->raDepth > 0)
+		return sessionReadAhead(session, buf, len);
+	return sessionRawRead(session, buf, len);
+}
+
+/* Read len bytes. It returns -1 if the data ends before that */
+int accSessionReadAll(struct usb_accessory_session_s *session, char *buf, unsigned int len)
+{
+	unsigned int done = 0;
+	int ret;
+	while (done < len) {
+		ret = accSessionRead(session, buf + done, len - done);
+		if (ret <= 0) return -1;
+		done += ret;
+	}
+	return done;
+}
+
+/* Write len bytes. If writes are buffered, it returns 0 when the queue has no room for all of them */
+int accSessionWriteAll(struct usb_accessory_session_s *session, const char *buf, unsigned int len)
+{
+	if (session->sendHigh > 0)
+		return sessionQueueWrite(session, buf, len, true);
+	return sessionRawWrite(session, buf, len);
+}
+
+static void freeReadAheadBufs(struct usb_accessory_session_s *session)
+{
+	unsigned int i;
+	if (!session->raBufs) return;
+	for (i = 0 ; i < session->raDepth ; i++)
+		accRealtimeFree(session, session->raBufs[i].data, session->raSize);
+	FREE(session->raBufs);
+}
+
+static void freeSendQueue(struct usb_accessory_session_s *session)
+{
+	accRealtimeFree(session, session->sendQueue, session->sendLimit);
+	session->sendQueue = NULL;
+}
+
+static int allocReadAheadBufs(struct usb_accessory_session_s *session)
+{
+	__USB_FUNC_ENTER__ ;
+	unsigned int i;
+	session->raBufs = (struct AccReadBuf *)calloc(session->raDepth, sizeof(struct AccReadBuf));
+	um_retvm_if(session->raBufs == NULL, -1, "FAIL: calloc(raBufs)\n");
+	for (i = 0 ; i < session->raDepth ; i++) {
+		session->raBufs[i].data = (char *)accRealtimeAlloc(session, session->raSize);
+		if (!session->raBufs[i].data) {
+			USB_LOG("FAIL: alloc(raSize)\n");
+			freeReadAheadBufs(session);
+			return -1;
+		}
+	}
+	session->raHead = 0;
+	session->raTail = 0;
+	session->raFilled = 0;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+int usb_accessory_session_create(usb_accessory_h accessory, usb_accessory_session_h *session)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (is_emul_bin()) {
+		USB_LOG("FAIL:USB Accessory is not available with emulator.");
+		return USB_ERROR_NOT_SUPPORTED;
+	}
+	struct usb_accessory_s *acc = acc_handle_get(accessory);
+	if (!acc) return USB_ERROR_INVALID_PARAMETER;
+	if (acc->accPermission != true) {
+		USB_LOG("Permission is not allowed");
+		return USB_ERROR_PERMISSION_DENIED;
+	}
+
+	struct usb_accessory_session_s *s = NULL;
+	s = (struct usb_accessory_session_s *)calloc(1, sizeof(struct usb_accessory_session_s));
+	um_retvm_if(s == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: calloc(usb_accessory_session_s)\n");
+
+	s->fd = accBackend()->open_channel();
+	if (s->fd < 0) {
+		USB_LOG("FAIL: open_channel()\n");
+		FREE(s);
+		return USB_ERROR_OPERATION_FAILED;
+	}
+	pthread_mutex_init(&s->lock, NULL);
+	s->refs = 1;
+	pthread_cond_init(&s->cond, NULL);
+	pthread_cond_init(&s->sendCond, NULL);
+	s->capture = accCaptureDefault();
+	pthread_mutex_init(&s->frameSendLock, NULL);
+	pthread_mutex_init(&s->frameRecvLock, NULL);
+	pthread_mutex_init(&s->frameBulkLock, NULL);
+	pthread_mutex_init(&s->schedLock, NULL);
+	pthread_cond_init(&s->schedCond, NULL);
+	s->sliceSize = ACC_SEND_SLICE_DEFAULT;
+	*session = s;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_set_read_ahead(usb_accessory_session_h session, unsigned int depth, unsigned int buffer_size)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (depth > ACC_READ_AHEAD_MAX_DEPTH) return USB_ERROR_INVALID_PARAMETER;
+	if (depth > 0 && buffer_size == 0) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	session->raDepth = depth;
+	session->raSize = buffer_size;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_set_send_watermarks(usb_accessory_session_h session, unsigned int low, unsigned int high)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (high > 0 && low > high) return USB_ERROR_INVALID_PARAMETER;
+	if (high > UINT_MAX / ACC_SEND_QUEUE_LIMIT_FACTOR) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	session->sendLow = (high > 0) ? low : 0;
+	session->sendHigh = high;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_set_capture(usb_accessory_session_h session, const char *path, unsigned int size, unsigned int snap_len)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	struct AccCapture *capture = NULL;
+
+	if (path) {
+		capture = accCaptureOpen(path, size, snap_len);
+		um_retvm_if(capture == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: accCaptureOpen(%s)\n", path);
+	}
+	if (session->captureOwned) accCaptureClose(session->capture);
+	session->capture = capture;
+	session->captureOwned = (capture != NULL);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_set_receive_watermarks(usb_accessory_session_h session, unsigned int low, unsigned int high)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (high == 0 || low > high) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	session->recvLow = low;
+	session->recvHigh = high;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_set_flow_cb(usb_accessory_session_h session, usb_accessory_flow_cb callback, void *user_data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	pthread_mutex_lock(&session->lock);
+	session->flowCb = callback;
+	session->flowUserData = user_data;
+	pthread_mutex_unlock(&session->lock);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_get_queued(usb_accessory_session_h session, unsigned int *send_queued, unsigned int *receive_queued)
+{
+	if (!session || !send_queued || !receive_queued) return USB_ERROR_INVALID_PARAMETER;
+	pthread_mutex_lock(&session->lock);
+	*send_queued = session->sendQueued;
+	*receive_queued = session->recvQueued;
+	pthread_mutex_unlock(&session->lock);
+	return USB_ERROR_NONE;
+}
+
+/* Stop the reader and the writer */
+static void stopSessionThreads(struct usb_accessory_session_s *session)
+{
+	pthread_mutex_lock(&session->lock);
+	session->stopping = true;
+	pthread_cond_broadcast(&session->cond);
+	pthread_cond_broadcast(&session->sendCond);
+	pthread_mutex_unlock(&session->lock);
+
+	if (session->readerRunning) {
+		pthread_cancel(session->reader);
+		pthread_join(session->reader, NULL);
+		session->readerRunning = false;
+	}
+	if (session->writerRunning) {
+		pthread_cancel(session->writer);
+		pthread_join(session->writer, NULL);
+		session->writerRunning = false;
+	}
+	accPipelineStop(session);
+	accBufPoolStop(session);
+	accBroadcastStop(session);
+}
+
+int usb_accessory_session_start(usb_accessory_session_h session)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	int ret;
+
+	/* A failed start leaves the state of that try */
+	pthread_mutex_lock(&session->lock);
+	session->stopping = false;
+	session->eof = false;
+	session->readError = 0;
+	session->writeError = 0;
+	session->raHead = 0;
+	session->raTail = 0;
+	session->raFilled = 0;
+	session->recvQueued = 0;
+	session->recvPressure = false;
+	session->sendHead = 0;
+	session->sendQueued = 0;
+	session->sendPressure = false;
+	session->pendingFlow = 0;
+	if (session->flowSource > 0) {
+		accGlib()->source_remove(session->flowSource);
+		session->flowSource = 0;
+	}
+	pthread_mutex_unlock(&session->lock);
+	session->frameHeld = false;
+	session->heldLen = 0;
+	session->frameBroken = false;
+	session->asmLen = 0;
+	session->asmReady = false;
+
+	accStatsReset(&session->stats);
+	memset(&session->jitter, 0, sizeof(session->jitter));
+	session->rtFailed = 0;
+	accBusyPollReset(&session->poll);
+
+	/* The receive queue is the read-ahead buffers.
+	 * The pipeline, the buffer pool and the broadcast ring read ahead too, so that they never wait in read() and can be stopped.
+	 * A real-time session reads in its own thread */
+	if ((session->recvHigh > 0 || session->pipeline || session->poolCount > 0 || session->broadcast || session->rtEnabled)
+			&& session->raDepth == 0) {
+		session->raDepth = ACC_READ_AHEAD_DEFAULT_DEPTH;
+		session->raSize = ACC_READ_AHEAD_DEFAULT_SIZE;
+	}
+	/* The tuner uses part of buffers for its largest candidate */
+	if (session->tuneEnabled) {
+		session->raDepth = ACC_TUNE_MAX_DEPTH;
+		session->raSize = ACC_TUNE_MAX_SIZE;
+	}
+	if (session->recvHigh > session->raDepth * session->raSize) {
+		USB_LOG("Receive high watermark is capped to %u\n", session->raDepth * session->raSize);
+		session->recvHigh = session->raDepth * session->raSize;
+		if (session->recvLow > session->recvHigh) session->recvLow = session->recvHigh;
+	}
+
+	accTuneStart(session);
+
+	if (session->sendHigh > 0) {
+		session->sendLimit = session->sendHigh * ACC_SEND_QUEUE_LIMIT_FACTOR;
+		session->sendQueue = (char *)accRealtimeAlloc(session, session->sendLimit);
+		um_retvm_if(session->sendQueue == NULL, USB_ERROR_OPERATION_FAILED, "FAIL: alloc(sendQueue)\n");
+		ret = pthread_create(&session->writer, NULL, sessionWriterThread, session);
+		if (ret != 0) {
+			USB_LOG("FAIL: pthread_create(writer) (%d)\n", ret);
+			freeSendQueue(session);
+			return USB_ERROR_OPERATION_FAILED;
+		}
+		session->writerRunning = true;
+	}
+
+	if (session->raDepth > 0) {
+		ret = allocReadAheadBufs(session);
+		if (ret == 0) {
+			ret = pthread_create(&session->reader, NULL, sessionReaderThread, session);
+			if (ret != 0) {
+				USB_LOG("FAIL: pthread_create(reader) (%d)\n", ret);
+				freeReadAheadBufs(session);
+			}
+		}
+		if (ret != 0) {
+			stopSessionThreads(session);
+			freeSendQueue(session);
+			return USB_ERROR_OPERATION_FAILED;
+		}
+		session->readerRunning = true;
+	}
+
+	if (session->frameMax > 0) {
+		ret = accFrameStart(session);
+		if (ret < 0) {
+			stopSessionThreads(session);
+			freeReadAheadBufs(session);
+			freeSendQueue(session);
+			return USB_ERROR_OPERATION_FAILED;
+		}
+	}
+	session->started = true;
+
+	if (session->pipeline) {
+		ret = accPipelineStart(session);
+		if (ret < 0) {
+			session->started = false;
+			stopSessionThreads(session);
+			freeReadAheadBufs(session);
+			freeSendQueue(session);
+			accFrameFree(session);
+			return USB_ERROR_OPERATION_FAILED;
+		}
+	}
+	if (session->poolCount > 0) {
+		ret = accBufPoolStart(session);
+		if (ret < 0) {
+			session->started = false;
+			stopSessionThreads(session);
+			freeReadAheadBufs(session);
+			freeSendQueue(session);
+			accFrameFree(session);
+			return USB_ERROR_OPERATION_FAILED;
+		}
+	}
+	if (session->broadcast) {
+		ret = accBroadcastStart(session);
+		if (ret < 0) {
+			session->started = false;
+			stopSessionThreads(session);
+			freeReadAheadBufs(session);
+			freeSendQueue(session);
+			accFrameFree(session);
+			return USB_ERROR_OPERATION_FAILED;
+		}
+	}
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_read(usb_accessory_session_h session, void *buf, unsigned int len, unsigned int *read_len)
+{
+	if (!session || !buf || !read_len) return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || session->framed || session->pipeline || session->poolCount > 0 || session->broadcast)
+		return USB_ERROR_INVALID_OPERATION;
+	int ret;
+
+	if (!accSessionEnter(session)) return USB_ERROR_INVALID_OPERATION;
+	if (session->raDepth > 0)
+		ret = sessionReadAhead(session, (char *)buf, len);
+	else
+		ret = sessionRawRead(session, buf, len);
+	accSessionLeave(session);
+	if (ret < 0) {
+		USB_LOG("FAIL: read accessory (%d)\n", errno);
+		*read_len = 0;
+		return USB_ERROR_OPERATION_FAILED;
+	}
+	*read_len = ret;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_write(usb_accessory_session_h session, const void *buf, unsigned int len, unsigned int *written_len)
+{
+	if (!session || !buf || !written_len) return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || session->framed) return USB_ERROR_INVALID_OPERATION;
+	int ret;
+
+	if (!accSessionEnter(session)) return USB_ERROR_INVALID_OPERATION;
+	if (session->sendHigh > 0)
+		ret = sessionQueueWrite(session, (const char *)buf, len, false);
+	else
+		ret = sessionRawWrite(session, buf, len);
+	accSessionLeave(session);
+	if (ret < 0) {
+		USB_LOG("FAIL: write accessory (%d)\n", errno);
+		*written_len = 0;
+		return USB_ERROR_OPERATION_FAILED;
+	}
+	*written_len = ret;
+	return USB_ERROR_NONE;
+}
+
+/* The last one to leave the session frees it */
+static void freeSession(struct usb_accessory_session_s *session)
+{
+	accBackend()->close_channel(session->fd);
+	freeReadAheadBufs(session);
+	freeSendQueue(session);
+	accFrameFree(session);
+	FREE(session->pipeline);
+	if (session->broadcast) accBroadcastRelease(session->broadcast);
+	if (session->captureOwned) accCaptureClose(session->capture);
+	pthread_cond_destroy(&session->schedCond);
+	pthread_mutex_destroy(&session->schedLock);
+	pthread_mutex_destroy(&session->frameBulkLock);
+	pthread_mutex_destroy(&session->frameRecvLock);
+	pthread_mutex_destroy(&session->frameSendLock);
+	pthread_cond_destroy(&session->sendCond);
+	pthread_cond_destroy(&session->cond);
+	pthread_mutex_destroy(&session->lock);
+	FREE(session);
+}
+
+bool accSessionEnter(struct usb_accessory_session_s *session)
+{
+	bool entered;
+	pthread_mutex_lock(&session->lock);
+	entered = !session->destroyed;
+	if (entered) session->refs++;
+	pthread_mutex_unlock(&session->lock);
+	return entered;
+}
+
+void accSessionLeave(struct usb_accessory_session_s *session)
+{
+	unsigned int refs;
+	pthread_mutex_lock(&session->lock);
+	refs = --session->refs;
+	pthread_mutex_unlock(&session->lock);
+	if (refs == 0) freeSession(session);
+}
+
+int usb_accessory_session_destroy(usb_accessory_session_h session)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+
+	pthread_mutex_lock(&session->lock);
+	if (session->destroyed) {
+		pthread_mutex_unlock(&session->lock);
+		return USB_ERROR_INVALID_OPERATION;
+	}
+	session->destroyed = true;
+	if (session->flowSource > 0) {
+		accGlib()->source_remove(session->flowSource);
+		session->flowSource = 0;
+	}
+	pthread_mutex_unlock(&session->lock);
+
+	/* Wakes up the calls waiting for the threads. They fail and leave */
+	stopSessionThreads(session);
+	accSessionLeave(session);
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* usb-server publishes the connection status and the accessory information
+ * in a shared memory segment. The segment is protected by a seqlock:
+ * the writer makes seq odd while it updates the segment,
+ * and readers retry when seq was odd or changed while they were reading. */
+
+static struct AccShmState *volatile shmState = NULL;
+/* The last mapping dropped as stale. Readers may still be in it,
+ * so it is unmapped only when the next one is dropped, ACC_SHM_RETRY_SEC later at least */
+static struct AccShmState *shmRetired = NULL;
+static time_t shmRetryTime = 0;
+static const char *shmName = ACC_SHM_NAME;
+static pthread_mutex_t shmLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Read another segment. The tests publish their own segment
+ * instead of the one of usb-server. The mapped segment is dropped */
+void accShmSetName(const char *name)
+{
+	pthread_mutex_lock(&shmLock);
+	if (shmState) munmap(shmState, sizeof(struct AccShmState));
+	if (shmRetired) munmap(shmRetired, sizeof(struct AccShmState));
+	shmState = NULL;
+	shmRetired = NULL;
+	shmRetryTime = 0;
+	shmName = name ? name : ACC_SHM_NAME;
+	pthread_mutex_unlock(&shmLock);
+}
+
+/* Map the segment for reading. If it does not exist,
+ * it is not looked up again for ACC_SHM_RETRY_SEC seconds */
+static struct AccShmState *getShmState(void)
+{
+	struct AccShmState *state = shmState;
+	struct timespec now;
+	int fd;
+	void *addr;
+
+	/* Pairs with the barrier before shmState is set */
+	__sync_synchronize();
+	if (state) return state;
+	if (!accBackend()->sharedState) return NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (shmRetryTime && now.tv_sec < shmRetryTime) return NULL;
+
+	pthread_mutex_lock(&shmLock);
+	if (shmState) {
+		pthread_mutex_unlock(&shmLock);
+		return shmState;
+	}
+	shmRetryTime = now.tv_sec + ACC_SHM_RETRY_SEC;
+
+	fd = shm_open(shmName, O_RDONLY, 0);
+	if (fd < 0) {
+		pthread_mutex_unlock(&shmLock);
+		USB_LOG("Accessory state segment is not available (%d)\n", errno);
+		return NULL;
+	}
+	addr = mmap(NULL, sizeof(struct AccShmState), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		pthread_mutex_unlock(&shmLock);
+		USB_LOG("FAIL: mmap(accessory state segment)\n");
+		return NULL;
+	}
+	state = (struct AccShmState *)addr;
+	if (state->magic != ACC_SHM_MAGIC || state->version != ACC_SHM_VERSION) {
+		munmap(addr, sizeof(struct AccShmState));
+		pthread_mutex_unlock(&shmLock);
+		USB_LOG("ERROR: Accessory state segment has unknown format\n");
+		return NULL;
+	}
+	__sync_synchronize();
+	shmState = state;
+	pthread_mutex_unlock(&shmLock);
+	return state;
+}
+
+static uint32_t getShmNowMs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000ULL + now.tv_nsec / 1000000);
+}
+
+/* A writer which died or hung leaves its last state behind.
+ * The difference is taken in 32 bits, so the wrap of the heartbeat does not matter */
+static bool isShmLive(struct AccShmState *state)
+{
+	uint32_t heartbeat = state->heartbeat;
+	return (uint32_t)(getShmNowMs() - heartbeat) <= ACC_SHM_STALE_MS;
+}
+
+/* Stop believing a stale segment. It is mapped again after ACC_SHM_RETRY_SEC,
+ * which finds the segment of a restarted usb-server */
+static void dropStaleShm(struct AccShmState *state)
+{
+	struct timespec now;
+
+	pthread_mutex_lock(&shmLock);
+	if (shmState == state) {
+		USB_LOG("Accessory state segment is stale\n");
+		if (shmRetired) munmap(shmRetired, sizeof(struct AccShmState));
+		shmRetired = state;
+		shmState = NULL;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		shmRetryTime = now.tv_sec + ACC_SHM_RETRY_SEC;
+	}
+	pthread_mutex_unlock(&shmLock);
+}
+
+static inline uint32_t readShmSeq(struct AccShmState *state)
+{
+	uint32_t seq = state->seq;
+	__sync_synchronize();
+	return seq;
+}
+
+/* Read the connection status. It returns -1 if the caller must ask vconf */
+int accShmReadStatus(int *status)
+{
+	struct AccShmState *state = getShmState();
+	uint32_t seq;
+	int retry;
+
+	if (!state || !status) return -1;
+	if (!isShmLive(state)) {
+		dropStaleShm(state);
+		return -1;
+	}
+	for (retry = 0 ; retry < ACC_SHM_READ_RETRY ; retry++) {
+		seq = readShmSeq(state);
+		if (seq & 1) continue;
+		*status = state->status;
+		__sync_synchronize();
+		if (state->seq == seq) return 0;
+	}
+	return -1;
+}
+
+/* Copy the information of the idx-th accessory to raw.
+ * It returns 1 if there is no such accessory,
+ * and -1 if the caller must ask usb-server */
+int accShmReadAcc(unsigned int idx, char *raw, unsigned int rawSize, uint32_t *generation)
+{
+	struct AccShmState *state = getShmState();
+	uint32_t seq;
+	uint32_t len;
+	int retry;
+
+	if (!state || !raw || rawSize == 0) return -1;
+	if (!isShmLive(state)) {
+		dropStaleShm(state);
+		return -1;
+	}
+	for (retry = 0 ; retry < ACC_SHM_READ_RETRY ; retry++) {
+		seq = readShmSeq(state);
+		if (seq & 1) continue;
+		if (idx >= state->accCnt || idx >= ACC_SHM_MAX_ACC) {
+			__sync_synchronize();
+			if (state->seq == seq) return 1;
+			continue;
+		}
+		len = state->acc[idx].len;
+		if (len >= rawSize) len = rawSize - 1;
+		memcpy(raw, state->acc[idx].raw, len);
+		raw[len] = '\0';
+		if (generation) *generation = state->generation;
+		__sync_synchronize();
+		if (state->seq == seq) return 0;
+	}
+	return -1;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Latency and traffic of a session.
+ * A write starts a round trip unless one is in flight,
+ * and the next read which returns data ends it. */
+
+static inline uint64_t statsNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int histIndex(uint64_t us)
+{
+	unsigned int shift;
+	if (us < ACC_HIST_SUB) return us;
+	if (us > UINT32_MAX) us = UINT32_MAX;
+	shift = (31 - __builtin_clz((uint32_t)us)) - ACC_HIST_SUB_BITS;
+	return ACC_HIST_SUB + shift * ACC_HIST_SUB + (unsigned int)((us >> shift) - ACC_HIST_SUB);
+}
+
+/* The largest value which goes to the bucket */
+static uint64_t histUpper(unsigned int idx)
+{
+	unsigned int shift;
+	uint64_t sub;
+	if (idx < ACC_HIST_SUB) return idx;
+	shift = (idx - ACC_HIST_SUB) / ACC_HIST_SUB;
+	sub = (idx - ACC_HIST_SUB) % ACC_HIST_SUB + ACC_HIST_SUB;
+	return ((sub + 1) << shift) - 1;
+}
+
+/* The I/O threads may be updating the stats, so each field is swapped atomically.
+ * A round trip which ends meanwhile is counted on either side of the reset */
+void accStatsReset(struct AccLatencyStats *stats)
+{
+	unsigned int i;
+
+	__sync_lock_test_and_set(&stats->pendingNs, 0);
+	__sync_lock_test_and_set(&stats->count, 0);
+	__sync_lock_test_and_set(&stats->sumUs, 0);
+	__sync_lock_test_and_set(&stats->minUs, UINT64_MAX);
+	__sync_lock_test_and_set(&stats->maxUs, 0);
+	__sync_lock_test_and_set(&stats->bytesOut, 0);
+	__sync_lock_test_and_set(&stats->bytesIn, 0);
+	__sync_lock_test_and_set(&stats->writes, 0);
+	__sync_lock_test_and_set(&stats->reads, 0);
+	for (i = 0 ; i < ACC_HIST_BUCKETS ; i++)
+		__sync_lock_test_and_set(&stats->buckets[i], 0);
+	__sync_lock_test_and_set(&stats->startNs, statsNow());
+	__sync_synchronize();
+}
+
+void accStatsWriteStart(struct AccLatencyStats *stats)
+{
+	if (stats->pendingNs != 0) return;
+	__sync_bool_compare_and_swap(&stats->pendingNs, 0, statsNow());
+}
+
+void accStatsWriteDone(struct AccLatencyStats *stats, int ret)
+{
+	if (ret <= 0) return;
+	__sync_fetch_and_add(&stats->writes, 1);
+	__sync_fetch_and_add(&stats->bytesOut, ret);
+}
+
+void accStatsReadDone(struct AccLatencyStats *stats, int ret)
+{
+	uint64_t start;
+	uint64_t us;
+	uint64_t old;
+
+	if (ret <= 0) return;
+	__sync_fetch_and_add(&stats->reads, 1);
+	__sync_fetch_and_add(&stats->bytesIn, ret);
+
+	if (stats->pendingNs == 0) return;
+	start = __sync_lock_test_and_set(&stats->pendingNs, 0);
+	if (start == 0) return;
+	us = (statsNow() - start) / 1000;
+
+	__sync_fetch_and_add(&stats->buckets[histIndex(us)], 1);
+	__sync_fetch_and_add(&stats->sumUs, us);
+	__sync_fetch_and_add(&stats->count, 1);
+	while ((old = stats->minUs) > us && !__sync_bool_compare_and_swap(&stats->minUs, old, us));
+	while ((old = stats->maxUs) < us && !__sync_bool_compare_and_swap(&stats->maxUs, old, us));
+}
+
+/* 64-bit loads are not atomic on 32-bit targets */
+static uint64_t statsLoad(uint64_t *val)
+{
+	return __sync_fetch_and_add(val, 0);
+}
+
+static uint64_t histPercentile(const uint64_t buckets[], uint64_t total, double percentile)
+{
+	uint64_t target;
+	uint64_t seen = 0;
+	unsigned int i;
+
+	if (total == 0) return 0;
+	target = (uint64_t)(percentile / 100.0 * total + 0.5);
+	if (target == 0) target = 1;
+	if (target > total) target = total;
+	for (i = 0 ; i < ACC_HIST_BUCKETS ; i++) {
+		seen += buckets[i];
+		if (seen >= target) return histUpper(i);
+	}
+	return histUpper(ACC_HIST_BUCKETS - 1);
+}
+
+int usb_accessory_session_get_stats(usb_accessory_session_h session, usb_accessory_session_stats_s *stats)
+{
+	if (!session || !stats) return USB_ERROR_INVALID_PARAMETER;
+	struct AccLatencyStats *s = &(session->stats);
+	uint64_t buckets[ACC_HIST_BUCKETS];
+	uint64_t total = 0;
+	double elapsed;
+	unsigned int i;
+
+	/* The buckets are copied first, so that the percentiles agree with each other */
+	for (i = 0 ; i < ACC_HIST_BUCKETS ; i++) {
+		buckets[i] = statsLoad(&s->buckets[i]);
+		total += buckets[i];
+	}
+	memset(stats, 0, sizeof(usb_accessory_session_stats_s));
+	stats->exchanges = total;
+	if (total > 0) {
+		stats->min_us = statsLoad(&s->minUs);
+		stats->max_us = statsLoad(&s->maxUs);
+		stats->mean_us = statsLoad(&s->sumUs) / total;
+		stats->p50_us = histPercentile(buckets, total, 50.0);
+		stats->p90_us = histPercentile(buckets, total, 90.0);
+		stats->p99_us = histPercentile(buckets, total, 99.0);
+		stats->p999_us = histPercentile(buckets, total, 99.9);
+	}
+	stats->bytes_sent = statsLoad(&s->bytesOut);
+	stats->bytes_received = statsLoad(&s->bytesIn);
+	stats->writes = statsLoad(&s->writes);
+	stats->reads = statsLoad(&s->reads);
+	elapsed = (statsNow() - statsLoad(&s->startNs)) / 1e9;
+	if (elapsed > 0) {
+		stats->send_rate = stats->bytes_sent / elapsed;
+		stats->receive_rate = stats->bytes_received / elapsed;
+	}
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_get_latency_percentile(usb_accessory_session_h session, double percentile, unsigned long long *latency_us)
+{
+	if (!session || !latency_us) return USB_ERROR_INVALID_PARAMETER;
+	if (percentile < 0 || percentile > 100) return USB_ERROR_INVALID_PARAMETER;
+	uint64_t buckets[ACC_HIST_BUCKETS];
+	uint64_t total = 0;
+	unsigned int i;
+
+	for (i = 0 ; i < ACC_HIST_BUCKETS ; i++) {
+		buckets[i] = statsLoad(&session->stats.buckets[i]);
+		total += buckets[i];
+	}
+	*latency_us = histPercentile(buckets, total, percentile);
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_reset_stats(usb_accessory_session_h session)
+{
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	accStatsReset(&(session->stats));
+	return USB_ERROR_NONE;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "usb_accessory_private.h"
+
+/* Transfer size autotuning. The read-ahead buffers are allocated for the largest
+ * candidate, and the tuner changes how much of them the reader uses:
+ * the size of each read, the number of buffers read ahead, and the size of each write
+ * of the writer thread. Each candidate runs for a window, and the traffic of the window
+ * is compared. The sizes are probed first, then the depths with the best size.
+ * Once settled, a rate which stays under the settled one re-probes.
+ * The tick is called by the reader and the writer with the session lock held. */
+
+static const unsigned int tuneSizes[] = { 4096, 8192, 16384, 32768, 65536 };
+static const unsigned int tuneDepths[] = { 1, 2, 4, 8 };
+
+#define TUNE_SIZE_CNT (sizeof(tuneSizes) / sizeof(tuneSizes[0]))
+#define TUNE_DEPTH_CNT (sizeof(tuneDepths) / sizeof(tuneDepths[0]))
+
+static inline uint64_t tuneNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t tuneBytes(struct usb_accessory_session_s *session)
+{
+	return __sync_fetch_and_add(&session->stats.bytesIn, 0) + __sync_fetch_and_add(&session->stats.bytesOut, 0);
+}
+
+static void tuneApply(struct AccTune *tune, unsigned int size, unsigned int depth)
+{
+	tune->readSize = size;
+	tune->readDepth = depth;
+	tune->writeSize = size;
+}
+
+static void tuneProbe(struct AccTune *tune)
+{
+	tune->phase = ACC_TUNE_PROBE_SIZE;
+	tune->candidate = 0;
+	tune->bestRate = 0;
+	tune->bestSize = tuneSizes[0];
+	tune->bestDepth = ACC_TUNE_FIRST_DEPTH;
+	tune->drifts = 0;
+	tune->rounds++;
+	tuneApply(tune, tuneSizes[0], ACC_TUNE_FIRST_DEPTH);
+}
+
+void accTuneStart(struct usb_accessory_session_s *session)
+{
+	struct AccTune *tune = &(session->tune);
+
+	memset(tune, 0, sizeof(struct AccTune));
+	if (!session->tuneEnabled) {
+		tune->readSize = session->raSize;
+		tune->readDepth = session->raDepth;
+		tune->writeSize = UINT_MAX;
+		return;
+	}
+	tuneProbe(tune);
+	tune->windowStartNs = tuneNow();
+	tune->windowBytes = tuneBytes(session);
+}
+
+static void tuneNext(struct AccTune *tune, double rate)
+{
+	if (rate > tune->bestRate) {
+		tune->bestRate = rate;
+		tune->bestSize = tune->readSize;
+		tune->bestDepth = tune->readDepth;
+	}
+	tune->candidate++;
+	if (tune->phase == ACC_TUNE_PROBE_SIZE) {
+		if (tune->candidate < TUNE_SIZE_CNT) {
+			tuneApply(tune, tuneSizes[tune->candidate], ACC_TUNE_FIRST_DEPTH);
+			return;
+		}
+		tune->phase = ACC_TUNE_PROBE_DEPTH;
+		tune->candidate = 0;
+	}
+	if (tune->phase == ACC_TUNE_PROBE_DEPTH) {
+		/* The first depth was measured with the best size already */
+		if (tune->candidate < TUNE_DEPTH_CNT && tuneDepths[tune->candidate] == ACC_TUNE_FIRST_DEPTH)
+			tune->candidate++;
+		if (tune->candidate < TUNE_DEPTH_CNT) {
+			tuneApply(tune, tune->bestSize, tuneDepths[tune->candidate]);
+			return;
+		}
+	}
+	tune->phase = ACC_TUNE_SETTLED;
+	tune->settledRate = tune->bestRate;
+	tuneApply(tune, tune->bestSize, tune->bestDepth);
+	USB_LOG("Transfer sizes settled: read %u x %u, write %u (%.0f bytes/s)\n",
+			tune->readSize, tune->readDepth, tune->writeSize, tune->settledRate);
+}
+
+void accTuneTick(struct usb_accessory_session_s *session)
+{
+	struct AccTune *tune = &(session->tune);
+	uint64_t now;
+	uint64_t elapsed;
+	uint64_t bytes;
+	double rate;
+
+	if (!session->tuneEnabled) return;
+	now = tuneNow();
+	elapsed = now - tune->windowStartNs;
+	if (elapsed < ACC_TUNE_WINDOW_MS * 1000000ULL) return;
+	bytes = tuneBytes(session) - tune->windowBytes;
+
+	/* Too little traffic to judge. An idle window is dropped */
+	if (bytes < ACC_TUNE_MIN_BYTES) {
+		if (elapsed < ACC_TUNE_IDLE_WINDOWS * ACC_TUNE_WINDOW_MS * 1000000ULL) return;
+		tune->windowStartNs = now;
+		tune->windowBytes = tuneBytes(session);
+		return;
+	}
+	rate = bytes * 1e9 / elapsed;
+	tune->windowStartNs = now;
+	tune->windowBytes = tuneBytes(session);
+
+	if (tune->phase != ACC_TUNE_SETTLED) {
+		tuneNext(tune, rate);
+		return;
+	}
+	/* A faster window raises the reference a little, so that one burst does not make every later window look slow */
+	if (rate > tune->settledRate) {
+		tune->settledRate += (rate - tune->settledRate) / 4;
+		tune->drifts = 0;
+	} else if (rate < tune->settledRate * (100 - ACC_TUNE_DRIFT_PERCENT) / 100) {
+		if (++tune->drifts >= ACC_TUNE_DRIFT_WINDOWS) {
+			USB_LOG("Throughput drifted to %.0f bytes/s. Transfer sizes are probed again\n", rate);
+			tuneProbe(tune);
+		}
+	} else {
+		tune->drifts = 0;
+	}
+}
+
+int usb_accessory_session_set_autotune(usb_accessory_session_h session, bool enable)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!session) return USB_ERROR_INVALID_PARAMETER;
+	if (session->started) return USB_ERROR_INVALID_OPERATION;
+	session->tuneEnabled = enable;
+	__USB_FUNC_EXIT__ ;
+	return USB_ERROR_NONE;
+}
+
+int usb_accessory_session_get_autotune(usb_accessory_session_h session, usb_accessory_session_tune_s *tune)
+{
+	if (!session || !tune) return USB_ERROR_INVALID_PARAMETER;
+	if (!session->started || !session->tuneEnabled) return USB_ERROR_INVALID_OPERATION;
+
+	pthread_mutex_lock(&session->lock);
+	tune->settled = (session->tune.phase == ACC_TUNE_SETTLED);
+	tune->read_size = session->tune.readSize;
+	tune->read_depth = session->tune.readDepth;
+	tune->write_size = session->tune.writeSize;
+	tune->rate = tune->settled ? session->tune.settledRate : session->tune.bestRate;
+	tune->rounds = session->tune.rounds;
+	pthread_mutex_unlock(&session->lock);
+	return USB_ERROR_NONE;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Transfer size autotuning. The tuner is fed windows of traffic whose rate
+ * depends on the candidate sizes, and then tunes a session with real traffic.
+ * usage: acc_test_autotune */
+
+#include <string.h>
+#include <time.h>
+#include "acc_unit.h"
+
+#define TEST_BEST_SIZE 16384
+#define TEST_BEST_DEPTH 2
+#define TEST_CHUNK 16384
+#define TEST_TUNE_MS 3000
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Bytes per window, the most for the best size and then the best depth */
+static uint64_t window_bytes(unsigned int size, unsigned int depth)
+{
+	uint64_t bytes = 10 * ACC_TUNE_MIN_BYTES;
+	if (size == TEST_BEST_SIZE) bytes *= 4;
+	if (depth == TEST_BEST_DEPTH) bytes *= 2;
+	return bytes;
+}
+
+/* End a window of the tuner with bytes of traffic */
+static void feed_window(usb_accessory_session_h session, uint64_t bytes)
+{
+	session->stats.bytesIn += bytes;
+	session->tune.windowStartNs = now_ns() - ACC_TUNE_WINDOW_MS * 1000000ULL - 1;
+	accTuneTick(session);
+}
+
+static void test_state(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	struct AccTune *tune = NULL;
+	double settled;
+	int windows = 0;
+	int i;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_autotune(session, true) == USB_ERROR_NONE);
+	tune = &(session->tune);
+	accTuneStart(session);
+	CHECK(tune->phase == ACC_TUNE_PROBE_SIZE && tune->rounds == 1);
+	CHECK(tune->readDepth == ACC_TUNE_FIRST_DEPTH);
+
+	/* Too little traffic is not judged */
+	feed_window(session, ACC_TUNE_MIN_BYTES - 1);
+	CHECK(tune->phase == ACC_TUNE_PROBE_SIZE && tune->candidate == 0);
+
+	/* 5 sizes, then 3 more depths with the best size */
+	while (tune->phase != ACC_TUNE_SETTLED && windows < 20) {
+		feed_window(session, window_bytes(tune->readSize, tune->readDepth));
+		windows++;
+	}
+	CHECK(windows == 8);
+	CHECK(tune->phase == ACC_TUNE_SETTLED);
+	CHECK(tune->readSize == TEST_BEST_SIZE && tune->writeSize == TEST_BEST_SIZE);
+	CHECK(tune->readDepth == TEST_BEST_DEPTH);
+	settled = tune->settledRate;
+
+	/* A slow window alone does not re-probe */
+	feed_window(session, window_bytes(TEST_BEST_SIZE, TEST_BEST_DEPTH) / 2);
+	feed_window(session, window_bytes(TEST_BEST_SIZE, TEST_BEST_DEPTH));
+	CHECK(tune->phase == ACC_TUNE_SETTLED && tune->drifts == 0);
+	CHECK(tune->settledRate >= settled * 0.99);
+
+	/* The throughput stays low for 3 windows */
+	for (i = 0 ; i < ACC_TUNE_DRIFT_WINDOWS ; i++)
+		feed_window(session, window_bytes(TEST_BEST_SIZE, TEST_BEST_DEPTH) / 2);
+	CHECK(tune->phase == ACC_TUNE_PROBE_SIZE);
+	CHECK(tune->rounds == 2);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+/* A session with steady traffic settles on candidate sizes */
+static void test_session(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_session_tune_s tune;
+	static char chunk[TEST_CHUNK];
+	unsigned int len = 0;
+	unsigned int done;
+	uint64_t end;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_autotune(NULL, true) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_get_autotune(session, &tune) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_set_autotune(session, true) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_autotune(session, false) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_get_autotune(session, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_get_autotune(session, &tune) == USB_ERROR_NONE);
+	CHECK(!tune.settled && tune.rounds == 1);
+
+	end = now_ns() + TEST_TUNE_MS * 1000000ULL;
+	do {
+		if (usb_accessory_session_write(session, chunk, sizeof(chunk), &len) != USB_ERROR_NONE) break;
+		for (done = 0 ; done < sizeof(chunk) ; done += len) {
+			if (usb_accessory_session_read(session, chunk, sizeof(chunk) - done, &len) != USB_ERROR_NONE) break;
+		}
+		CHECK(usb_accessory_session_get_autotune(session, &tune) == USB_ERROR_NONE);
+	} while (!tune.settled && now_ns() < end);
+
+	CHECK(tune.settled);
+	CHECK(tune.rounds >= 1);
+	CHECK(tune.read_size >= 4096 && tune.read_size <= ACC_TUNE_MAX_SIZE);
+	CHECK(tune.read_depth >= 1 && tune.read_depth <= ACC_TUNE_MAX_DEPTH);
+	CHECK(tune.rate > 0);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+
+	if (!attached) return 1;
+	test_state(attached);
+	test_session(attached);
+
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_autotune");
+}
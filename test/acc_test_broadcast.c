@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Broadcast rings. With BLOCK, receiving waits for the slowest consumer and every
+ * consumer reads every message in order. With DROP, receiving never waits, and a
+ * consumer a whole ring behind is dropped.
+ * usage: acc_test_broadcast */
+
+#include <string.h>
+#include "acc_unit.h"
+
+#define TEST_ENTRIES 8
+#define TEST_MSG_LEN 64
+#define TEST_MSGS (TEST_ENTRIES * 2)
+#define TEST_WAIT_MS 2000
+
+struct reader {
+	usb_accessory_consumer_h consumer;
+	volatile int read;
+	int errors;
+};
+
+static void send_msg(usb_accessory_session_h session, int no)
+{
+	char msg[TEST_MSG_LEN];
+
+	memset(msg, no, sizeof(msg));
+	CHECK(usb_accessory_session_send_message(session, msg, sizeof(msg)) == USB_ERROR_NONE);
+}
+
+/* Whether the entry holds the message no */
+static bool holds(const void *data, unsigned int len, int no)
+{
+	unsigned int i;
+
+	if (len != TEST_MSG_LEN) return false;
+	for (i = 0 ; i < len ; i++)
+		if (((const unsigned char *)data)[i] != (unsigned char)no) return false;
+	return true;
+}
+
+static void *reader_thread(void *data)
+{
+	struct reader *reader = (struct reader *)data;
+	const void *entry = NULL;
+	unsigned int len = 0;
+	int i;
+
+	for (i = 0 ; i < TEST_MSGS ; i++) {
+		if (usb_accessory_consumer_next(reader->consumer, &entry, &len) != USB_ERROR_NONE
+				|| !holds(entry, len, i)) reader->errors++;
+		__sync_fetch_and_add(&reader->read, 1);
+	}
+	return NULL;
+}
+
+/* Wait until the consumer is lag entries behind */
+static unsigned int wait_lag(usb_accessory_consumer_h consumer, unsigned int lag)
+{
+	usb_accessory_consumer_stats_s stats;
+	int i;
+
+	for (i = 0 ; i < TEST_WAIT_MS ; i++) {
+		CHECK(usb_accessory_consumer_get_stats(consumer, &stats) == USB_ERROR_NONE);
+		if (stats.lag >= lag) break;
+		usleep(1000);
+	}
+	return stats.lag;
+}
+
+static void test_params(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_consumer_h consumer = NULL;
+	usb_accessory_consumer_stats_s stats;
+	const void *data = NULL;
+	unsigned int len = 0;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_consumer_create(session, &consumer) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_set_broadcast(NULL, TEST_ENTRIES, TEST_MSG_LEN, USB_ACCESSORY_BROADCAST_BLOCK) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_broadcast(session, ACC_BROADCAST_MAX_ENTRIES + 1, TEST_MSG_LEN, USB_ACCESSORY_BROADCAST_BLOCK) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_broadcast(session, TEST_ENTRIES, TEST_MSG_LEN, 7) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_broadcast(session, TEST_ENTRIES, TEST_MSG_LEN, USB_ACCESSORY_BROADCAST_DROP) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_create(session, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_consumer_create(session, &consumer) == USB_ERROR_NONE);
+	/* The ring cannot change while it has consumers */
+	CHECK(usb_accessory_session_set_broadcast(session, 0, 0, USB_ACCESSORY_BROADCAST_BLOCK) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_consumer_next(NULL, &data, &len) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_consumer_next(consumer, NULL, &len) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_consumer_get_stats(consumer, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_consumer_get_stats(consumer, &stats) == USB_ERROR_NONE);
+	CHECK(stats.entries == 0 && stats.lag == 0 && !stats.dropped);
+	CHECK(usb_accessory_consumer_destroy(NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_consumer_destroy(consumer) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_broadcast(session, 0, 0, USB_ACCESSORY_BROADCAST_BLOCK) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_create(session, &consumer) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+/* The fast consumer waits for the slow one, and both read every message */
+static void test_block(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_consumer_stats_s stats;
+	struct reader fast = { NULL, 0, 0 };
+	usb_accessory_consumer_h slow = NULL;
+	const void *data = NULL;
+	unsigned int len = 0;
+	pthread_t thread;
+	int i;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_framing(session, 0, TEST_MSG_LEN) == USB_ERROR_NONE);
+	/* Rounded up to TEST_ENTRIES */
+	CHECK(usb_accessory_session_set_broadcast(session, TEST_ENTRIES - 3, TEST_MSG_LEN, USB_ACCESSORY_BROADCAST_BLOCK) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_create(session, &fast.consumer) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_create(session, &slow) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+
+	/* The ring fills up and the rest waits */
+	for (i = 0 ; i < TEST_MSGS ; i++) send_msg(session, i);
+	CHECK(wait_lag(slow, TEST_ENTRIES) == TEST_ENTRIES);
+	usleep(50 * 1000);
+	CHECK(usb_accessory_consumer_get_stats(slow, &stats) == USB_ERROR_NONE);
+	CHECK(stats.lag == TEST_ENTRIES);
+
+	/* The fast consumer reads the ring and then waits for the slow one */
+	CHECK(pthread_create(&thread, NULL, reader_thread, &fast) == 0);
+	for (i = 0 ; i < TEST_WAIT_MS && __sync_fetch_and_add(&fast.read, 0) < TEST_ENTRIES ; i++)
+		usleep(1000);
+	usleep(50 * 1000);
+	CHECK(fast.read == TEST_ENTRIES);
+	CHECK(usb_accessory_consumer_get_stats(slow, &stats) == USB_ERROR_NONE);
+	CHECK(stats.stalls >= 1 && stats.entries == 0);
+
+	for (i = 0 ; i < TEST_MSGS ; i++) {
+		CHECK(usb_accessory_consumer_next(slow, &data, &len) == USB_ERROR_NONE);
+		CHECK(holds(data, len, i));
+	}
+	pthread_join(thread, NULL);
+	CHECK(fast.read == TEST_MSGS && fast.errors == 0);
+	CHECK(usb_accessory_consumer_get_stats(slow, &stats) == USB_ERROR_NONE);
+	CHECK(stats.entries == TEST_MSGS && stats.bytes == TEST_MSGS * TEST_MSG_LEN);
+	CHECK(stats.lag == 0 && stats.max_lag == TEST_ENTRIES - 1 && !stats.dropped);
+
+	/* The consumers outlive the session, and find the end */
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_next(slow, &data, &len) == USB_ERROR_NOT_CONNECTED);
+	CHECK(usb_accessory_consumer_next(fast.consumer, &data, &len) == USB_ERROR_NOT_CONNECTED);
+	CHECK(usb_accessory_consumer_destroy(slow) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_destroy(fast.consumer) == USB_ERROR_NONE);
+}
+
+/* Receiving goes on past the consumer which does not read, and the consumer is dropped */
+static void test_drop(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_consumer_stats_s stats;
+	usb_accessory_consumer_h lagging = NULL;
+	usb_accessory_consumer_h late = NULL;
+	const void *data = NULL;
+	unsigned int len = 0;
+	int i;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_framing(session, 0, TEST_MSG_LEN) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_broadcast(session, TEST_ENTRIES, TEST_MSG_LEN, USB_ACCESSORY_BROADCAST_DROP) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_create(session, &lagging) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+
+	/* The entry held is valid while the ring does not wrap */
+	send_msg(session, 0);
+	CHECK(usb_accessory_consumer_next(lagging, &data, &len) == USB_ERROR_NONE);
+	CHECK(holds(data, len, 0));
+	for (i = 1 ; i < TEST_ENTRIES ; i++) send_msg(session, i);
+	CHECK(wait_lag(lagging, TEST_ENTRIES - 1) == TEST_ENTRIES - 1);
+	CHECK(holds(data, len, 0));
+
+	/* Receiving does not wait, and overwrites the entry held */
+	for (i = TEST_ENTRIES ; i < TEST_MSGS ; i++) send_msg(session, i);
+	CHECK(wait_lag(lagging, TEST_MSGS - 1) == TEST_MSGS - 1);
+	CHECK(usb_accessory_consumer_next(lagging, &data, &len) == USB_ERROR_RESOURCE_BUSY);
+	CHECK(data == NULL && len == 0);
+	CHECK(usb_accessory_consumer_next(lagging, &data, &len) == USB_ERROR_RESOURCE_BUSY);
+	CHECK(usb_accessory_consumer_get_stats(lagging, &stats) == USB_ERROR_NONE);
+	CHECK(stats.dropped && stats.entries == 1 && stats.stalls == 0);
+
+	/* A consumer created later starts with the next message */
+	CHECK(usb_accessory_consumer_create(session, &late) == USB_ERROR_NONE);
+	send_msg(session, TEST_MSGS);
+	CHECK(usb_accessory_consumer_next(late, &data, &len) == USB_ERROR_NONE);
+	CHECK(holds(data, len, TEST_MSGS));
+
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_next(late, &data, &len) == USB_ERROR_NOT_CONNECTED);
+	CHECK(usb_accessory_consumer_destroy(late) == USB_ERROR_NONE);
+	CHECK(usb_accessory_consumer_destroy(lagging) == USB_ERROR_NONE);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+
+	if (!attached) return 1;
+	test_params(attached);
+	test_block(attached);
+	test_drop(attached);
+
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_broadcast");
+}
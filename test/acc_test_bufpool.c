@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Reference counts of the buffer pool. A buffer returns to the pool only
+ * when its last reference and the last reference of its views are released.
+ * usage: acc_test_bufpool */
+
+#include <string.h>
+#include "acc_unit.h"
+
+#define TEST_BUFFERS 4
+#define TEST_MSG_LEN 64
+#define TEST_WAIT_MS 2000
+
+static usb_accessory_buffer_h held[TEST_BUFFERS + 2];
+static volatile int received = 0;
+static volatile int ended = 0;
+
+static void receive_cb(usb_accessory_session_h session, usb_accessory_buffer_h buffer, void *user_data)
+{
+	int cnt = received;
+
+	if (!buffer) {
+		__sync_fetch_and_add(&ended, 1);
+		return;
+	}
+	if (cnt < TEST_BUFFERS + 2) held[cnt] = buffer;
+	else usb_accessory_buffer_unref(buffer);
+	__sync_fetch_and_add(&received, 1);
+}
+
+static void wait_received(int cnt)
+{
+	int i;
+	for (i = 0 ; i < TEST_WAIT_MS && __sync_fetch_and_add(&received, 0) < cnt ; i++)
+		usleep(1000);
+}
+
+static void send_msg(usb_accessory_session_h session, int no)
+{
+	char msg[TEST_MSG_LEN];
+
+	memset(msg, 'A' + no, sizeof(msg));
+	CHECK(usb_accessory_session_send_message(session, msg, sizeof(msg)) == USB_ERROR_NONE);
+}
+
+/* Whether a buffer holds expectLen bytes of the message no */
+static bool holds(usb_accessory_buffer_h buffer, int no, unsigned int expectLen)
+{
+	const void *data = NULL;
+	unsigned int len = 0;
+	unsigned int i;
+
+	if (usb_accessory_buffer_get_data(buffer, &data, &len) != USB_ERROR_NONE) return false;
+	if (len != expectLen) return false;
+	for (i = 0 ; i < len ; i++)
+		if (((const char *)data)[i] != 'A' + no) return false;
+	return true;
+}
+
+static void test_params(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_buffer_pool(session, TEST_BUFFERS, TEST_MSG_LEN, 0, NULL, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_buffer_pool(session, ACC_BUF_MAX_COUNT + 1, TEST_MSG_LEN, 0, receive_cb, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_buffer_pool(session, TEST_BUFFERS, TEST_MSG_LEN, 0x80, receive_cb, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_broadcast(session, 4, TEST_MSG_LEN, USB_ACCESSORY_BROADCAST_BLOCK) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_buffer_pool(session, TEST_BUFFERS, TEST_MSG_LEN, 0, receive_cb, NULL) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_buffer_ref(NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_buffer_unref(NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+static void test_refs(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_buffer_h views[TEST_BUFFERS * ACC_BUF_VIEWS_PER_BUFFER];
+	usb_accessory_buffer_h view = NULL;
+	int viewCnt = 0;
+	int i;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_framing(session, 0, TEST_MSG_LEN) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_buffer_pool(session, TEST_BUFFERS, 0, 0, receive_cb, NULL) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+
+	/* All the buffers are held, so the next message waits */
+	for (i = 0 ; i <= TEST_BUFFERS ; i++) send_msg(session, i);
+	wait_received(TEST_BUFFERS);
+	usleep(50 * 1000);
+	CHECK(received == TEST_BUFFERS);
+	for (i = 0 ; i < TEST_BUFFERS ; i++)
+		CHECK(holds(held[i], i, TEST_MSG_LEN));
+
+	/* Views share the views of the whole pool, 4 per buffer */
+	CHECK(usb_accessory_buffer_create_view(held[0], TEST_MSG_LEN, 1, &view) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_buffer_create_view(held[0], 8, TEST_MSG_LEN, &view) == USB_ERROR_INVALID_PARAMETER);
+	while (viewCnt < TEST_BUFFERS * ACC_BUF_VIEWS_PER_BUFFER
+			&& usb_accessory_buffer_create_view(held[0], 8, 16, &views[viewCnt]) == USB_ERROR_NONE)
+		viewCnt++;
+	CHECK(viewCnt == TEST_BUFFERS * (ACC_BUF_VIEWS_PER_BUFFER - 1));
+	CHECK(usb_accessory_buffer_create_view(held[1], 0, 1, &view) == USB_ERROR_RESOURCE_BUSY);
+	CHECK(holds(views[0], 0, 16));
+
+	/* The views keep the buffer out of the pool */
+	CHECK(usb_accessory_buffer_unref(held[0]) == USB_ERROR_NONE);
+	for (i = 1 ; i < viewCnt ; i++)
+		CHECK(usb_accessory_buffer_unref(views[i]) == USB_ERROR_NONE);
+	CHECK(usb_accessory_buffer_ref(views[0]) == USB_ERROR_NONE);
+	CHECK(usb_accessory_buffer_unref(views[0]) == USB_ERROR_NONE);
+	usleep(50 * 1000);
+	CHECK(received == TEST_BUFFERS);
+	CHECK(holds(views[0], 0, 16));
+
+	/* The last reference returns the buffer, and the waiting message takes it */
+	CHECK(usb_accessory_buffer_unref(views[0]) == USB_ERROR_NONE);
+	wait_received(TEST_BUFFERS + 1);
+	CHECK(received == TEST_BUFFERS + 1);
+	CHECK(holds(held[TEST_BUFFERS], TEST_BUFFERS, TEST_MSG_LEN));
+
+	/* Buffers may be held after the session is destroyed */
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+	CHECK(ended == 1);
+	for (i = 1 ; i <= TEST_BUFFERS ; i++) {
+		CHECK(holds(held[i], i, TEST_MSG_LEN));
+		CHECK(usb_accessory_buffer_unref(held[i]) == USB_ERROR_NONE);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+
+	if (!attached) return 1;
+	test_params(attached);
+	test_refs(attached);
+
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_bufpool");
+}
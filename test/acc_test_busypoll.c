@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Busy polling of a session. Replies already in the loopback are found by polling,
+ * and a reply which comes late makes the poll run out of its window.
+ * usage: acc_test_busypoll */
+
+#include <string.h>
+#include "acc_unit.h"
+
+#define TEST_WINDOW_US 5000
+#define TEST_LATE_US 20000
+#define TEST_MSG_LEN 16
+#define TEST_ROUNDS 200
+
+/* Write to the accessory side of the loopback, as a late reply */
+static void *late_reply(void *data)
+{
+	char msg[TEST_MSG_LEN];
+
+	memset(msg, 0x77, sizeof(msg));
+	usleep(TEST_LATE_US);
+	accBackend()->write_channel(0, msg, sizeof(msg));
+	return NULL;
+}
+
+static void test_params(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_session_poll_stats_s stats;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_busy_poll(NULL, TEST_WINDOW_US) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_busy_poll(session, ACC_BUSY_POLL_MAX_US + 1) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_get_busy_poll_stats(session, &stats) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	/* Started without polling */
+	CHECK(usb_accessory_session_get_busy_poll_stats(session, &stats) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_set_busy_poll(session, TEST_WINDOW_US) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+static void test_poll(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_session_poll_stats_s stats;
+	char msg[TEST_MSG_LEN];
+	unsigned int len = 0;
+	pthread_t thread;
+	int round;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_busy_poll(session, TEST_WINDOW_US) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_get_busy_poll_stats(session, &stats) == USB_ERROR_NONE);
+	CHECK(stats.window_us == TEST_WINDOW_US);
+	CHECK(stats.hits == 0 && stats.misses == 0 && stats.probes == 0);
+
+	/* The write waits for its reply, but the loopback is emptied behind the session */
+	memset(msg, 0x11, sizeof(msg));
+	CHECK(usb_accessory_session_write(session, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+	CHECK(accBackend()->read_channel(0, msg, sizeof(msg)) == sizeof(msg));
+	CHECK(pthread_create(&thread, NULL, late_reply, NULL) == 0);
+	CHECK(usb_accessory_session_read(session, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+	CHECK(len == sizeof(msg) && msg[0] == 0x77);
+	pthread_join(thread, NULL);
+	CHECK(usb_accessory_session_get_busy_poll_stats(session, &stats) == USB_ERROR_NONE);
+	CHECK(stats.hits == 0 && stats.misses == 1);
+	CHECK(stats.spin_us >= TEST_WINDOW_US);
+	CHECK(stats.window_us == TEST_WINDOW_US / 2);
+
+	/* Replies already there are found at once, and the window shrinks.
+	 * Some reads wait in read() instead, to measure what polling saves */
+	for (round = 0 ; round < TEST_ROUNDS ; round++) {
+		CHECK(usb_accessory_session_write(session, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+		CHECK(usb_accessory_session_read(session, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+	}
+	CHECK(usb_accessory_session_get_busy_poll_stats(session, &stats) == USB_ERROR_NONE);
+	CHECK(stats.misses == 1);
+	CHECK(stats.probes == (TEST_ROUNDS + 1) / ACC_BUSY_POLL_PROBE_INTERVAL);
+	CHECK(stats.hits == TEST_ROUNDS - stats.probes);
+	CHECK(stats.window_us < TEST_WINDOW_US / 2);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+
+	if (!attached) return 1;
+	test_params(attached);
+	test_poll(attached);
+
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_busypoll");
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* The accessory cache. The cached answer comes at once,
+ * and usb-server is asked afterwards for what changed since.
+ * usage: acc_test_cache */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "acc_unit.h"
+
+#define TEST_OTHER_INFO "Other|Gadget|Other accessory|2.0|http://www.tizen.org|9876543210"
+#define TEST_SERIAL "0123456789"
+#define TEST_OTHER_SERIAL "9876543210"
+#define TEST_WAIT_MS 2000
+#define TEST_MAX_EVENTS 8
+
+struct test_event {
+	char serial[32];
+	bool attached;
+	usb_accessory_permission_e permission;
+};
+
+static struct test_event cached[TEST_MAX_EVENTS];
+static int cachedCnt = 0;
+static struct test_event changed[TEST_MAX_EVENTS];
+static volatile int changedCnt = 0;
+
+static void get_event(usb_accessory_h accessory, bool attached, usb_accessory_permission_e permission, struct test_event *event)
+{
+	char *serial = NULL;
+
+	memset(event, 0, sizeof(struct test_event));
+	if (usb_accessory_get_serial(accessory, &serial) == USB_ERROR_NONE && serial) {
+		snprintf(event->serial, sizeof(event->serial), "%s", serial);
+		free(serial);
+	}
+	event->attached = attached;
+	event->permission = permission;
+}
+
+static bool cached_cb(usb_accessory_h accessory, usb_accessory_permission_e permission, void *user_data)
+{
+	if (cachedCnt == TEST_MAX_EVENTS) return false;
+	get_event(accessory, true, permission, &cached[cachedCnt++]);
+	/* A handle made from the cache does not carry the permission */
+	CHECK(!acc_handle_get(accessory)->accPermission);
+	return true;
+}
+
+static void changed_cb(usb_accessory_h accessory, bool is_attached, usb_accessory_permission_e permission, void *user_data)
+{
+	int cnt = changedCnt;
+
+	if (cnt == TEST_MAX_EVENTS) return;
+	get_event(accessory, is_attached, permission, &changed[cnt]);
+	__sync_fetch_and_add(&changedCnt, 1);
+}
+
+static bool attached_cb(usb_accessory_h accessory, void *user_data)
+{
+	bool granted = false;
+
+	CHECK(usb_accessory_has_permission(accessory, &granted) == USB_ERROR_NONE);
+	return true;
+}
+
+/* Enumerate the attached accessories and check their permission, which records them in the cache */
+static void record(void)
+{
+	CHECK(usb_accessory_foreach_attached(attached_cb, NULL) == USB_ERROR_NONE);
+}
+
+static void foreach_cached(int expectChanged)
+{
+	int i;
+
+	cachedCnt = 0;
+	changedCnt = 0;
+	CHECK(usb_accessory_foreach_cached(cached_cb, changed_cb, NULL) == USB_ERROR_NONE);
+	for (i = 0 ; i < TEST_WAIT_MS && __sync_fetch_and_add(&changedCnt, 0) < expectChanged ; i++)
+		usleep(1000);
+	/* Nothing more comes */
+	usleep(100 * 1000);
+	CHECK(changedCnt == expectChanged);
+}
+
+static const struct test_event *find_changed(const char *serial)
+{
+	int i;
+	for (i = 0 ; i < changedCnt ; i++)
+		if (!strcmp(changed[i].serial, serial)) return &changed[i];
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	const struct test_event *event = NULL;
+	char path[64];
+
+	if (accUnitSelectBackend() < 0) return 1;
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	snprintf(path, sizeof(path), "/tmp/acc_test_cache.%d", (int)getpid());
+	unlink(path);
+
+	CHECK(usb_accessory_foreach_cached(NULL, changed_cb, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_set_cache(path) == USB_ERROR_NONE);
+
+	/* An empty cache answers nothing, and usb-server reports the accessory as new */
+	foreach_cached(1);
+	CHECK(cachedCnt == 0);
+	CHECK(!strcmp(changed[0].serial, TEST_SERIAL) && changed[0].attached);
+	CHECK(changed[0].permission == USB_ACCESSORY_PERMISSION_GRANTED);
+
+	/* The cache agrees with usb-server */
+	record();
+	foreach_cached(0);
+	CHECK(cachedCnt == 1);
+	CHECK(!strcmp(cached[0].serial, TEST_SERIAL));
+	CHECK(cached[0].permission == USB_ACCESSORY_PERMISSION_GRANTED);
+
+	/* The permission was revoked since */
+	accInprocSetAccessory(ACC_UNIT_ACC_INFO, false);
+	foreach_cached(1);
+	CHECK(cachedCnt == 1 && cached[0].permission == USB_ACCESSORY_PERMISSION_GRANTED);
+	CHECK(!strcmp(changed[0].serial, TEST_SERIAL) && changed[0].attached);
+	CHECK(changed[0].permission == USB_ACCESSORY_PERMISSION_DENIED);
+
+	/* The confirmation updated the cache. Then another accessory replaces it */
+	accInprocSetAccessory(TEST_OTHER_INFO, true);
+	foreach_cached(2);
+	CHECK(cachedCnt == 1 && cached[0].permission == USB_ACCESSORY_PERMISSION_DENIED);
+	event = find_changed(TEST_SERIAL);
+	CHECK(event && !event->attached && event->permission == USB_ACCESSORY_PERMISSION_DENIED);
+	event = find_changed(TEST_OTHER_SERIAL);
+	CHECK(event && event->attached && event->permission == USB_ACCESSORY_PERMISSION_GRANTED);
+
+	/* The file keeps the cache when it is opened again */
+	CHECK(usb_accessory_set_cache(NULL) == USB_ERROR_NONE);
+	CHECK(usb_accessory_set_cache(path) == USB_ERROR_NONE);
+	foreach_cached(0);
+	CHECK(cachedCnt == 1);
+	CHECK(!strcmp(cached[0].serial, TEST_OTHER_SERIAL));
+	CHECK(cached[0].permission == USB_ACCESSORY_PERMISSION_GRANTED);
+
+	CHECK(usb_accessory_set_cache(NULL) == USB_ERROR_NONE);
+	unlink(path);
+	return accUnitReport("acc_test_cache");
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Capture of a session. Each round trip writes a message and reads it back,
+ * then the file is checked against the layout of usb_accessory_capture_private.h.
+ * usage: acc_test_capture */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "acc_unit.h"
+#include "usb_accessory_capture_private.h"
+
+#define TEST_MSG_LEN 100
+#define TEST_SNAP_LEN 16
+#define TEST_WRAP_ROUNDS 4000
+
+static void fill_msg(char *msg, unsigned int round)
+{
+	unsigned int i;
+	for (i = 0 ; i < TEST_MSG_LEN ; i++) msg[i] = (char)((round + i) & 0xff);
+}
+
+static int round_trip(usb_accessory_session_h session, unsigned int round)
+{
+	char out[TEST_MSG_LEN];
+	char in[TEST_MSG_LEN];
+	unsigned int len = 0;
+
+	fill_msg(out, round);
+	if (usb_accessory_session_write(session, out, sizeof(out), &len) != USB_ERROR_NONE || len != sizeof(out))
+		return -1;
+	if (usb_accessory_session_read(session, in, sizeof(in), &len) != USB_ERROR_NONE || len != sizeof(in))
+		return -1;
+	return memcmp(in, out, sizeof(in)) == 0 ? 0 : -1;
+}
+
+static const char *block_at(const struct AccCaptureHeader *hdr, uint64_t index)
+{
+	return (const char *)hdr + hdr->headerLen + (index % hdr->blockCnt) * hdr->blockSize;
+}
+
+/* Check that a record is a round trip of the given round. It returns the next record */
+static const struct AccCaptureRecord *check_record(const struct AccCaptureRecord *rec, uint16_t flags, unsigned int round)
+{
+	char msg[TEST_MSG_LEN];
+
+	fill_msg(msg, round);
+	CHECK(rec->recLen >= sizeof(struct AccCaptureRecord) + TEST_SNAP_LEN);
+	CHECK(rec->recLen % ACC_CAPTURE_ALIGN == 0);
+	CHECK(rec->flags == flags);
+	CHECK(rec->len == TEST_MSG_LEN);
+	CHECK(rec->capLen == TEST_SNAP_LEN);
+	CHECK(memcmp(rec + 1, msg, TEST_SNAP_LEN) == 0);
+	return (const struct AccCaptureRecord *)((const char *)rec + rec->recLen);
+}
+
+static struct AccCaptureHeader *map_capture(const char *path, size_t *mapLen)
+{
+	struct stat st;
+	void *addr;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return NULL;
+	}
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) return NULL;
+	*mapLen = st.st_size;
+	return (struct AccCaptureHeader *)addr;
+}
+
+/* A few round trips stay in the first block, in order */
+static void test_records(usb_accessory_h attached, const char *path)
+{
+	usb_accessory_session_h session = NULL;
+	const struct AccCaptureHeader *hdr = NULL;
+	const struct AccCaptureRecord *rec = NULL;
+	const char *block;
+	size_t mapLen = 0;
+	unsigned int round;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_capture(session, path, 0, TEST_SNAP_LEN) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_capture(session, NULL, 0, 0) == USB_ERROR_INVALID_OPERATION);
+	for (round = 0 ; round < 3 ; round++)
+		CHECK(round_trip(session, round) == 0);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+
+	hdr = map_capture(path, &mapLen);
+	CHECK(hdr != NULL);
+	if (!hdr) return;
+	CHECK(hdr->magic == ACC_CAPTURE_MAGIC);
+	CHECK(hdr->version == ACC_CAPTURE_VERSION);
+	CHECK(hdr->headerLen == sizeof(struct AccCaptureHeader));
+	CHECK(hdr->blockSize == ACC_CAPTURE_BLOCK_SIZE);
+	CHECK(hdr->blockCnt == 2);
+	CHECK(hdr->snapLen == TEST_SNAP_LEN);
+	CHECK(mapLen == hdr->headerLen + (size_t)hdr->blockCnt * hdr->blockSize);
+
+	block = block_at(hdr, 0);
+	CHECK(*(const uint64_t *)block == 0);
+	rec = (const struct AccCaptureRecord *)(block + ACC_CAPTURE_BLOCK_HEADER_LEN);
+	for (round = 0 ; round < 3 ; round++) {
+		rec = check_record(rec, ACC_CAPTURE_OUT, round);
+		rec = check_record(rec, ACC_CAPTURE_IN, round);
+	}
+	CHECK(rec->recLen == 0);
+	CHECK(hdr->head == (uint64_t)((const char *)rec - block));
+	munmap((void *)hdr, mapLen);
+}
+
+/* Enough round trips to go round the ring. The newest block holds the last round trip */
+static void test_wrap(usb_accessory_h attached, const char *path)
+{
+	usb_accessory_session_h session = NULL;
+	const struct AccCaptureHeader *hdr = NULL;
+	const struct AccCaptureRecord *rec = NULL;
+	const struct AccCaptureRecord *last = NULL;
+	const char *block;
+	const char *end;
+	uint64_t index;
+	size_t mapLen = 0;
+	unsigned int round;
+	unsigned int failed = 0;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_capture(session, path, 1, TEST_SNAP_LEN) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	for (round = 0 ; round < TEST_WRAP_ROUNDS ; round++)
+		if (round_trip(session, round) < 0) failed++;
+	CHECK(failed == 0);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+
+	hdr = map_capture(path, &mapLen);
+	CHECK(hdr != NULL);
+	if (!hdr) return;
+	CHECK(hdr->head > (uint64_t)hdr->blockCnt * hdr->blockSize);
+	index = (hdr->head - 1) / hdr->blockSize;
+	block = block_at(hdr, index);
+	CHECK(*(const uint64_t *)block == index);
+	CHECK(*(const uint64_t *)block_at(hdr, index - 1) == index - 1);
+
+	/* A reused block still holds older records past the head */
+	end = block + (hdr->head - 1) % hdr->blockSize + 1;
+	rec = (const struct AccCaptureRecord *)(block + ACC_CAPTURE_BLOCK_HEADER_LEN);
+	while ((const char *)rec < end && rec->recLen != 0) {
+		last = rec;
+		rec = (const struct AccCaptureRecord *)((const char *)rec + rec->recLen);
+	}
+	CHECK(last != NULL);
+	if (last) check_record(last, ACC_CAPTURE_IN, TEST_WRAP_ROUNDS - 1);
+	munmap((void *)hdr, mapLen);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+	char path[64];
+
+	if (!attached) return 1;
+	snprintf(path, sizeof(path), "/tmp/acc_test_capture.%d", (int)getpid());
+
+	test_records(attached, path);
+	test_wrap(attached, path);
+
+	unlink(path);
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_capture");
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* The settle window of connection events. The status bounces on the in-process
+ * backend, and only the net transitions reach the callback.
+ * usage: acc_test_debounce */
+
+#include "acc_unit.h"
+
+#define TEST_SETTLE_MS 50
+
+static int calls = 0;
+static bool lastConnected = false;
+static bool lastHadAccessory = false;
+
+static void connection_cb(usb_accessory_h accessory, bool is_connected, void *data)
+{
+	calls++;
+	lastConnected = is_connected;
+	lastHadAccessory = (accessory != NULL);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int suppressed = 0;
+
+	if (accUnitSelectBackend() < 0) return 1;
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	CHECK(usb_accessory_set_connection_debounce(TEST_SETTLE_MS) == USB_ERROR_NONE);
+	CHECK(usb_accessory_set_connection_changed_cb(connection_cb, NULL) == USB_ERROR_NONE);
+
+	/* Three edges in the window end connected: one event */
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	CHECK(calls == 0);
+	accUnitRunLoop(NULL, TEST_SETTLE_MS * 4, NULL);
+	CHECK(calls == 1);
+	CHECK(lastConnected && lastHadAccessory);
+	CHECK(usb_accessory_get_suppressed_event_count(&suppressed) == USB_ERROR_NONE);
+	CHECK(suppressed == 2);
+
+	/* A bounce which ends where it started: no event */
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	accUnitRunLoop(NULL, TEST_SETTLE_MS * 4, NULL);
+	CHECK(calls == 1);
+	CHECK(usb_accessory_get_suppressed_event_count(&suppressed) == USB_ERROR_NONE);
+	CHECK(suppressed == 4);
+
+	/* Without the window, each edge is delivered at once */
+	CHECK(usb_accessory_set_connection_debounce(0) == USB_ERROR_NONE);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	CHECK(calls == 2);
+	CHECK(!lastConnected && !lastHadAccessory);
+
+	CHECK(usb_accessory_connection_unset_cb() == USB_ERROR_NONE);
+	return accUnitReport("acc_test_debounce");
+}
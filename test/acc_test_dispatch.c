@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Order of the connection callbacks while the dispatch mode changes.
+ * The callback is slow, so each switch finds events queued on the old target
+ * and hands them over to the new one.
+ * usage: acc_test_dispatch */
+
+#include "acc_unit.h"
+
+#define TEST_EDGES_PER_MODE 40
+#define TEST_CALLBACK_US 200
+
+static volatile int calls = 0;
+static volatile int running = 0;
+static int overlaps = 0;
+static int misordered = 0;
+static int workerSwitch = USB_ERROR_NONE;
+static volatile bool inWorker = false;
+
+/* The events alternate, starting with a connection */
+static void connection_cb(usb_accessory_h accessory, bool is_connected, void *data)
+{
+	int call;
+
+	if (__sync_lock_test_and_set(&running, 1)) overlaps++;
+	call = calls;
+	if (is_connected != (call % 2 == 0)) misordered++;
+	if (inWorker && workerSwitch == USB_ERROR_NONE)
+		workerSwitch = usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_INLINE, NULL, 0);
+	usleep(TEST_CALLBACK_US);
+	__sync_lock_release(&running);
+	__sync_fetch_and_add(&calls, 1);
+}
+
+/* Post the edges from edge on. It returns the number of edges posted so far */
+static int post_edges(int edge)
+{
+	int i;
+	for (i = 0 ; i < TEST_EDGES_PER_MODE ; i++, edge++)
+		accInprocSetStatus((edge % 2 == 0) ? VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED
+				: VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	return edge;
+}
+
+static void test_params(void)
+{
+	CHECK(usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_WORKER_POOL + 1, NULL, 1) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_WORKER_POOL, NULL, 0) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_WORKER_POOL, NULL, ACC_DISPATCH_MAX_WORKERS + 1) == USB_ERROR_INVALID_PARAMETER);
+}
+
+int main(int argc, char **argv)
+{
+	GMainContext *context = NULL;
+	int edges = 0;
+	int i;
+
+	if (accUnitSelectBackend() < 0) return 1;
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	test_params();
+	context = g_main_context_new();
+	CHECK(usb_accessory_set_connection_changed_cb(connection_cb, NULL) == USB_ERROR_NONE);
+
+	/* The workers run a queue one task at a time, and the mode cannot be changed from them */
+	inWorker = true;
+	CHECK(usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_WORKER_POOL, NULL, 4) == USB_ERROR_NONE);
+	edges = post_edges(edges);
+	while (calls == 0) usleep(100);
+	inWorker = false;
+
+	/* Nothing runs in the main context until it is iterated */
+	CHECK(usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_MAIN_CONTEXT, context, 0) == USB_ERROR_NONE);
+	edges = post_edges(edges);
+	i = calls;
+	usleep(TEST_CALLBACK_US * 10);
+	CHECK(calls == i);
+	for (i = 0 ; i < TEST_EDGES_PER_MODE / 2 ; i++)
+		g_main_context_iteration(context, FALSE);
+
+	/* The rest of the main context goes to fewer workers */
+	CHECK(usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_WORKER_POOL, NULL, 2) == USB_ERROR_NONE);
+	edges = post_edges(edges);
+
+	CHECK(usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_MAIN_CONTEXT, context, 0) == USB_ERROR_NONE);
+	edges = post_edges(edges);
+	for (i = 0 ; i < TEST_EDGES_PER_MODE / 2 ; i++)
+		g_main_context_iteration(context, FALSE);
+
+	/* Inline runs what is left in this thread, before the next edges */
+	CHECK(usb_accessory_set_dispatch(USB_ACCESSORY_DISPATCH_INLINE, NULL, 0) == USB_ERROR_NONE);
+	CHECK(calls == edges);
+	edges = post_edges(edges);
+	CHECK(calls == edges);
+
+	CHECK(workerSwitch == USB_ERROR_INVALID_OPERATION);
+	CHECK(misordered == 0);
+	CHECK(overlaps == 0);
+
+	CHECK(usb_accessory_connection_unset_cb() == USB_ERROR_NONE);
+	g_main_context_unref(context);
+	return accUnitReport("acc_test_dispatch");
+}
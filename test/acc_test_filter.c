@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Accessory filters, matched on enumeration and on connection events.
+ * usage: acc_test_filter */
+
+#include "acc_unit.h"
+
+#define TEST_OTHER_INFO "Other|Gadget|Other accessory|2.0|http://www.tizen.org|9876543210"
+
+static int calls = 0;
+static bool lastConnected = false;
+
+static bool count_cb(usb_accessory_h accessory, void *user_data)
+{
+	(*(int *)user_data)++;
+	return true;
+}
+
+static void connection_cb(usb_accessory_h accessory, bool is_connected, void *data)
+{
+	calls++;
+	lastConnected = is_connected;
+}
+
+static usb_accessory_filter_h make_filter(usb_accessory_field_e field, usb_accessory_match_e match, const char *pattern)
+{
+	usb_accessory_filter_h filter = NULL;
+
+	CHECK(usb_accessory_filter_create(&filter) == USB_ERROR_NONE);
+	if (filter && pattern) CHECK(usb_accessory_filter_add_rule(filter, field, match, pattern) == USB_ERROR_NONE);
+	return filter;
+}
+
+static bool matches(usb_accessory_filter_h filter)
+{
+	return accFilterMatchRaw(filter, ACC_UNIT_ACC_INFO);
+}
+
+static void test_rules(void)
+{
+	usb_accessory_filter_h filter = NULL;
+
+	filter = make_filter(USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_EXACT, NULL);
+	CHECK(matches(filter));
+	usb_accessory_filter_destroy(filter);
+
+	filter = make_filter(USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_EXACT, "Test");
+	CHECK(matches(filter));
+	usb_accessory_filter_destroy(filter);
+	filter = make_filter(USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_EXACT, "Tes");
+	CHECK(!matches(filter));
+	usb_accessory_filter_destroy(filter);
+
+	filter = make_filter(USB_ACCESSORY_FIELD_DESCRIPTION, USB_ACCESSORY_MATCH_PREFIX, "Test acc");
+	CHECK(matches(filter));
+	usb_accessory_filter_destroy(filter);
+	filter = make_filter(USB_ACCESSORY_FIELD_DESCRIPTION, USB_ACCESSORY_MATCH_PREFIX, "accessory");
+	CHECK(!matches(filter));
+	usb_accessory_filter_destroy(filter);
+
+	filter = make_filter(USB_ACCESSORY_FIELD_SERIAL, USB_ACCESSORY_MATCH_GLOB, "0123*9");
+	CHECK(matches(filter));
+	usb_accessory_filter_destroy(filter);
+	filter = make_filter(USB_ACCESSORY_FIELD_SERIAL, USB_ACCESSORY_MATCH_GLOB, "0?2*");
+	CHECK(matches(filter));
+	usb_accessory_filter_destroy(filter);
+	filter = make_filter(USB_ACCESSORY_FIELD_SERIAL, USB_ACCESSORY_MATCH_GLOB, "?0123*");
+	CHECK(!matches(filter));
+	usb_accessory_filter_destroy(filter);
+
+	/* One rule of a field is enough, and every field must match */
+	filter = make_filter(USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_EXACT, "Gadget");
+	CHECK(usb_accessory_filter_add_rule(filter, USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_EXACT, "Test") == USB_ERROR_NONE);
+	CHECK(matches(filter));
+	CHECK(usb_accessory_filter_add_rule(filter, USB_ACCESSORY_FIELD_MANUFACTURER, USB_ACCESSORY_MATCH_EXACT, "Other") == USB_ERROR_NONE);
+	CHECK(!matches(filter));
+	CHECK(accFilterMatchRaw(filter, TEST_OTHER_INFO));
+	usb_accessory_filter_destroy(filter);
+
+	filter = make_filter(USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_EXACT, NULL);
+	CHECK(usb_accessory_filter_add_rule(filter, USB_ACCESSORY_FIELD_SERIAL + 1, USB_ACCESSORY_MATCH_EXACT, "x")
+			== USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_filter_add_rule(filter, USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_GLOB + 1, "x")
+			== USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_filter_add_rule(filter, USB_ACCESSORY_FIELD_MODEL, USB_ACCESSORY_MATCH_EXACT, NULL)
+			== USB_ERROR_INVALID_PARAMETER);
+	usb_accessory_filter_destroy(filter);
+}
+
+static void test_foreach(void)
+{
+	usb_accessory_filter_h filter = NULL;
+	int count = 0;
+
+	filter = make_filter(USB_ACCESSORY_FIELD_MANUFACTURER, USB_ACCESSORY_MATCH_EXACT, "Samsung");
+	CHECK(usb_accessory_foreach_attached_with_filter(filter, count_cb, &count) == USB_ERROR_NONE);
+	CHECK(count == 1);
+	usb_accessory_filter_destroy(filter);
+
+	count = 0;
+	filter = make_filter(USB_ACCESSORY_FIELD_MANUFACTURER, USB_ACCESSORY_MATCH_EXACT, "Other");
+	CHECK(usb_accessory_foreach_attached_with_filter(filter, count_cb, &count) == USB_ERROR_NONE);
+	CHECK(count == 0);
+	usb_accessory_filter_destroy(filter);
+}
+
+/* The connection and the disconnection of an accessory which does not match are not delivered */
+static void test_connection(void)
+{
+	usb_accessory_filter_h filter = NULL;
+
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	filter = make_filter(USB_ACCESSORY_FIELD_MANUFACTURER, USB_ACCESSORY_MATCH_EXACT, "Samsung");
+	CHECK(usb_accessory_set_connection_filter(filter) == USB_ERROR_NONE);
+	usb_accessory_filter_destroy(filter);
+	CHECK(usb_accessory_set_connection_changed_cb(connection_cb, NULL) == USB_ERROR_NONE);
+
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	CHECK(calls == 1 && lastConnected);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	CHECK(calls == 2 && !lastConnected);
+
+	accInprocSetAccessory(TEST_OTHER_INFO, true);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	CHECK(calls == 2);
+
+	CHECK(usb_accessory_set_connection_filter(NULL) == USB_ERROR_NONE);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	CHECK(calls == 3 && lastConnected);
+	CHECK(usb_accessory_connection_unset_cb() == USB_ERROR_NONE);
+}
+
+int main(int argc, char **argv)
+{
+	if (accUnitSelectBackend() < 0) return 1;
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	test_rules();
+	test_foreach();
+	test_connection();
+	return accUnitReport("acc_test_filter");
+}
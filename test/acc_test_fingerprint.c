@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Accessory fingerprints and identity comparison.
+ * usage: acc_test_fingerprint */
+
+#include "acc_unit.h"
+
+/* The same identity with another description and URI */
+#define TEST_SAME_INFO "Samsung|Test|Renamed accessory|1.0|http://example.com|0123456789"
+#define TEST_SERIAL_INFO "Samsung|Test|Test accessory|1.0|http://www.tizen.org|0123456780"
+/* The fields are shifted over the separator */
+#define TEST_SHIFTED_INFO "Samsun|gTest|Test accessory|1.0|http://www.tizen.org|0123456789"
+
+/* Get a handle of the accessory which usb-server reports with raw */
+static usb_accessory_h attach_raw(const char *raw)
+{
+	struct usb_accessory_list *accList = NULL;
+	usb_accessory_h accessory = NULL;
+
+	accInprocSetAccessory(raw, true);
+	if (!getAccList(&accList, NULL) || !accList) return NULL;
+	accessory = accList->accessory;
+	accList->accessory = NULL;
+	freeAccList(accList);
+	return accessory;
+}
+
+/* The fingerprint is FNV-1a of the identity fields, each followed by 0xFF */
+static uint64_t reference_fingerprint(const char *fields[], unsigned int cnt)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	unsigned int i;
+	const char *p;
+
+	for (i = 0 ; i < cnt ; i++) {
+		for (p = fields[i] ; *p ; p++) {
+			hash ^= (unsigned char)*p;
+			hash *= 1099511628211ULL;
+		}
+		hash ^= 0xFF;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static uint64_t fingerprint_of(usb_accessory_h accessory)
+{
+	uint64_t fingerprint = 0;
+	CHECK(usb_accessory_get_fingerprint(accessory, &fingerprint) == USB_ERROR_NONE);
+	return fingerprint;
+}
+
+static bool equals(usb_accessory_h accessory1, usb_accessory_h accessory2)
+{
+	bool isEqual = false;
+	CHECK(usb_accessory_equals(accessory1, accessory2, &isEqual) == USB_ERROR_NONE);
+	return isEqual;
+}
+
+int main(int argc, char **argv)
+{
+	const char *identity[] = { "Samsung", "Test", "1.0", "0123456789" };
+	usb_accessory_h attached = NULL;
+	usb_accessory_h clone = NULL;
+	usb_accessory_h same = NULL;
+	usb_accessory_h serial = NULL;
+	usb_accessory_h shifted = NULL;
+	uint64_t fingerprint = 0;
+
+	if (accUnitSelectBackend() < 0) return 1;
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	attached = attach_raw(ACC_UNIT_ACC_INFO);
+	same = attach_raw(TEST_SAME_INFO);
+	serial = attach_raw(TEST_SERIAL_INFO);
+	shifted = attach_raw(TEST_SHIFTED_INFO);
+	CHECK(attached && same && serial && shifted);
+	if (!attached || !same || !serial || !shifted) return accUnitReport("acc_test_fingerprint");
+
+	/* It does not change across processes or versions of the library */
+	CHECK(fingerprint_of(attached) == reference_fingerprint(identity, 4));
+
+	CHECK(usb_accessory_clone(attached, &clone) == USB_ERROR_NONE);
+	CHECK(fingerprint_of(clone) == fingerprint_of(attached));
+	CHECK(equals(attached, clone));
+
+	CHECK(fingerprint_of(same) == fingerprint_of(attached));
+	CHECK(equals(attached, same));
+
+	CHECK(fingerprint_of(serial) != fingerprint_of(attached));
+	CHECK(!equals(attached, serial));
+	CHECK(fingerprint_of(shifted) != fingerprint_of(attached));
+	CHECK(!equals(attached, shifted));
+
+	CHECK(usb_accessory_get_fingerprint(attached, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_destroy(clone) == USB_ERROR_NONE);
+	CHECK(usb_accessory_get_fingerprint(clone, &fingerprint) == USB_ERROR_INVALID_PARAMETER);
+
+	acc_handle_free(shifted);
+	acc_handle_free(serial);
+	acc_handle_free(same);
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_fingerprint");
+}
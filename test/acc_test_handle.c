@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Accessory handles. A destroyed handle stays invalid after its slot is reused.
+ * usage: acc_test_handle */
+
+#include "acc_unit.h"
+
+#define TEST_HANDLES (ACC_SLAB_CHUNK_SLOTS * 2 + 1)
+#define TEST_THREADS 4
+#define TEST_ROUNDS 10000
+
+static void test_generation(usb_accessory_h attached)
+{
+	usb_accessory_h clone = NULL;
+	usb_accessory_h reused = NULL;
+	char *model = NULL;
+
+	CHECK(usb_accessory_clone(attached, &clone) == USB_ERROR_NONE);
+	CHECK(acc_handle_get(clone) != NULL);
+	CHECK(usb_accessory_get_model(clone, &model) == USB_ERROR_NONE);
+	CHECK(model && !strcmp(model, "Test"));
+	FREE(model);
+	CHECK(usb_accessory_destroy(clone) == USB_ERROR_NONE);
+
+	/* The stale handle is refused, also when the slot is in use again */
+	CHECK(acc_handle_get(clone) == NULL);
+	CHECK(usb_accessory_get_model(clone, &model) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_destroy(clone) == USB_ERROR_INVALID_PARAMETER);
+	reused = acc_handle_alloc();
+	CHECK(reused != NULL && reused != clone);
+	CHECK(((uintptr_t)reused & ACC_HANDLE_INDEX_MASK) == ((uintptr_t)clone & ACC_HANDLE_INDEX_MASK));
+	CHECK(acc_handle_get(reused) != NULL);
+	CHECK(acc_handle_get(clone) == NULL);
+	CHECK(acc_handle_free(clone) < 0);
+	CHECK(acc_handle_get(reused) != NULL);
+	CHECK(acc_handle_free(reused) == 0);
+}
+
+static void test_invalid(void)
+{
+	CHECK(acc_handle_get(NULL) == NULL);
+	CHECK(acc_handle_get((usb_accessory_h)(uintptr_t)ACC_HANDLE_INDEX_MASK) == NULL);
+	CHECK(acc_handle_free(NULL) < 0);
+	CHECK(acc_handle_free((usb_accessory_h)(uintptr_t)ACC_HANDLE_INDEX_MASK) < 0);
+}
+
+/* Handles of more than one chunk are all live and distinct */
+static void test_chunks(void)
+{
+	static usb_accessory_h handles[TEST_HANDLES];
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0 ; i < TEST_HANDLES ; i++) {
+		handles[i] = acc_handle_alloc();
+		CHECK(handles[i] != NULL);
+	}
+	for (i = 0 ; i < TEST_HANDLES ; i++) {
+		CHECK(acc_handle_get(handles[i]) != NULL);
+		for (j = i + 1 ; j < TEST_HANDLES ; j++)
+			CHECK(handles[i] != handles[j]);
+	}
+	for (i = 0 ; i < TEST_HANDLES ; i++)
+		CHECK(acc_handle_free(handles[i]) == 0);
+	for (i = 0 ; i < TEST_HANDLES ; i++)
+		CHECK(acc_handle_get(handles[i]) == NULL);
+}
+
+static void *churn_thread(void *data)
+{
+	int *errors = (int *)data;
+	usb_accessory_h handle = NULL;
+	int i;
+
+	for (i = 0 ; i < TEST_ROUNDS ; i++) {
+		handle = acc_handle_alloc();
+		if (!handle || !acc_handle_get(handle)) (*errors)++;
+		if (acc_handle_free(handle) < 0) (*errors)++;
+		if (acc_handle_get(handle)) (*errors)++;
+	}
+	return NULL;
+}
+
+/* Threads allocate and destroy handles at the same time */
+static void test_threads(void)
+{
+	pthread_t threads[TEST_THREADS];
+	int errors[TEST_THREADS] = { 0, };
+	int i;
+
+	for (i = 0 ; i < TEST_THREADS ; i++)
+		CHECK(pthread_create(&threads[i], NULL, churn_thread, &errors[i]) == 0);
+	for (i = 0 ; i < TEST_THREADS ; i++) {
+		pthread_join(threads[i], NULL);
+		CHECK(errors[i] == 0);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+
+	if (!attached) return 1;
+	test_generation(attached);
+	test_invalid();
+	test_chunks();
+	test_threads();
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_handle");
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Order of the decode pipeline. The workers take a different time for each message,
+ * so they finish out of order, and the messages are still delivered in order.
+ * usage: acc_test_pipeline */
+
+#include <string.h>
+#include "acc_unit.h"
+
+#define TEST_WORKERS 4
+#define TEST_MESSAGES 400
+#define TEST_FAIL_EVERY 50
+#define TEST_DECODE_ERROR 5
+
+static volatile int delivered = 0;
+static volatile int ended = 0;
+static int misordered = 0;
+static int corrupted = 0;
+static int failures = 0;
+static unsigned long long endSeq = 0;
+static unsigned long long nextSeq = 0;
+
+static int decode_cb(const void *in, unsigned int in_len, void *out, unsigned int out_size, unsigned int *out_len, void *user_data)
+{
+	uint32_t value;
+
+	if (in_len != sizeof(value)) return TEST_DECODE_ERROR + 1;
+	memcpy(&value, in, sizeof(value));
+	usleep((value * 7) % 5 * 100);
+	if (value % TEST_FAIL_EVERY == TEST_FAIL_EVERY - 1) return TEST_DECODE_ERROR;
+	value = ~value;
+	memcpy(out, &value, sizeof(value));
+	*out_len = sizeof(value);
+	return 0;
+}
+
+static void deliver_cb(unsigned long long seq, const void *data, int len, void *user_data)
+{
+	uint32_t value;
+
+	if (!data && len == 0) {
+		endSeq = seq;
+		__sync_fetch_and_add(&ended, 1);
+		return;
+	}
+	if (seq != nextSeq) misordered++;
+	nextSeq = seq + 1;
+	if (!data) {
+		if (len == -TEST_DECODE_ERROR && seq % TEST_FAIL_EVERY == TEST_FAIL_EVERY - 1) failures++;
+		else corrupted++;
+	} else {
+		memcpy(&value, data, sizeof(value));
+		if (len != sizeof(value) || ~value != seq) corrupted++;
+	}
+	__sync_fetch_and_add(&delivered, 1);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+	usb_accessory_session_h session = NULL;
+	uint32_t value;
+	int ret;
+	int i;
+
+	if (!attached) return 1;
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return accUnitReport("acc_test_pipeline");
+	CHECK(usb_accessory_session_set_pipeline(session, TEST_WORKERS, sizeof(value), NULL, deliver_cb, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_framing(session, 0, 64) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_pipeline(session, TEST_WORKERS, sizeof(value), decode_cb, deliver_cb, NULL) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_pipeline(session, 0, 0, NULL, NULL, NULL) == USB_ERROR_INVALID_OPERATION);
+
+	for (value = 0 ; value < TEST_MESSAGES ; value++) {
+		while ((ret = usb_accessory_session_send_message(session, &value, sizeof(value))) == USB_ERROR_RESOURCE_BUSY)
+			usleep(100);
+		CHECK(ret == USB_ERROR_NONE);
+	}
+	for (i = 0 ; i < 10000 && __sync_fetch_and_add(&delivered, 0) < TEST_MESSAGES ; i++)
+		usleep(1000);
+	CHECK(ended == 0);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+
+	CHECK(delivered == TEST_MESSAGES);
+	CHECK(misordered == 0);
+	CHECK(corrupted == 0);
+	CHECK(failures == TEST_MESSAGES / TEST_FAIL_EVERY);
+	/* The end is delivered once, when the session is destroyed */
+	CHECK(ended == 1);
+	CHECK(endSeq == TEST_MESSAGES);
+
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_pipeline");
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Sessions opened on connect. The session is prepared in a thread of the library,
+ * and the connection callback takes it started, with the events in order.
+ * usage: acc_test_prewarm */
+
+#include <string.h>
+#include "acc_unit.h"
+
+#define TEST_SERIAL "0123456789"
+#define TEST_OTHER_SERIAL "9876543210"
+#define TEST_MSG_LEN 16
+#define TEST_WAIT_MS 2000
+
+static pthread_t mainThread;
+static volatile int prepared = 0;
+static int preparedInMain = 0;
+static int preparedStarted = 0;
+static volatile int calls = 0;
+static bool connectedOrder[8];
+static int sessionResult[8];
+static usb_accessory_session_h taken = NULL;
+static bool takeSession = true;
+
+static void prepare_cb(usb_accessory_session_h session, void *user_data)
+{
+	CHECK(user_data == &prepared);
+	if (pthread_equal(pthread_self(), mainThread)) preparedInMain++;
+	/* Not started yet, so the options can be set */
+	if (usb_accessory_session_set_send_slice(session, 4096) != USB_ERROR_NONE) preparedStarted++;
+	__sync_fetch_and_add(&prepared, 1);
+}
+
+static void connection_cb(usb_accessory_h accessory, bool is_connected, void *data)
+{
+	usb_accessory_session_h session = NULL;
+	int call = calls;
+
+	if (call < 8) {
+		connectedOrder[call] = is_connected;
+		sessionResult[call] = USB_ERROR_INVALID_PARAMETER;
+		if (is_connected) {
+			sessionResult[call] = takeSession ? usb_accessory_get_prewarmed_session(accessory, &session) : USB_ERROR_NONE;
+			if (session) {
+				/* Taken once */
+				CHECK(usb_accessory_get_prewarmed_session(accessory, &session) == USB_ERROR_INVALID_OPERATION);
+				taken = session;
+			}
+		}
+	}
+	__sync_fetch_and_add(&calls, 1);
+}
+
+static usb_accessory_filter_h serial_filter(const char *serial)
+{
+	usb_accessory_filter_h filter = NULL;
+
+	CHECK(usb_accessory_filter_create(&filter) == USB_ERROR_NONE);
+	CHECK(usb_accessory_filter_add_rule(filter, USB_ACCESSORY_FIELD_SERIAL, USB_ACCESSORY_MATCH_EXACT, serial) == USB_ERROR_NONE);
+	return filter;
+}
+
+static void set_prewarm(const char *serial)
+{
+	usb_accessory_filter_h filter = serial_filter(serial);
+
+	CHECK(usb_accessory_set_prewarm(filter, prepare_cb, (void *)&prepared) == USB_ERROR_NONE);
+	/* The filter is copied */
+	usb_accessory_filter_destroy(filter);
+}
+
+/* Run the default main context until the callback has been called cnt times */
+static void run_until(int cnt)
+{
+	int i;
+	for (i = 0 ; i < TEST_WAIT_MS && calls < cnt ; i++)
+		accUnitRunLoop(NULL, 1, NULL);
+}
+
+static void reset(void)
+{
+	calls = 0;
+	prepared = 0;
+	taken = NULL;
+	memset(connectedOrder, 0, sizeof(connectedOrder));
+}
+
+/* The session comes started with the connection, and the disconnection waits behind it */
+static void test_session(void)
+{
+	char msg[TEST_MSG_LEN];
+	unsigned int len = 0;
+
+	reset();
+	set_prewarm(TEST_SERIAL);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	/* Inline events after a prewarm are delivered from the main context */
+	CHECK(calls == 0);
+	run_until(2);
+	CHECK(calls == 2);
+	CHECK(connectedOrder[0] && !connectedOrder[1]);
+	CHECK(prepared == 1 && preparedInMain == 0 && preparedStarted == 0);
+	CHECK(sessionResult[0] == USB_ERROR_NONE);
+	CHECK(taken != NULL);
+	if (!taken) return;
+
+	memset(msg, 0x5c, sizeof(msg));
+	CHECK(usb_accessory_session_write(taken, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_read(taken, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+	CHECK(len == sizeof(msg));
+	CHECK(usb_accessory_session_set_send_slice(taken, 4096) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_destroy(taken) == USB_ERROR_NONE);
+}
+
+/* A session which is not taken is destroyed after the callback */
+static void test_not_taken(void)
+{
+	reset();
+	takeSession = false;
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	run_until(1);
+	CHECK(calls == 1 && prepared == 1);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	CHECK(calls == 2);
+	takeSession = true;
+}
+
+/* Other accessories and accessories without permission get no session */
+static void test_no_session(void)
+{
+	reset();
+	set_prewarm(TEST_OTHER_SERIAL);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	/* Nothing is held, so the event is delivered at once */
+	CHECK(calls == 1);
+	CHECK(sessionResult[0] == USB_ERROR_INVALID_OPERATION);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	CHECK(calls == 2);
+
+	reset();
+	set_prewarm(TEST_SERIAL);
+	accInprocSetAccessory(ACC_UNIT_ACC_INFO, false);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	run_until(1);
+	CHECK(calls == 1 && prepared == 0);
+	CHECK(sessionResult[0] == USB_ERROR_INVALID_OPERATION);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	CHECK(calls == 2);
+	accInprocSetAccessory(ACC_UNIT_ACC_INFO, true);
+
+	/* Prewarming stops */
+	reset();
+	CHECK(usb_accessory_set_prewarm(NULL, NULL, NULL) == USB_ERROR_NONE);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	CHECK(calls == 1 && prepared == 0);
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_session_h session = NULL;
+
+	if (accUnitSelectBackend() < 0) return 1;
+	mainThread = pthread_self();
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
+	CHECK(usb_accessory_get_prewarmed_session(NULL, &session) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_set_connection_changed_cb(connection_cb, NULL) == USB_ERROR_NONE);
+
+	test_session();
+	test_not_taken();
+	test_no_session();
+
+	CHECK(usb_accessory_connection_unset_cb() == USB_ERROR_NONE);
+	return accUnitReport("acc_test_prewarm");
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Real-time sessions. What the process is not permitted to apply is skipped,
+ * so the stats are checked against what a thread of the test can apply.
+ * usage: acc_test_realtime */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <string.h>
+#include "acc_unit.h"
+
+#define TEST_PRIORITY 10
+#define TEST_MESSAGES 20
+#define TEST_INTERVAL_US 2000
+
+static void *probe_fifo(void *data)
+{
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = TEST_PRIORITY;
+	*(bool *)data = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+	return NULL;
+}
+
+/* Whether a thread may run with SCHED_FIFO */
+static bool can_fifo(void)
+{
+	pthread_t thread;
+	bool permitted = false;
+
+	if (pthread_create(&thread, NULL, probe_fifo, &permitted) != 0) return false;
+	pthread_join(thread, NULL);
+	return permitted;
+}
+
+/* A CPU the process may run on */
+static int allowed_cpu(void)
+{
+	cpu_set_t cpus;
+	int cpu;
+
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) < 0) return 0;
+	for (cpu = 0 ; cpu < CPU_SETSIZE ; cpu++)
+		if (CPU_ISSET(cpu, &cpus)) return cpu;
+	return 0;
+}
+
+static void test_params(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_session_rt_stats_s stats;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_realtime(NULL, -1, 0) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_realtime(session, -2, 0) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_realtime(session, CPU_SETSIZE, 0) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_realtime(session, -1, -1) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_realtime(session, -1, sched_get_priority_max(SCHED_FIFO) + 1) == USB_ERROR_INVALID_PARAMETER);
+	/* Not started, and then not real-time */
+	CHECK(usb_accessory_session_get_realtime_stats(session, &stats) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_get_realtime_stats(session, &stats) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_get_realtime_stats(session, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_realtime(session, -1, 0) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+/* Messages written at a steady interval are read at about the same interval */
+static void test_jitter(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_session_rt_stats_s stats;
+	bool fifo = can_fifo();
+	char msg[16];
+	unsigned int len = 0;
+	unsigned int done;
+	int i;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_realtime(session, allowed_cpu(), TEST_PRIORITY) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_get_realtime_stats(session, &stats) == USB_ERROR_NONE);
+	CHECK(stats.intervals == 0);
+	CHECK(stats.affinity);
+	CHECK(stats.realtime == fifo);
+
+	memset(msg, 0x33, sizeof(msg));
+	for (i = 0 ; i < TEST_MESSAGES ; i++) {
+		CHECK(usb_accessory_session_write(session, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+		for (done = 0 ; done < sizeof(msg) ; done += len) {
+			if (usb_accessory_session_read(session, msg, sizeof(msg) - done, &len) != USB_ERROR_NONE) break;
+		}
+		CHECK(done == sizeof(msg));
+		usleep(TEST_INTERVAL_US);
+	}
+
+	CHECK(usb_accessory_session_get_realtime_stats(session, &stats) == USB_ERROR_NONE);
+	/* The first read starts the intervals */
+	CHECK(stats.intervals == TEST_MESSAGES - 1);
+	CHECK(stats.min_interval_us <= stats.mean_interval_us && stats.mean_interval_us <= stats.max_interval_us);
+	CHECK(stats.min_interval_us >= TEST_INTERVAL_US);
+	CHECK(stats.jitter_us <= stats.max_jitter_us);
+	CHECK(stats.max_jitter_us <= stats.max_interval_us - stats.min_interval_us);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+
+	if (!attached) return 1;
+	test_params(attached);
+	test_jitter(attached);
+
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_realtime");
+}
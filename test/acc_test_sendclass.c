@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Send classes of a framed session. Bulk messages are sliced and put together again,
+ * a control message goes before the next slice, and a steady flow of them
+ * does not hold the slices back.
+ * usage: acc_test_sendclass */
+
+#include <string.h>
+#include "acc_unit.h"
+
+#define TEST_SLICE 4096
+#define TEST_BULK_LEN 20000
+#define TEST_CONTROL_LEN 8
+#define TEST_BURST_SLICE 1024
+#define TEST_BURST_BULK_LEN 32768
+#define TEST_LONG_BULK_LEN (200 * TEST_BURST_SLICE)
+
+static volatile int bulkDone = 0;
+static volatile int controlsSent = 0;
+static int maxRun = 0;
+static int bulkSlices = 0;
+static int firstControlAt = -1;
+
+static uint32_t get_le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Read from the accessory side of the loopback */
+static bool read_all(void *buf, unsigned int len)
+{
+	unsigned int done = 0;
+	int ret;
+
+	while (done < len) {
+		ret = accBackend()->read_channel(0, (char *)buf + done, len - done);
+		if (ret <= 0) return false;
+		done += ret;
+	}
+	return true;
+}
+
+static void test_slices(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_send_class_stats_s stats;
+	static char bulk[TEST_BULK_LEN];
+	static char msg[TEST_BULK_LEN];
+	char control[TEST_CONTROL_LEN];
+	unsigned int len = 0;
+	unsigned int i;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_send_slice(session, ACC_FRAME_MAX_SIZE + 1) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_send_slice(session, TEST_SLICE) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_framing(session, 0, TEST_BULK_LEN) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_send_slice(session, 0) == USB_ERROR_INVALID_OPERATION);
+	CHECK(usb_accessory_session_send_message_class(session, control, sizeof(control), USB_ACCESSORY_SEND_BULK + 1) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_get_send_class_stats(session, USB_ACCESSORY_SEND_BULK + 1, &stats) == USB_ERROR_INVALID_PARAMETER);
+
+	for (i = 0 ; i < sizeof(bulk) ; i++) bulk[i] = (char)(i % 253);
+	memset(control, 0x42, sizeof(control));
+	CHECK(usb_accessory_session_send_message(session, bulk, sizeof(bulk)) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_send_message_class(session, control, sizeof(control), USB_ACCESSORY_SEND_CONTROL) == USB_ERROR_NONE);
+
+	/* The slices come back as one message */
+	CHECK(usb_accessory_session_receive_message(session, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+	CHECK(len == sizeof(bulk) && memcmp(msg, bulk, sizeof(bulk)) == 0);
+	CHECK(usb_accessory_session_receive_message(session, msg, sizeof(msg), &len) == USB_ERROR_NONE);
+	CHECK(len == sizeof(control) && memcmp(msg, control, sizeof(control)) == 0);
+
+	CHECK(usb_accessory_session_get_send_class_stats(session, USB_ACCESSORY_SEND_BULK, &stats) == USB_ERROR_NONE);
+	CHECK(stats.messages == 1 && stats.bytes == TEST_BULK_LEN);
+	CHECK(stats.slices == (TEST_BULK_LEN + TEST_SLICE - 1) / TEST_SLICE);
+	CHECK(stats.queued == 0 && stats.max_queued == 1);
+	CHECK(usb_accessory_session_get_send_class_stats(session, USB_ACCESSORY_SEND_CONTROL, &stats) == USB_ERROR_NONE);
+	CHECK(stats.messages == 1 && stats.bytes == TEST_CONTROL_LEN && stats.slices == 1);
+	CHECK(stats.queued == 0);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+/* Send control messages until the bulk message is sent */
+static void *control_sender(void *data)
+{
+	usb_accessory_session_h session = (usb_accessory_session_h)data;
+	char control[TEST_CONTROL_LEN];
+
+	memset(control, 0x43, sizeof(control));
+	while (!bulkDone) {
+		if (usb_accessory_session_send_message_class(session, control, sizeof(control), USB_ACCESSORY_SEND_CONTROL) != USB_ERROR_NONE)
+			break;
+		__sync_fetch_and_add(&controlsSent, 1);
+	}
+	return NULL;
+}
+
+/* Read the frames on the wire until the last slice of the bulk message */
+static void *wire_reader(void *data)
+{
+	static char payload[TEST_BURST_SLICE];
+	unsigned char header[ACC_FRAME_HEADER_LEN];
+	unsigned int wireLen;
+	unsigned int flags;
+	int run = 0;
+
+	while (read_all(header, sizeof(header))) {
+		wireLen = get_le32(header);
+		flags = get_le32(header + 4) >> 24;
+		if (wireLen > sizeof(payload) || !read_all(payload, wireLen)) break;
+		if (!(flags & ACC_FRAME_FLAG_SLICE)) {
+			if (firstControlAt < 0) firstControlAt = bulkSlices;
+			run++;
+			continue;
+		}
+		/* Controls before the first slice did not hold a bulk slice back */
+		if (bulkSlices > 0 && run > maxRun) maxRun = run;
+		run = 0;
+		bulkSlices++;
+		if (!(flags & ACC_FRAME_FLAG_MORE)) break;
+	}
+	bulkDone = 1;
+	return NULL;
+}
+
+static void test_burst(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	usb_accessory_send_class_stats_s stats;
+	static char bulk[TEST_BURST_BULK_LEN];
+	pthread_t reader;
+	pthread_t sender;
+
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_send_slice(session, TEST_BURST_SLICE) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_framing(session, 0, TEST_BURST_BULK_LEN) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+
+	CHECK(pthread_create(&reader, NULL, wire_reader, NULL) == 0);
+	CHECK(pthread_create(&sender, NULL, control_sender, session) == 0);
+	while (__sync_fetch_and_add(&controlsSent, 0) < 10) usleep(100);
+	CHECK(usb_accessory_session_send_message(session, bulk, sizeof(bulk)) == USB_ERROR_NONE);
+	pthread_join(reader, NULL);
+	pthread_join(sender, NULL);
+
+	CHECK(bulkSlices == TEST_BURST_BULK_LEN / TEST_BURST_SLICE);
+	CHECK(maxRun <= ACC_SEND_CONTROL_BURST);
+	CHECK(usb_accessory_session_get_send_class_stats(session, USB_ACCESSORY_SEND_BULK, &stats) == USB_ERROR_NONE);
+	CHECK(stats.messages == 1 && stats.slices == TEST_BURST_BULK_LEN / TEST_BURST_SLICE);
+	CHECK(usb_accessory_session_get_send_class_stats(session, USB_ACCESSORY_SEND_CONTROL, &stats) == USB_ERROR_NONE);
+	CHECK(stats.messages == (unsigned long long)controlsSent);
+	CHECK(stats.queued == 0);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+static void *bulk_sender(void *data)
+{
+	usb_accessory_session_h session = (usb_accessory_session_h)data;
+	static char bulk[TEST_LONG_BULK_LEN];
+
+	CHECK(usb_accessory_session_send_message(session, bulk, sizeof(bulk)) == USB_ERROR_NONE);
+	return NULL;
+}
+
+static void *one_control(void *data)
+{
+	usb_accessory_session_h session = (usb_accessory_session_h)data;
+	char control[TEST_CONTROL_LEN];
+
+	memset(control, 0x44, sizeof(control));
+	CHECK(usb_accessory_session_send_message_class(session, control, sizeof(control), USB_ACCESSORY_SEND_CONTROL) == USB_ERROR_NONE);
+	return NULL;
+}
+
+/* The loopback fills up in the middle of a bulk message. A control message sent then
+ * goes right after the slice being written, long before the bulk message ends */
+static void test_priority(usb_accessory_h attached)
+{
+	usb_accessory_session_h session = NULL;
+	pthread_t bulkThread;
+	pthread_t controlThread;
+	pthread_t reader;
+
+	bulkDone = 0;
+	maxRun = 0;
+	bulkSlices = 0;
+	firstControlAt = -1;
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return;
+	CHECK(usb_accessory_session_set_send_slice(session, TEST_BURST_SLICE) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_framing(session, 0, TEST_LONG_BULK_LEN) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+
+	CHECK(pthread_create(&bulkThread, NULL, bulk_sender, session) == 0);
+	usleep(50 * 1000);
+	CHECK(pthread_create(&controlThread, NULL, one_control, session) == 0);
+	usleep(20 * 1000);
+	CHECK(pthread_create(&reader, NULL, wire_reader, NULL) == 0);
+	pthread_join(reader, NULL);
+	pthread_join(bulkThread, NULL);
+	pthread_join(controlThread, NULL);
+
+	CHECK(bulkSlices == TEST_LONG_BULK_LEN / TEST_BURST_SLICE);
+	CHECK(firstControlAt > 0);
+	CHECK(firstControlAt < ACC_INPROC_RING_SIZE / TEST_BURST_SLICE + 2);
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+
+	if (!attached) return 1;
+	test_slices(attached);
+	test_burst(attached);
+	test_priority(attached);
+
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_sendclass");
+}
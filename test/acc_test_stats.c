@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Round trip stats of a session. The traffic is counted on real round trips,
+ * and the latency histogram is fed round trips of known length.
+ * usage: acc_test_stats */
+
+#include <string.h>
+#include <time.h>
+#include "acc_unit.h"
+
+#define TEST_MSG_LEN 64
+#define TEST_ROUNDS 10
+#define TEST_SAMPLES 100
+#define TEST_SAMPLE_US 1000ULL
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* A percentile is the upper end of a bucket at most 1/16 of its value wide */
+static int near(unsigned long long value, unsigned long long expected)
+{
+	return value >= expected && value <= expected + expected / 16 + 100;
+}
+
+static void test_traffic(usb_accessory_session_h session)
+{
+	usb_accessory_session_stats_s stats;
+	char out[TEST_MSG_LEN];
+	char in[TEST_MSG_LEN];
+	unsigned int len = 0;
+	unsigned int round;
+
+	memset(out, 0x5a, sizeof(out));
+	for (round = 0 ; round < TEST_ROUNDS ; round++) {
+		CHECK(usb_accessory_session_write(session, out, sizeof(out), &len) == USB_ERROR_NONE);
+		CHECK(usb_accessory_session_read(session, in, sizeof(in), &len) == USB_ERROR_NONE);
+		CHECK(len == sizeof(in));
+	}
+	CHECK(usb_accessory_session_get_stats(session, &stats) == USB_ERROR_NONE);
+	CHECK(stats.exchanges == TEST_ROUNDS);
+	CHECK(stats.writes == TEST_ROUNDS);
+	CHECK(stats.reads == TEST_ROUNDS);
+	CHECK(stats.bytes_sent == TEST_ROUNDS * TEST_MSG_LEN);
+	CHECK(stats.bytes_received == TEST_ROUNDS * TEST_MSG_LEN);
+	CHECK(stats.min_us <= stats.mean_us && stats.mean_us <= stats.max_us);
+	CHECK(stats.p50_us <= stats.p90_us && stats.p90_us <= stats.p99_us && stats.p99_us <= stats.p999_us);
+	CHECK(stats.send_rate > 0 && stats.receive_rate > 0);
+
+	/* A write while a round trip is in flight does not start another */
+	CHECK(usb_accessory_session_write(session, out, sizeof(out), &len) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_write(session, out, sizeof(out), &len) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_read(session, in, sizeof(in), &len) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_read(session, in, sizeof(in), &len) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_get_stats(session, &stats) == USB_ERROR_NONE);
+	CHECK(stats.exchanges == TEST_ROUNDS + 1);
+	CHECK(stats.writes == TEST_ROUNDS + 2);
+	CHECK(stats.reads == TEST_ROUNDS + 2);
+
+	CHECK(usb_accessory_session_reset_stats(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_get_stats(session, &stats) == USB_ERROR_NONE);
+	CHECK(stats.exchanges == 0);
+	CHECK(stats.writes == 0 && stats.reads == 0);
+	CHECK(stats.bytes_sent == 0 && stats.bytes_received == 0);
+	CHECK(stats.min_us == 0 && stats.max_us == 0 && stats.p50_us == 0);
+}
+
+/* Round trips of 1 to 100 ms, fed in reverse order */
+static void test_percentiles(usb_accessory_session_h session)
+{
+	usb_accessory_session_stats_s stats;
+	unsigned long long latency = 0;
+	unsigned int i;
+
+	CHECK(usb_accessory_session_get_latency_percentile(session, 50.0, &latency) == USB_ERROR_NONE);
+	CHECK(latency == 0);
+
+	for (i = TEST_SAMPLES ; i > 0 ; i--) {
+		session->stats.pendingNs = now_ns() - i * TEST_SAMPLE_US * 1000;
+		accStatsReadDone(&session->stats, 1);
+	}
+	CHECK(usb_accessory_session_get_stats(session, &stats) == USB_ERROR_NONE);
+	CHECK(stats.exchanges == TEST_SAMPLES);
+	CHECK(near(stats.min_us, TEST_SAMPLE_US));
+	CHECK(near(stats.max_us, TEST_SAMPLES * TEST_SAMPLE_US));
+	CHECK(near(stats.mean_us, (TEST_SAMPLES + 1) * TEST_SAMPLE_US / 2));
+	CHECK(near(stats.p50_us, 50 * TEST_SAMPLE_US));
+	CHECK(near(stats.p90_us, 90 * TEST_SAMPLE_US));
+	CHECK(near(stats.p99_us, 99 * TEST_SAMPLE_US));
+	CHECK(near(stats.p999_us, 100 * TEST_SAMPLE_US));
+
+	CHECK(usb_accessory_session_get_latency_percentile(session, 0.0, &latency) == USB_ERROR_NONE);
+	CHECK(near(latency, TEST_SAMPLE_US));
+	CHECK(usb_accessory_session_get_latency_percentile(session, 50.0, &latency) == USB_ERROR_NONE);
+	CHECK(latency == stats.p50_us);
+	CHECK(usb_accessory_session_get_latency_percentile(session, 100.0, &latency) == USB_ERROR_NONE);
+	CHECK(near(latency, TEST_SAMPLES * TEST_SAMPLE_US));
+	CHECK(usb_accessory_session_get_latency_percentile(session, -1.0, &latency) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_get_latency_percentile(session, 100.5, &latency) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_get_latency_percentile(session, 50.0, NULL) == USB_ERROR_INVALID_PARAMETER);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+	usb_accessory_session_h session = NULL;
+	usb_accessory_session_stats_s stats;
+
+	if (!attached) return 1;
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return accUnitReport("acc_test_stats");
+	CHECK(usb_accessory_session_get_stats(NULL, &stats) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_get_stats(session, NULL) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+
+	test_traffic(session);
+	test_percentiles(session);
+
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_stats");
+}
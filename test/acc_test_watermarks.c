@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Send and receive watermarks. The in-process backend returns what is written,
+ * so the session fills its own receive queue, the loopback ring and then its send queue.
+ * usage: acc_test_watermarks */
+
+#include "acc_unit.h"
+
+#define TEST_SEND_LOW 1024
+#define TEST_SEND_HIGH 8192
+#define TEST_RECV_LOW 4096
+#define TEST_RECV_HIGH 16384
+#define TEST_CHUNK 4096
+#define TEST_MAX_BYTES (1024 * 1024)
+
+static unsigned int events[USB_ACCESSORY_FLOW_RECEIVE_PRESSURE + 1];
+
+static void flow_cb(usb_accessory_session_h session, usb_accessory_flow_event_e event, unsigned int queued, void *user_data)
+{
+	events[event]++;
+}
+
+/* Write until the send queue is full and stays full */
+static unsigned int fill(usb_accessory_session_h session)
+{
+	static char chunk[TEST_CHUNK];
+	unsigned int total = 0;
+	unsigned int written = 0;
+	unsigned int i;
+	int idle = 0;
+
+	while (total < TEST_MAX_BYTES && idle < 50) {
+		for (i = 0 ; i < TEST_CHUNK ; i++) chunk[i] = (char)((total + i) % 251);
+		CHECK(usb_accessory_session_write(session, chunk, TEST_CHUNK, &written) == USB_ERROR_NONE);
+		total += written;
+		if (written < TEST_CHUNK) {
+			idle++;
+			usleep(1000);
+			if (written > 0) continue;
+		}
+	}
+	return total;
+}
+
+/* Read back all that was written, in order */
+static void drain(usb_accessory_session_h session, unsigned int total)
+{
+	static char chunk[TEST_CHUNK];
+	unsigned int done = 0;
+	unsigned int len = 0;
+	unsigned int bad = 0;
+	unsigned int i;
+
+	while (done < total) {
+		if (usb_accessory_session_read(session, chunk, sizeof(chunk), &len) != USB_ERROR_NONE) break;
+		for (i = 0 ; i < len ; i++)
+			if (chunk[i] != (char)((done + i) % 251)) bad++;
+		done += len;
+	}
+	CHECK(done == total);
+	CHECK(bad == 0);
+}
+
+int main(int argc, char **argv)
+{
+	usb_accessory_h attached = accUnitAttach();
+	usb_accessory_session_h session = NULL;
+	unsigned int sendQueued = 0;
+	unsigned int recvQueued = 0;
+	unsigned int writable;
+	unsigned int total;
+
+	if (!attached) return 1;
+	CHECK(usb_accessory_session_create(attached, &session) == USB_ERROR_NONE);
+	if (!session) return accUnitReport("acc_test_watermarks");
+	CHECK(usb_accessory_session_set_send_watermarks(session, TEST_SEND_HIGH, TEST_SEND_LOW) == USB_ERROR_INVALID_PARAMETER);
+	CHECK(usb_accessory_session_set_send_watermarks(session, TEST_SEND_LOW, TEST_SEND_HIGH) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_receive_watermarks(session, TEST_RECV_LOW, TEST_RECV_HIGH) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_flow_cb(session, flow_cb, NULL) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_start(session) == USB_ERROR_NONE);
+	CHECK(usb_accessory_session_set_send_watermarks(session, TEST_SEND_LOW, TEST_SEND_HIGH) == USB_ERROR_INVALID_OPERATION);
+
+	total = fill(session);
+	CHECK(total > 0 && total < TEST_MAX_BYTES);
+	CHECK(usb_accessory_session_get_queued(session, &sendQueued, &recvQueued) == USB_ERROR_NONE);
+	CHECK(sendQueued >= TEST_SEND_HIGH);
+	CHECK(recvQueued >= TEST_RECV_HIGH);
+	accUnitRunLoop(NULL, 100, NULL);
+	CHECK(events[USB_ACCESSORY_FLOW_READABLE] == 1);
+	CHECK(events[USB_ACCESSORY_FLOW_RECEIVE_PRESSURE] == 1);
+	/* The writer drains the queue below the low watermark until the loopback is full */
+	CHECK(events[USB_ACCESSORY_FLOW_SEND_PRESSURE] >= 1);
+	writable = events[USB_ACCESSORY_FLOW_WRITABLE];
+
+	drain(session, total);
+	accUnitRunLoop(NULL, 100, NULL);
+	CHECK(events[USB_ACCESSORY_FLOW_WRITABLE] == writable + 1);
+	CHECK(usb_accessory_session_get_queued(session, &sendQueued, &recvQueued) == USB_ERROR_NONE);
+	CHECK(sendQueued == 0 && recvQueued == 0);
+
+	CHECK(usb_accessory_session_destroy(session) == USB_ERROR_NONE);
+	acc_handle_free(attached);
+	return accUnitReport("acc_test_watermarks");
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <time.h>
+#include "acc_unit.h"
+
+int accUnitFailures = 0;
+
+static uint64_t unitNowMs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Use the in-process backend with no accessory connected */
+int accUnitSelectBackend(void)
+{
+	if (accInprocRegister() < 0 || accBackendSelect("inproc") < 0) {
+		fprintf(stderr, "FAIL: No inproc backend\n");
+		return -1;
+	}
+	accInprocSetAccessory(ACC_UNIT_ACC_INFO, true);
+	return 0;
+}
+
+/* Connect the test accessory, and return its handle with the permission granted.
+ * The handle is freed with acc_handle_free() */
+usb_accessory_h accUnitAttach(void)
+{
+	struct usb_accessory_list *accList = NULL;
+	usb_accessory_h attached = NULL;
+
+	if (accUnitSelectBackend() < 0) return NULL;
+	accInprocSetStatus(VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
+	if (!getAccList(&accList, NULL) || !accList) {
+		fprintf(stderr, "FAIL: No accessory is attached\n");
+		return NULL;
+	}
+	attached = accList->accessory;
+	accList->accessory = NULL;
+	freeAccList(accList);
+	acc_handle_get(attached)->accPermission = true;
+	return attached;
+}
+
+/* Run a main context, NULL for the default one, for ms milliseconds or until *done is set */
+void accUnitRunLoop(GMainContext *context, unsigned int ms, volatile int *done)
+{
+	uint64_t end = unitNowMs() + ms;
+
+	while (unitNowMs() < end && !(done && *done)) {
+		if (!g_main_context_iteration(context, FALSE)) usleep(1000);
+	}
+}
+
+/* Wait for ms milliseconds or until another thread sets *done */
+void accUnitWait(unsigned int ms, volatile int *done)
+{
+	uint64_t end = unitNowMs() + ms;
+
+	while (unitNowMs() < end && !__sync_fetch_and_add(done, 0)) usleep(1000);
+}
+
+int accUnitReport(const char *name)
+{
+	if (accUnitFailures) {
+		fprintf(stderr, "%s: %d checks failed\n", name, accUnitFailures);
+		return 1;
+	}
+	printf("%s: passed\n", name);
+	return 0;
+}
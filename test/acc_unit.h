@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ACC_UNIT_H__
+#define __ACC_UNIT_H__
+
+#include <stdio.h>
+#include "usb_accessory.h"
+#include "usb_accessory_private.h"
+#include "acc_inproc_backend.h"
+
+/* Common parts of the unit tests. They run on the in-process backend of the benchmarks */
+
+#define ACC_UNIT_ACC_INFO "Samsung|Test|Test accessory|1.0|http://www.tizen.org|0123456789"
+
+extern int accUnitFailures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			accUnitFailures++; \
+		} \
+	} while (0)
+
+int accUnitSelectBackend(void);
+usb_accessory_h accUnitAttach(void);
+void accUnitRunLoop(GMainContext *context, unsigned int ms, volatile int *done);
+void accUnitWait(unsigned int ms, volatile int *done);
+int accUnitReport(const char *name);
+
+#endif /* __ACC_UNIT_H__ */
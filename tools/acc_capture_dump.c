@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Print the records of a capture file, oldest first.
+ * usage: acc_capture_dump [-x] <capture file> */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "usb_accessory_capture_private.h"
+
+static void dump_hex(const unsigned char *data, uint32_t len)
+{
+	uint32_t i;
+	uint32_t j;
+	for (i = 0 ; i < len ; i += 16) {
+		printf("\t%04x  ", i);
+		for (j = i ; j < i + 16 ; j++) {
+			if (j < len) printf("%02x ", data[j]);
+			else printf("   ");
+		}
+		printf(" ");
+		for (j = i ; j < i + 16 && j < len ; j++)
+			putchar((data[j] >= 0x20 && data[j] < 0x7f) ? data[j] : '.');
+		printf("\n");
+	}
+}
+
+static const char *dir_name(uint16_t flags)
+{
+	if (flags & ACC_CAPTURE_OUT) return "OUT";
+	if (flags & ACC_CAPTURE_IN) return "IN";
+	return "?";
+}
+
+/* Print the records of a block up to end. It returns the number of the last record */
+static unsigned long dump_block(const struct AccCaptureHeader *hdr, const char *block, uint32_t end,
+		unsigned long no, int hex)
+{
+	uint32_t off = ACC_CAPTURE_BLOCK_HEADER_LEN;
+	const struct AccCaptureRecord *rec = NULL;
+	uint64_t time;
+
+	while (off + sizeof(struct AccCaptureRecord) <= end) {
+		rec = (const struct AccCaptureRecord *)(block + off);
+		if (rec->recLen == 0) break;
+		if (rec->recLen < sizeof(struct AccCaptureRecord) || rec->recLen > end - off
+				|| rec->capLen > rec->recLen - sizeof(struct AccCaptureRecord)) {
+			printf("broken record at block offset %u\n", off);
+			break;
+		}
+		no++;
+		time = (rec->timeNs > hdr->startNs) ? rec->timeNs - hdr->startNs : 0;
+		if (rec->flags & ACC_CAPTURE_ERROR) {
+			printf("%-8lu %6llu.%09llu  %-4s error %u (%s)\n", no,
+					(unsigned long long)(time / 1000000000ULL), (unsigned long long)(time % 1000000000ULL),
+					dir_name(rec->flags), rec->len, strerror(rec->len));
+		} else {
+			printf("%-8lu %6llu.%09llu  %-4s %-10u %u\n", no,
+					(unsigned long long)(time / 1000000000ULL), (unsigned long long)(time % 1000000000ULL),
+					dir_name(rec->flags), rec->len, rec->capLen);
+			if (hex) dump_hex((const unsigned char *)(rec + 1), rec->capLen);
+		}
+		off += rec->recLen;
+	}
+	return no;
+}
+
+int main(int argc, char *argv[])
+{
+	const struct AccCaptureHeader *hdr = NULL;
+	const char *blocks = NULL;
+	const char *path = NULL;
+	struct stat st;
+	uint64_t head;
+	uint64_t first;
+	uint64_t last;
+	uint64_t b;
+	unsigned long no = 0;
+	int hex = 0;
+	void *addr;
+	int fd;
+
+	if (argc == 3 && !strcmp(argv[1], "-x")) {
+		hex = 1;
+		path = argv[2];
+	} else if (argc == 2) {
+		path = argv[1];
+	} else {
+		printf("usage: %s [-x] <capture file>\n", argv[0]);
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		return -1;
+	}
+	if (st.st_size < (off_t)sizeof(struct AccCaptureHeader)) {
+		printf("%s is not a capture file\n", path);
+		return -1;
+	}
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+
+	hdr = (const struct AccCaptureHeader *)addr;
+	if (hdr->magic != ACC_CAPTURE_MAGIC || hdr->version != ACC_CAPTURE_VERSION
+			|| hdr->blockSize <= ACC_CAPTURE_BLOCK_HEADER_LEN || hdr->blockCnt == 0
+			|| st.st_size < (off_t)(hdr->headerLen + (uint64_t)hdr->blockSize * hdr->blockCnt)) {
+		printf("%s is not a capture file of version %d\n", path, ACC_CAPTURE_VERSION);
+		return -1;
+	}
+	blocks = (const char *)addr + hdr->headerLen;
+	head = hdr->head;
+	printf("# %s: %u blocks of %u bytes, snap %u, %llu bytes captured\n", path,
+			hdr->blockCnt, hdr->blockSize, hdr->snapLen, (unsigned long long)head);
+	printf("%-8s %16s  %-4s %-10s %s\n", "No.", "Time", "Dir", "Length", "Captured");
+	if (head == 0) return 0;
+
+	last = (head - 1) / hdr->blockSize;
+	first = (last >= hdr->blockCnt) ? last - hdr->blockCnt + 1 : 0;
+	for (b = first ; b <= last ; b++) {
+		const char *block = blocks + (b % hdr->blockCnt) * (uint64_t)hdr->blockSize;
+		uint32_t end = (b == last) ? head - b * hdr->blockSize : hdr->blockSize;
+		if (*(const uint64_t *)block != b) {
+			printf("# block %llu is overwritten\n", (unsigned long long)b);
+			continue;
+		}
+		no = dump_block(hdr, block, end, no, hex);
+	}
+	munmap(addr, st.st_size);
+	return 0;
+}